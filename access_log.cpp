@@ -0,0 +1,277 @@
+#include "access_log.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+    // How often the writer thread drains the rings when idle
+    constexpr auto flush_interval = std::chrono::milliseconds(100);
+
+    std::atomic<std::uint64_t> next_instance_id{ 1 };
+
+    // Per-thread ring cache; keyed by instance id so a reused address never matches a dead log.
+    // A miss (the thread last recorded to another log) only costs a lookup in thread_rings_
+    struct RingCache {
+        std::uint64_t owner = 0;
+        void* ring = nullptr;
+    };
+
+    thread_local RingCache ring_cache;
+
+    void copy_truncated(char* dst, std::size_t size, std::string_view src) {
+
+        std::size_t n = std::min(size - 1, src.size());
+        std::memcpy(dst, src.data(), n);
+        dst[n] = '\0';
+
+    }
+
+    void append_escaped(std::string& out, const char* s) {
+
+        for (; *s; ++s) {
+            unsigned char c = static_cast<unsigned char>(*s);
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += static_cast<char>(c);
+            }
+            else if (c < 0x20) {
+                char hex[8];
+                std::snprintf(hex, sizeof(hex), "\\u%04x", c);
+                out += hex;
+            }
+            else {
+                out += static_cast<char>(c);
+            }
+        }
+
+    }
+
+}
+
+
+/**
+ * AccessLog::Ring constructor.
+ * @param capacity Number of slots, rounded up to a power of two
+ */
+AccessLog::Ring::Ring(std::size_t capacity) {
+
+    std::size_t size = 1;
+    while (size < capacity) size <<= 1;
+
+    slots = std::make_unique<AccessLogEntry[]>(size);
+    mask = size - 1;
+
+}
+
+
+/**
+ * AccessLog class constructor.
+ * Opens the log file and starts the background writer thread.
+ * @param path Path of the log file, or "-" for stdout
+ * @param ring_capacity Entries buffered per request thread before records are dropped
+ * @throws std::runtime_error If the log file cannot be opened
+ */
+AccessLog::AccessLog(const std::string& path, std::size_t ring_capacity)
+    : out_(path == "-" ? stdout : std::fopen(path.c_str(), "a")),
+      ring_capacity_(ring_capacity),
+      instance_id_(next_instance_id.fetch_add(1)) {
+
+    if (!out_) throw std::runtime_error("Failed to open access log: " + path);
+
+    writer_ = std::thread(&AccessLog::writer_loop, this);
+
+}
+
+
+/**
+ * AccessLog class destructor.
+ * Stops the writer thread after a final drain and closes the log file.
+ */
+AccessLog::~AccessLog() {
+
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    writer_.join();
+
+    if (out_ != stdout) std::fclose(out_);
+
+}
+
+
+/**
+ * Records a completed request.
+ * Lock-free and allocation-free: the entry is copied into the calling thread's ring.
+ * If the ring is full the entry is dropped and counted instead of waiting for the writer.
+ * @param method HTTP method
+ * @param route Request target (truncated to fit the entry)
+ * @param status HTTP status code
+ * @param latency Time spent handling the request
+ * @param bytes Bytes written to the client
+ * @param client Remote endpoint
+ */
+void AccessLog::record(std::string_view method, std::string_view route, unsigned status,
+    std::chrono::microseconds latency, std::size_t bytes, const boost::asio::ip::tcp::endpoint& client) {
+
+    Ring& ring = local_ring();
+
+    std::size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) > ring.mask) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    AccessLogEntry& entry = ring.slots[head & ring.mask];
+    entry.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    entry.latency_us = static_cast<std::uint32_t>(std::min<std::int64_t>(latency.count(), UINT32_MAX));
+    entry.bytes = static_cast<std::uint32_t>(std::min<std::size_t>(bytes, UINT32_MAX));
+    entry.status = static_cast<std::uint16_t>(status);
+    copy_truncated(entry.method, sizeof(entry.method), method);
+    copy_truncated(entry.route, sizeof(entry.route), route);
+    entry.client = client;
+
+    ring.head.store(head + 1, std::memory_order_release);
+
+}
+
+
+/**
+ * Returns the number of entries written to the log so far.
+ */
+std::uint64_t AccessLog::written() const {
+
+    return written_.load(std::memory_order_relaxed);
+
+}
+
+
+/**
+ * Returns the number of entries dropped because a ring was full.
+ */
+std::uint64_t AccessLog::dropped() const {
+
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+
+    std::uint64_t total = 0;
+    for (const auto& ring : rings_) total += ring->dropped.load(std::memory_order_relaxed);
+    return total;
+
+}
+
+
+/**
+ * Returns the ring of the calling thread, creating it on first use.
+ * The mutex is only taken when the thread last recorded to another log; it then gets
+ * its own ring back, so each ring keeps a single producer and rings never pile up.
+ */
+AccessLog::Ring& AccessLog::local_ring() {
+
+    if (ring_cache.owner == instance_id_) return *static_cast<Ring*>(ring_cache.ring);
+
+    std::lock_guard<std::mutex> lock(rings_mutex_);
+
+    Ring*& ring = thread_rings_[std::this_thread::get_id()];
+    if (!ring) {
+        rings_.push_back(std::make_unique<Ring>(ring_capacity_));
+        ring = rings_.back().get();
+    }
+
+    ring_cache.owner = instance_id_;
+    ring_cache.ring = ring;
+    return *ring;
+
+}
+
+
+/**
+ * Background writer.
+ * Drains all rings every flush interval and writes them with a single fwrite per batch.
+ */
+void AccessLog::writer_loop() {
+
+    std::string batch;
+    batch.reserve(64 * 1024);
+
+    for (;;) {
+
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            wake_.wait_for(lock, flush_interval, [this] { return stopping_; });
+            stopping = stopping_;
+        }
+
+        batch.clear();
+        std::size_t count = drain(batch);
+
+        std::uint64_t dropped_total = dropped();
+        if (dropped_total != dropped_reported_) {
+            batch += "{\"dropped\":" + std::to_string(dropped_total - dropped_reported_) + "}\n";
+            dropped_reported_ = dropped_total;
+        }
+
+        if (!batch.empty()) {
+            std::fwrite(batch.data(), 1, batch.size(), out_);
+            std::fflush(out_);
+            written_.fetch_add(count, std::memory_order_relaxed);
+        }
+
+        if (stopping) break;
+
+    }
+
+}
+
+
+/**
+ * Moves all pending entries from every ring into the batch as JSON lines.
+ * @param batch Output buffer
+ * @return std::size_t Number of entries drained
+ */
+std::size_t AccessLog::drain(std::string& batch) {
+
+    std::vector<Ring*> rings;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        for (const auto& ring : rings_) rings.push_back(ring.get());
+    }
+
+    std::size_t count = 0;
+    char line[128];
+
+    for (Ring* ring : rings) {
+
+        std::size_t tail = ring->tail.load(std::memory_order_relaxed);
+        std::size_t head = ring->head.load(std::memory_order_acquire);
+
+        for (; tail != head; ++tail, ++count) {
+
+            const AccessLogEntry& entry = ring->slots[tail & ring->mask];
+
+            std::snprintf(line, sizeof(line), "{\"ts\":%lld,\"method\":\"",
+                static_cast<long long>(entry.timestamp_us));
+            batch += line;
+            append_escaped(batch, entry.method);
+            batch += "\",\"route\":\"";
+            append_escaped(batch, entry.route);
+            std::snprintf(line, sizeof(line), "\",\"status\":%u,\"latency_us\":%u,\"bytes\":%u,\"client\":\"",
+                static_cast<unsigned>(entry.status), static_cast<unsigned>(entry.latency_us), static_cast<unsigned>(entry.bytes));
+            batch += line;
+            batch += entry.client.address().to_string();
+            batch += ':';
+            batch += std::to_string(entry.client.port());
+            batch += "\"}\n";
+
+        }
+
+        ring->tail.store(tail, std::memory_order_release);
+
+    }
+
+    return count;
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <boost/asio/ip/tcp.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Access log record. Fixed-size so the request path never allocates.
+struct AccessLogEntry {
+
+	std::int64_t timestamp_us;
+	std::uint32_t latency_us;
+	std::uint32_t bytes;
+	std::uint16_t status;
+	char method[8];
+	char route[64];
+	boost::asio::ip::tcp::endpoint client;
+
+};
+
+
+class AccessLog {
+public:
+
+	// Constructor ("-" writes to stdout)
+	explicit AccessLog(const std::string& path, std::size_t ring_capacity = 4096);
+
+	// Destructor
+	~AccessLog();
+
+	AccessLog(const AccessLog&) = delete;
+	AccessLog& operator=(const AccessLog&) = delete;
+
+	// Methods
+	void record(std::string_view method, std::string_view route, unsigned status,
+		std::chrono::microseconds latency, std::size_t bytes, const boost::asio::ip::tcp::endpoint& client);
+	std::uint64_t written() const;
+	std::uint64_t dropped() const;
+
+private:
+
+	// Single-producer/single-consumer ring, one per request thread
+	struct Ring {
+
+		explicit Ring(std::size_t capacity);
+
+		std::unique_ptr<AccessLogEntry[]> slots;
+		std::size_t mask;
+		alignas(64) std::atomic<std::size_t> head{ 0 };
+		alignas(64) std::atomic<std::size_t> tail{ 0 };
+		std::atomic<std::uint64_t> dropped{ 0 };
+
+	};
+
+	Ring& local_ring();
+	void writer_loop();
+	std::size_t drain(std::string& batch);
+
+	std::FILE* out_;
+	std::size_t ring_capacity_;
+	std::uint64_t instance_id_;
+
+	mutable std::mutex rings_mutex_;
+	std::vector<std::unique_ptr<Ring>> rings_;
+	std::unordered_map<std::thread::id, Ring*> thread_rings_;	// one ring, and producer, per thread
+
+	std::atomic<std::uint64_t> written_{ 0 };
+	std::uint64_t dropped_reported_ = 0;
+
+	std::mutex wake_mutex_;
+	std::condition_variable wake_;
+	bool stopping_ = false;
+	std::thread writer_;
+
+};
@@ -0,0 +1,363 @@
+#include "arrow_ipc.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <initializer_list>
+
+static_assert(std::endian::native == std::endian::little, "Arrow IPC and FlatBuffers data is written in host byte order");
+
+namespace {
+
+    // Values from the Arrow format definitions (Message.fbs, Schema.fbs)
+    constexpr std::int16_t metadata_v5 = 4;
+    constexpr std::uint8_t header_schema = 1;
+    constexpr std::uint8_t header_record_batch = 3;
+    constexpr std::uint8_t type_int = 2;
+    constexpr std::uint8_t type_utf8 = 5;
+    constexpr std::uint8_t type_bool = 6;
+    constexpr std::uint32_t continuation = 0xFFFFFFFFu;
+
+    // FieldNode and Buffer structs of a RecordBatch
+    struct Pair {
+
+        std::int64_t first;
+        std::int64_t second;
+
+    };
+
+    // Minimal FlatBuffers encoder that writes front to back. Offsets to strings, vectors
+    // and child tables are unsigned, so every object is written after the field pointing
+    // to it and patched in with link(); a table's vtable goes right before the table.
+    class FlatBuffer {
+    public:
+
+        // One field of a table: a scalar of 1, 2, 4 or 8 bytes, or (reference) an offset
+        // whose slot position is returned by table() for link()
+        struct Slot {
+
+            std::uint16_t id;
+            std::uint8_t size;
+            std::uint64_t value;
+            bool reference = false;
+
+        };
+
+        // Root offset, linked to the first table written
+        FlatBuffer() { put<std::uint32_t>(0); }
+
+        std::string& bytes() { return bytes_; }
+
+        template <typename T>
+        std::size_t put(T value) {
+
+            std::size_t at = bytes_.size();
+            bytes_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+            return at;
+
+        }
+
+        void align(std::size_t alignment, std::size_t shift = 0) {
+
+            while ((bytes_.size() + shift) % alignment != 0) bytes_ += '\0';
+
+        }
+
+        // Writes a table; references[id] receives the slot position of each reference field
+        std::size_t table(std::initializer_list<Slot> slots, std::size_t* references = nullptr) {
+
+            std::uint16_t field_count = 0;
+            std::size_t max_size = 4;
+            for (const Slot& slot : slots) {
+                field_count = std::max<std::uint16_t>(field_count, slot.id + 1);
+                max_size = std::max<std::size_t>(max_size, slot.size);
+            }
+
+            // Lay fields out by decreasing size after the 4-byte vtable offset
+            std::uint16_t field_offsets[16] = {};
+            std::uint16_t inline_size = 4;
+            for (std::uint8_t size : { 8, 4, 2, 1 }) {
+                for (const Slot& slot : slots) {
+                    if (slot.size != size) continue;
+                    inline_size = static_cast<std::uint16_t>((inline_size + size - 1) / size * size);
+                    field_offsets[slot.id] = inline_size;
+                    inline_size += size;
+                }
+            }
+
+            align(2);
+            std::size_t vtable = put<std::uint16_t>(static_cast<std::uint16_t>(4 + 2 * field_count));
+            put<std::uint16_t>(inline_size);
+            for (std::uint16_t id = 0; id < field_count; ++id) put<std::uint16_t>(field_offsets[id]);
+
+            align(max_size);
+            std::size_t table = put<std::int32_t>(static_cast<std::int32_t>(bytes_.size() - vtable));
+            bytes_.resize(table + inline_size, '\0');
+
+            for (const Slot& slot : slots) {
+                std::size_t at = table + field_offsets[slot.id];
+                std::memcpy(&bytes_[at], &slot.value, slot.size);
+                if (slot.reference && references) references[slot.id] = at;
+            }
+
+            return table;
+
+        }
+
+        std::size_t string(std::string_view text) {
+
+            align(4);
+            std::size_t at = put<std::uint32_t>(static_cast<std::uint32_t>(text.size()));
+            bytes_.append(text);
+            bytes_ += '\0';
+            return at;
+
+        }
+
+        // Vector of count offsets, all zero until linked; returns the first slot
+        std::size_t offset_vector(std::size_t count) {
+
+            align(4);
+            put<std::uint32_t>(static_cast<std::uint32_t>(count));
+            std::size_t first = bytes_.size();
+            bytes_.append(count * 4, '\0');
+            return first;
+
+        }
+
+        std::size_t pair_vector(const std::vector<Pair>& pairs) {
+
+            align(8, 4);
+            std::size_t at = put<std::uint32_t>(static_cast<std::uint32_t>(pairs.size()));
+            for (const Pair& pair : pairs) {
+                put(pair.first);
+                put(pair.second);
+            }
+            return at;
+
+        }
+
+        // Points the offset slot at to the object at target, which must come later
+        void link(std::size_t at, std::size_t target) {
+
+            std::uint32_t offset = static_cast<std::uint32_t>(target - at);
+            std::memcpy(&bytes_[at], &offset, 4);
+
+        }
+
+    private:
+
+        std::string bytes_;
+
+    };
+
+    // Message table with the given header; returns the header reference slot
+    std::size_t message(FlatBuffer& buffer, std::uint8_t header_type, std::int64_t body_length) {
+
+        std::size_t references[4] = {};
+        std::size_t table = buffer.table({
+            { 0, 2, static_cast<std::uint64_t>(metadata_v5) },
+            { 1, 1, header_type },
+            { 2, 4, 0, true },
+            { 3, 8, static_cast<std::uint64_t>(body_length) }
+        }, references);
+        buffer.link(0, table);
+        return references[2];
+
+    }
+
+    // Encapsulated message: continuation marker, metadata length, metadata padded to 8 bytes
+    void append_metadata(std::string& out, const std::string& metadata) {
+
+        std::size_t padded = (metadata.size() + 7) / 8 * 8;
+        std::uint32_t prefix[2] = { continuation, static_cast<std::uint32_t>(padded) };
+        out.append(reinterpret_cast<const char*>(prefix), sizeof(prefix));
+        out += metadata;
+        out.append(padded - metadata.size(), '\0');
+
+    }
+
+    std::size_t padded(std::size_t size) {
+
+        return (size + 7) / 8 * 8;
+
+    }
+
+}
+
+
+/**
+ * ArrowTaskWriter class constructor.
+ * Picks the columns in fields (all when none are given) and writes the schema message.
+ * @param out Stream the messages are appended to
+ * @param fields TaskField mask of the columns to write
+ * @param batch_rows Rows per record batch
+ */
+ArrowTaskWriter::ArrowTaskWriter(std::string& out, unsigned fields, std::size_t batch_rows)
+    : out_(out), batch_rows_(std::max<std::size_t>(batch_rows, 1)) {
+
+    if ((fields & field_all) == 0) fields = field_all;
+
+    for (std::size_t i = 0; i < task_column_count; ++i) {
+        const ColumnRule& rule = column_rules[i];
+        slots_[i] = (fields & rule.flag) ? static_cast<int>(columns_.size()) : -1;
+        if (fields & rule.flag) columns_.push_back({ rule.name, rule.kind, {}, { 0 } });
+    }
+
+    write_schema();
+
+}
+
+
+/**
+ * Appends an integer to the current row.
+ * @param column Index of the column in task_columns
+ * @param value Column value
+ */
+void ArrowTaskWriter::integer(std::size_t column, std::int64_t value) {
+
+    columns_[slots_[column]].values.append(reinterpret_cast<const char*>(&value), sizeof(value));
+
+}
+
+
+/**
+ * Appends a string to the current row.
+ * @param column Index of the column in task_columns
+ * @param value UTF-8 text
+ */
+void ArrowTaskWriter::text(std::size_t column, std::string_view value) {
+
+    Column& target = columns_[slots_[column]];
+    target.values += value;
+    target.offsets.push_back(static_cast<std::int32_t>(target.values.size()));
+    text_bytes_ += value.size();
+
+}
+
+
+/**
+ * Appends a boolean to the current row; bits are packed least significant first.
+ * @param column Index of the column in task_columns
+ * @param value Column value
+ */
+void ArrowTaskWriter::boolean(std::size_t column, bool value) {
+
+    Column& target = columns_[slots_[column]];
+    if (rows_ % 8 == 0) target.values += '\0';
+    if (value) target.values.back() = static_cast<char>(target.values.back() | (1 << (rows_ % 8)));
+
+}
+
+
+/**
+ * Completes the current row and emits a record batch when it is full.
+ */
+void ArrowTaskWriter::end_row() {
+
+    rows_++;
+    if (rows_ >= batch_rows_ || text_bytes_ >= max_batch_bytes) write_batch();
+
+}
+
+
+/**
+ * Emits the rows still buffered and the end-of-stream marker.
+ */
+void ArrowTaskWriter::finish() {
+
+    if (rows_ > 0) write_batch();
+
+    std::uint32_t end[2] = { continuation, 0 };
+    out_.append(reinterpret_cast<const char*>(end), sizeof(end));
+
+}
+
+
+/**
+ * Appends the schema message: one non-nullable field per written column.
+ */
+void ArrowTaskWriter::write_schema() {
+
+    FlatBuffer buffer;
+    std::size_t header = message(buffer, header_schema, 0);
+
+    std::size_t references[6] = {};
+    buffer.link(header, buffer.table({ { 1, 4, 0, true } }, references));
+    std::size_t field_slots = buffer.offset_vector(columns_.size());
+    buffer.link(references[1], field_slots - 4);
+
+    for (std::size_t i = 0; i < columns_.size(); ++i) {
+        const Column& column = columns_[i];
+        std::uint8_t type = column.kind == ColumnKind::text ? type_utf8 : column.kind == ColumnKind::boolean ? type_bool : type_int;
+
+        std::size_t field = buffer.table({
+            { 0, 4, 0, true },
+            { 1, 1, 0 },
+            { 2, 1, type },
+            { 3, 4, 0, true },
+            { 5, 4, 0, true }
+        }, references);
+        buffer.link(field_slots + 4 * i, field);
+
+        buffer.link(references[0], buffer.string(column.name));
+        if (type == type_int) buffer.link(references[3], buffer.table({ { 0, 4, 64 }, { 1, 1, 1 } }));
+        else buffer.link(references[3], buffer.table({}));
+        buffer.link(references[5], buffer.offset_vector(0) - 4);
+    }
+
+    append_metadata(out_, buffer.bytes());
+
+}
+
+
+/**
+ * Appends a record batch message with the buffered rows and starts a new batch.
+ * Each column has an empty validity buffer (no nulls) followed by its data buffers;
+ * every buffer starts on an 8-byte boundary of the body.
+ */
+void ArrowTaskWriter::write_batch() {
+
+    std::vector<Pair> nodes;
+    std::vector<Pair> buffers;
+    std::int64_t body_length = 0;
+
+    auto add_buffer = [&](std::size_t size) {
+        buffers.push_back({ body_length, static_cast<std::int64_t>(size) });
+        body_length += static_cast<std::int64_t>(padded(size));
+    };
+
+    for (const Column& column : columns_) {
+        nodes.push_back({ static_cast<std::int64_t>(rows_), 0 });
+        add_buffer(0);
+        if (column.kind == ColumnKind::text) add_buffer(column.offsets.size() * sizeof(std::int32_t));
+        add_buffer(column.values.size());
+    }
+
+    FlatBuffer buffer;
+    std::size_t header = message(buffer, header_record_batch, body_length);
+
+    std::size_t references[3] = {};
+    buffer.link(header, buffer.table({ { 0, 8, rows_ }, { 1, 4, 0, true }, { 2, 4, 0, true } }, references));
+    buffer.link(references[1], buffer.pair_vector(nodes));
+    buffer.link(references[2], buffer.pair_vector(buffers));
+
+    append_metadata(out_, buffer.bytes());
+
+    out_.reserve(out_.size() + static_cast<std::size_t>(body_length));
+    auto append_padded = [&](const char* data, std::size_t size) {
+        out_.append(data, size);
+        out_.append(padded(size) - size, '\0');
+    };
+
+    for (Column& column : columns_) {
+        if (column.kind == ColumnKind::text) append_padded(reinterpret_cast<const char*>(column.offsets.data()), column.offsets.size() * sizeof(std::int32_t));
+        append_padded(column.values.data(), column.values.size());
+
+        column.values.clear();
+        column.offsets.assign(1, 0);
+    }
+
+    rows_ = 0;
+    text_bytes_ = 0;
+
+}
\ No newline at end of file
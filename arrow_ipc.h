@@ -0,0 +1,53 @@
+#pragma once
+#include "database.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Writes task columns as an Arrow IPC stream (schema message, record batches, end-of-stream
+// marker) without an Arrow dependency. Values arrive row by row straight from a database
+// cursor (see Database::read_columns) and are laid out column-wise; a record batch is
+// emitted every batch_rows rows or once its text passes max_batch_bytes. Integers become
+// Int64, text Utf8 and booleans Bool columns, all non-nullable, named after the task columns.
+class ArrowTaskWriter : public ColumnSink {
+public:
+
+	static constexpr const char* content_type = "application/vnd.apache.arrow.stream";
+	static constexpr std::size_t default_batch_rows = 65536;
+	static constexpr std::size_t max_batch_bytes = 64u << 20;
+
+	// Constructor (appends the schema message to out)
+	ArrowTaskWriter(std::string& out, unsigned fields, std::size_t batch_rows = default_batch_rows);
+
+	// ColumnSink
+	void integer(std::size_t column, std::int64_t value) override;
+	void text(std::size_t column, std::string_view value) override;
+	void boolean(std::size_t column, bool value) override;
+	void end_row() override;
+
+	// Methods
+	void finish();	// last batch and the end-of-stream marker
+
+private:
+
+	struct Column {
+
+		std::string_view name;
+		ColumnKind kind;
+		std::string values;					// Int64 values, UTF-8 bytes or packed Bool bits
+		std::vector<std::int32_t> offsets;	// Utf8 only: start of each value, plus the end
+
+	};
+
+	void write_schema();
+	void write_batch();
+
+	std::string& out_;
+	std::vector<Column> columns_;
+	std::array<int, task_column_count> slots_;	// index in task_columns -> index in columns_, -1 if not written
+	std::size_t batch_rows_;
+	std::size_t rows_ = 0;
+	std::size_t text_bytes_ = 0;
+
+};
\ No newline at end of file
@@ -0,0 +1,1462 @@
+#include "bench_tool.h"
+#include "body_validator.h"
+#include "csv_import.h"
+#include "fast_request_parser.h"
+#include "http_server.h"
+#include "utf8.h"
+#include <boost/beast/ssl.hpp>
+#include <boost/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace json = boost::json;
+namespace fs = std::filesystem;
+
+namespace {
+
+    using clock_type = std::chrono::steady_clock;
+
+    struct BenchOptions {
+        unsigned runs = 5;
+        std::string baseline_path = "bench_baseline.json";
+        bool update = false;
+        double threshold = 0.05;
+        std::string filter;
+        unsigned requests = 2000;
+        unsigned clients = 8;
+        unsigned connections = 10000;
+    };
+
+    // Shared fixtures; created lazily so filtered runs only pay for what they use
+    class BenchContext {
+    public:
+
+        BenchContext(const BenchOptions& options)
+            : options_(options),
+              dir_(fs::temp_directory_path() / ("ars_bench_" + std::to_string(clock_type::now().time_since_epoch().count()))) {
+            fs::create_directories(dir_);
+        }
+
+        ~BenchContext() {
+            if (server_) {
+                io_context_.stop();
+                io_thread_.join();
+            }
+            server_.reset();
+            access_log_.reset();
+            task_manager_.reset();
+            db_.reset();
+            std::error_code ec;
+            fs::remove_all(dir_, ec);
+        }
+
+        const BenchOptions& options() const { return options_; }
+
+        std::string path(const std::string& name) const { return (dir_ / name).string(); }
+
+        // Server on an ephemeral port backed by a database with 100 tasks
+        unsigned short server_port() {
+
+            if (!server_) {
+                db_ = std::make_unique<Database>(path("load.db"));
+                db_->initialize();
+                db_->add_tasks(make_tasks(100));
+                task_manager_ = std::make_unique<TaskManager>(*db_);
+                access_log_ = std::make_unique<AccessLog>(path("access.log"), 1 << 16);
+                server_ = std::make_unique<HttpServer>(io_context_, 0, *task_manager_, *access_log_);
+                tls_context_ = std::make_unique<asio::ssl::context>(make_tls_context());
+                server_->listen_tls(0, *tls_context_);
+                io_thread_ = std::thread([this] { io_context_.run(); });
+            }
+
+            return server_->port();
+
+        }
+
+        unsigned short tls_port() {
+
+            server_port();
+            return server_->tls_port();
+
+        }
+
+        static std::vector<Task> make_tasks(std::size_t count) {
+
+            std::vector<Task> tasks(count);
+            for (std::size_t i = 0; i < count; ++i) {
+                tasks[i] = { 0, "Task " + std::to_string(i), "Description of benchmark task number " + std::to_string(i), i % 3 == 0 };
+            }
+            return tasks;
+
+        }
+
+    private:
+
+        const BenchOptions& options_;
+        fs::path dir_;
+
+        asio::io_context io_context_;
+        std::thread io_thread_;
+        std::unique_ptr<Database> db_;
+        std::unique_ptr<TaskManager> task_manager_;
+        std::unique_ptr<AccessLog> access_log_;
+        std::unique_ptr<asio::ssl::context> tls_context_;
+        std::unique_ptr<HttpServer> server_;
+
+    };
+
+    // One run of a benchmark may report several metrics
+    using MetricValues = std::map<std::string, double>;
+
+    struct Benchmark {
+        std::string name;
+        std::function<MetricValues(BenchContext&)> run;
+    };
+
+    struct MetricStats {
+        double mean = 0;
+        double stddev = 0;
+        unsigned runs = 0;
+        bool higher_is_better = false;
+    };
+
+    // Metric direction is encoded in the name suffix
+    bool higher_is_better(const std::string& metric) {
+
+        return metric.size() >= 4 && (metric.compare(metric.size() - 4, 4, "_rps") == 0 || metric.find("_per_s") != std::string::npos
+            || metric.find("_hit_rate") != std::string::npos);
+
+    }
+
+    double elapsed_ns(clock_type::time_point start) {
+
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - start).count());
+
+    }
+
+    // Drives --requests requests from --clients threads; each request uses a new connection
+    MetricValues run_load(BenchContext& context, const std::function<void(asio::io_context&)>& request_once) {
+
+        unsigned total = context.options().requests;
+        unsigned clients = std::max(1u, context.options().clients);
+
+        std::atomic<unsigned> next{ 0 };
+        std::vector<std::vector<double>> latencies(clients);
+        std::vector<std::thread> threads;
+
+        auto start = clock_type::now();
+
+        for (unsigned c = 0; c < clients; ++c) {
+            threads.emplace_back([&, c] {
+                asio::io_context io_context;
+
+                while (next++ < total) {
+                    auto sent = clock_type::now();
+                    request_once(io_context);
+                    latencies[c].push_back(elapsed_ns(sent) / 1000.0);
+                }
+            });
+        }
+
+        for (auto& thread : threads) thread.join();
+        double seconds = elapsed_ns(start) / 1e9;
+
+        std::vector<double> all;
+        for (const auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+        std::sort(all.begin(), all.end());
+
+        return {
+            { "throughput_rps", all.size() / seconds },
+            { "p99_us", all.empty() ? 0.0 : all[static_cast<std::size_t>(0.99 * (all.size() - 1))] }
+        };
+
+    }
+
+    MetricValues load_get_tasks(BenchContext& context) {
+
+        tcp::endpoint endpoint(asio::ip::address_v4::loopback(), context.server_port());
+
+        return run_load(context, [&](asio::io_context& io_context) {
+            beast::tcp_stream stream(io_context);
+            stream.connect(endpoint);
+
+            http::request<http::empty_body> req{ http::verb::get, "/tasks", 11 };
+            http::write(stream, req);
+
+            beast::flat_buffer buffer;
+            http::response<http::string_body> res;
+            http::read(stream, buffer, res);
+        });
+
+    }
+
+    // Connects and handshakes; offers session for resumption and optionally runs GET /tasks
+    bool tls_exchange(asio::io_context& io_context, asio::ssl::context& client_context, const tcp::endpoint& endpoint,
+        SSL_SESSION* session, bool send_request, SSL_SESSION** new_session = nullptr) {
+
+        beast::ssl_stream<beast::tcp_stream> stream(io_context, client_context);
+        beast::get_lowest_layer(stream).connect(endpoint);
+
+        if (session) SSL_set_session(stream.native_handle(), session);
+        stream.handshake(asio::ssl::stream_base::client);
+        bool reused = SSL_session_reused(stream.native_handle()) == 1;
+
+        if (send_request) {
+            http::request<http::empty_body> req{ http::verb::get, "/tasks", 11 };
+            http::write(stream, req);
+
+            beast::flat_buffer buffer;
+            http::response<http::string_body> res;
+            http::read(stream, buffer, res);
+
+            // TLS 1.3 tickets arrive after the handshake, so the session is taken after reading
+            if (new_session) *new_session = SSL_get1_session(stream.native_handle());
+        }
+
+        // Skip close_notify but mark the connection cleanly shut down, otherwise OpenSSL
+        // flags the session as not resumable when the stream is destroyed
+        SSL_set_shutdown(stream.native_handle(), SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+        beast::error_code ec;
+        beast::get_lowest_layer(stream).socket().close(ec);
+        return reused;
+
+    }
+
+    asio::ssl::context make_client_context() {
+
+        asio::ssl::context ctx(asio::ssl::context::tls_client);
+        ctx.set_verify_mode(asio::ssl::verify_none);
+        return ctx;
+
+    }
+
+    MetricValues tls_handshake(BenchContext& context) {
+
+        constexpr int handshakes = 100;
+        tcp::endpoint endpoint(asio::ip::address_v4::loopback(), context.tls_port());
+        asio::io_context io_context;
+        asio::ssl::context client_context = make_client_context();
+
+        SSL_SESSION* session = nullptr;
+        tls_exchange(io_context, client_context, endpoint, nullptr, true, &session);
+        if (!session) throw std::runtime_error("Server issued no TLS session");
+
+        auto start = clock_type::now();
+        for (int i = 0; i < handshakes; ++i) tls_exchange(io_context, client_context, endpoint, nullptr, false);
+        double full_us = elapsed_ns(start) / handshakes / 1000.0;
+
+        int reused = 0;
+        start = clock_type::now();
+        for (int i = 0; i < handshakes; ++i) reused += tls_exchange(io_context, client_context, endpoint, session, false);
+        double resumed_us = elapsed_ns(start) / handshakes / 1000.0;
+
+        SSL_SESSION_free(session);
+        if (reused != handshakes) throw std::runtime_error("TLS session was not resumed");
+
+        return { { "full_us", full_us }, { "resumed_us", resumed_us } };
+
+    }
+
+    MetricValues tls_get_tasks(BenchContext& context) {
+
+        tcp::endpoint endpoint(asio::ip::address_v4::loopback(), context.tls_port());
+        asio::ssl::context client_context = make_client_context();
+
+        // Each client thread keeps its own session, like a browser or SDK would
+        return run_load(context, [&](asio::io_context& io_context) {
+            thread_local std::unique_ptr<SSL_SESSION, decltype(&SSL_SESSION_free)> session(nullptr, &SSL_SESSION_free);
+
+            SSL_SESSION* next_session = nullptr;
+            tls_exchange(io_context, client_context, endpoint, session.get(), true, &next_session);
+            session.reset(next_session);
+        });
+
+    }
+
+    MetricValues micro_access_log_record(BenchContext& context) {
+
+        constexpr int ops = 200000;
+        AccessLog log(context.path("micro_access.log"), 1 << 18);
+        tcp::endpoint client(asio::ip::address_v4::loopback(), 40000);
+
+        auto start = clock_type::now();
+        for (int i = 0; i < ops; ++i) {
+            log.record("GET", "/tasks", 200, std::chrono::microseconds(120), 512, client);
+        }
+        return { { "record_ns", elapsed_ns(start) / ops } };
+
+    }
+
+    MetricValues micro_query_profiler_record(BenchContext&) {
+
+        constexpr int ops = 1000000;
+        QueryProfiler profiler;
+        const char* sql = "SELECT id, title, description, completed FROM tasks WHERE id = ?;";
+
+        auto start = clock_type::now();
+        for (int i = 0; i < ops; ++i) profiler.record(sql, 1000 + (i & 1023), 0, 12);
+        return { { "record_ns", elapsed_ns(start) / ops } };
+
+    }
+
+    MetricValues micro_bulk_insert(BenchContext& context) {
+
+        constexpr std::size_t rows = 100000;
+        std::string path = context.path("bulk.db");
+        fs::remove(path);
+
+        auto tasks = BenchContext::make_tasks(rows);
+        double seconds;
+        {
+            Database db(path);
+            db.set_profiling(false);
+            db.configure_bulk_load();
+            db.initialize();
+
+            auto start = clock_type::now();
+            db.add_tasks(tasks);
+            seconds = elapsed_ns(start) / 1e9;
+        }
+        fs::remove(path);
+
+        return { { "rows_per_s", rows / seconds } };
+
+    }
+
+    MetricValues micro_get_all_tasks(BenchContext& context) {
+
+        constexpr int calls = 100;
+        std::string path = context.path("scan.db");
+
+        if (!fs::exists(path)) {
+            Database db(path);
+            db.initialize();
+            db.add_tasks(BenchContext::make_tasks(1000));
+        }
+
+        Database db(path);
+        db.set_profiling(false);
+
+        std::size_t rows = 0;
+        auto start = clock_type::now();
+        for (int i = 0; i < calls; ++i) rows += db.get_all_tasks().size();
+        double all_us = elapsed_ns(start) / calls / 1000.0;
+
+        start = clock_type::now();
+        for (int i = 0; i < calls; ++i) rows += db.get_all_tasks(field_id | field_completed).size();
+        double projected_us = elapsed_ns(start) / calls / 1000.0;
+
+        if (rows == 0) throw std::runtime_error("Scan benchmark read no rows");
+
+        return { { "1k_rows_us", all_us }, { "1k_rows_id_completed_us", projected_us } };
+
+    }
+
+    // Ids 1..keys drawn with Zipf(skew) popularity; rank is shuffled over ids so hot ids
+    // are not clustered. hottest, if given, receives the id of rank 0.
+    std::vector<int> zipf_trace(std::size_t keys, std::size_t accesses, double skew, int* hottest) {
+
+        std::vector<double> cdf(keys);
+        double sum = 0;
+        for (std::size_t i = 0; i < keys; ++i) cdf[i] = sum += 1.0 / std::pow(static_cast<double>(i + 1), skew);
+
+        std::vector<int> rank_to_id(keys);
+        for (std::size_t i = 0; i < keys; ++i) rank_to_id[i] = static_cast<int>(i + 1);
+        std::mt19937_64 rng(42);
+        std::shuffle(rank_to_id.begin(), rank_to_id.end(), rng);
+        if (hottest) *hottest = rank_to_id[0];
+
+        std::uniform_real_distribution<double> uniform(0.0, sum);
+        std::vector<int> trace(accesses);
+        for (auto& id : trace) id = rank_to_id[std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin()];
+        return trace;
+
+    }
+
+    MetricValues micro_heavy_hitters(BenchContext& context) {
+
+        int hottest = 0;
+        std::vector<int> trace = zipf_trace(100000, 1000000, 0.99, &hottest);
+
+        HeavyHitters hitters(32);
+        auto start = clock_type::now();
+        for (int id : trace) hitters.record(static_cast<std::uint64_t>(id));
+        double record_ns = elapsed_ns(start) / trace.size();
+
+        auto top = hitters.top();
+        if (top.empty() || top.front().key != static_cast<std::uint64_t>(hottest)) throw std::runtime_error("Heavy hitters missed the hottest key");
+
+        return { { "record_ns", record_ns } };
+
+    }
+
+    // Zipf(0.99) over 100k tasks with room for about 2% of them; misses are filled as a read-through would
+    MetricValues micro_task_cache(BenchContext& context) {
+
+        constexpr std::size_t keys = 100000;
+        constexpr std::size_t accesses = 1000000;
+
+        std::vector<Task> tasks = BenchContext::make_tasks(keys);
+        for (std::size_t i = 0; i < keys; ++i) tasks[i].id = static_cast<int>(i + 1);
+
+        std::vector<int> trace = zipf_trace(keys, accesses, 0.99, nullptr);
+
+        std::size_t budget = 2000 * (sizeof(Task) + 160);
+        MetricValues metrics;
+
+        for (auto [policy, name] : { std::pair{ TaskCache::Policy::tiny_lfu, "tinylfu" }, std::pair{ TaskCache::Policy::lru, "lru" } }) {
+
+            TaskCache cache(budget, policy);
+
+            auto start = clock_type::now();
+            for (int id : trace) {
+                if (!cache.get(id)) cache.put(tasks[id - 1], cache.epoch());
+            }
+            double seconds = elapsed_ns(start) / 1e9;
+
+            TaskCacheStats stats = cache.stats();
+            metrics[std::string(name) + "_hit_rate"] = static_cast<double>(stats.hits) / accesses;
+            metrics[std::string(name) + "_lookups_per_s"] = accesses / seconds;
+
+        }
+
+        return metrics;
+
+    }
+
+    // 8 editors each send bursts of 8 rapid updates to one of 20 hot tasks and wait for
+    // every acknowledgement; compares write-through with a 2 ms coalescing window
+    MetricValues micro_write_coalescing(BenchContext& context) {
+
+        constexpr int editors = 8;
+        constexpr int bursts = 10;
+        constexpr int burst_length = 8;
+        constexpr int hot_tasks = 20;
+
+        MetricValues metrics;
+
+        for (bool coalesce : { false, true }) {
+
+            std::string path = context.path(coalesce ? "coalesce.db" : "write_through.db");
+            fs::remove(path);
+
+            Database db(path);
+            db.initialize();
+            db.set_profiling(false);
+            db.add_tasks(BenchContext::make_tasks(hot_tasks));
+
+            TaskManager task_manager(db);
+            if (coalesce) task_manager.set_write_coalescing(std::chrono::milliseconds(2));
+
+            std::vector<std::thread> threads;
+            auto start = clock_type::now();
+
+            for (int e = 0; e < editors; ++e) {
+                threads.emplace_back([&, e] {
+                    std::mt19937 rng(e);
+                    for (int b = 0; b < bursts; ++b) {
+                        // A burst arrives as concurrent requests, like a UI that does not wait for each save
+                        int id = static_cast<int>(rng() % hot_tasks) + 1;
+                        std::vector<std::future<bool>> acks;
+                        for (int i = 0; i < burst_length; ++i) {
+                            acks.push_back(std::async(std::launch::async, [&, id, i] {
+                                return task_manager.update_task(id, "Edited title " + std::to_string(i), "Edited by editor " + std::to_string(e), i % 2 == 0);
+                            }));
+                        }
+                        for (auto& ack : acks) ack.get();
+                    }
+                });
+            }
+
+            for (auto& thread : threads) thread.join();
+            double seconds = elapsed_ns(start) / 1e9;
+            double updates = editors * bursts * burst_length;
+
+            if (coalesce) {
+                WriteBatchStats stats = task_manager.get_write_stats();
+                metrics["updates_per_s"] = updates / seconds;
+                metrics["write_amplification"] = stats.written / updates;
+                metrics["commits"] = static_cast<double>(stats.commits);
+            }
+            else {
+                metrics["direct_updates_per_s"] = updates / seconds;
+            }
+
+        }
+
+        return metrics;
+
+    }
+
+    // Flipping completed on 1000 tasks inside one transaction: full update (pre-read and
+    // all columns) against a patch of the single column
+    MetricValues micro_patch(BenchContext& context) {
+
+        constexpr int tasks = 1000;
+        std::string path = context.path("patch.db");
+        fs::remove(path);
+
+        Database db(path);
+        db.initialize();
+        db.set_profiling(false);
+        db.add_tasks(BenchContext::make_tasks(tasks));
+
+        TaskManager task_manager(db);
+        std::vector<Task> rows = db.get_all_tasks();
+
+        db.begin_transaction();
+        auto start = clock_type::now();
+        for (const auto& task : rows) task_manager.update_task(task.id, task.title, task.description, !task.completed);
+        double update_us = elapsed_ns(start) / tasks / 1000.0;
+
+        start = clock_type::now();
+        for (const auto& task : rows) task_manager.patch_task(task.id, { std::nullopt, std::nullopt, task.completed });
+        double patch_us = elapsed_ns(start) / tasks / 1000.0;
+        db.commit_transaction();
+
+        return { { "toggle_update_us", update_us }, { "toggle_patch_us", patch_us } };
+
+    }
+
+    // 8 writers each patch 100 random tasks at one durability level; per-write latency as
+    // the caller sees it and overall throughput (async is acknowledged before it commits)
+    MetricValues micro_durability(BenchContext& context) {
+
+        constexpr int writers = 8;
+        constexpr int writes_per_writer = 100;
+        constexpr int tasks = 1000;
+
+        const std::pair<const char*, Durability> levels[] = {
+            { "strict", Durability::strict }, { "batched", Durability::batched }, { "async", Durability::async }
+        };
+
+        MetricValues metrics;
+
+        for (const auto& [name, level] : levels) {
+
+            std::string path = context.path(std::string("durability_") + name + ".db");
+            fs::remove(path);
+
+            Database db(path);
+            db.initialize();
+            db.set_profiling(false);
+            db.add_tasks(BenchContext::make_tasks(tasks));
+
+            TaskManager task_manager(db);
+
+            std::vector<std::thread> threads;
+            std::atomic<std::int64_t> write_ns{ 0 };
+            auto start = clock_type::now();
+
+            for (int w = 0; w < writers; ++w) {
+                threads.emplace_back([&, w] {
+                    std::mt19937 rng(w);
+                    for (int i = 0; i < writes_per_writer; ++i) {
+                        int id = static_cast<int>(rng() % tasks) + 1;
+                        auto write_start = clock_type::now();
+                        task_manager.patch_task(id, { std::nullopt, std::nullopt, i % 2 == 0 }, level);
+                        write_ns += static_cast<std::int64_t>(elapsed_ns(write_start));
+                    }
+                });
+            }
+
+            for (auto& thread : threads) thread.join();
+            double seconds = elapsed_ns(start) / 1e9;
+            double writes = writers * writes_per_writer;
+
+            metrics[std::string(name) + "_us"] = write_ns / writes / 1000.0;
+            metrics[std::string(name) + "_per_s"] = writes / seconds;
+
+        }
+
+        return metrics;
+
+    }
+
+    // 100 mixed operations (creates, updates, deletes) sent one request at a time against
+    // the same operations as one transactional batch; cost per operation
+    MetricValues micro_batch(BenchContext& context) {
+
+        constexpr int tasks = 1000;
+        constexpr int rounds = 5;
+        std::string path = context.path("batch.db");
+        fs::remove(path);
+
+        Database db(path);
+        db.initialize();
+        db.set_profiling(false);
+        db.add_tasks(BenchContext::make_tasks(tasks));
+
+        TaskManager task_manager(db);
+
+        // 40 creates, 40 updates and 20 deletes of tasks no round has touched yet
+        auto make_ops = [](int round) {
+            std::vector<TaskOp> ops;
+            for (int i = 0; i < 40; ++i) ops.push_back({ TaskOp::Kind::create, 0, { "Batch task " + std::to_string(i), "Created in a batch", false } });
+            for (int i = 0; i < 40; ++i) ops.push_back({ TaskOp::Kind::update, round * 100 + i + 1, { std::nullopt, std::nullopt, true } });
+            for (int i = 0; i < 20; ++i) ops.push_back({ TaskOp::Kind::remove, round * 100 + 50 + i + 1, {} });
+            return ops;
+        };
+
+        double single_ns = 0;
+        double batch_ns = 0;
+        double ops_count = 0;
+
+        for (int round = 0; round < rounds; ++round) {
+
+            std::vector<TaskOp> ops = make_ops(round * 2);
+            auto start = clock_type::now();
+            for (const auto& op : ops) {
+                switch (op.kind) {
+                case TaskOp::Kind::create: task_manager.create_task(*op.fields.title, *op.fields.description); break;
+                case TaskOp::Kind::update: task_manager.patch_task(op.id, op.fields); break;
+                case TaskOp::Kind::remove: task_manager.delete_task(op.id); break;
+                }
+            }
+            single_ns += elapsed_ns(start);
+
+            ops = make_ops(round * 2 + 1);
+            start = clock_type::now();
+            task_manager.apply_batch(ops);
+            batch_ns += elapsed_ns(start);
+
+            ops_count += static_cast<double>(ops.size());
+
+        }
+
+        return { { "single_op_us", single_ns / ops_count / 1000.0 }, { "batch_op_us", batch_ns / ops_count / 1000.0 } };
+
+    }
+
+    // 100k idle connections' deadlines: re-arming one (what every read does) and the
+    // per-tick cost of the shared wheel, against one asio timer per connection
+    MetricValues micro_timer_wheel(BenchContext&) {
+
+        constexpr int connections = 100000;
+        constexpr int rearms = 1000000;
+        constexpr auto idle = std::chrono::seconds(60);
+
+        std::mt19937 rng(1);
+        std::vector<int> order(rearms);
+        for (auto& index : order) index = static_cast<int>(rng() % connections);
+
+        auto start_time = clock_type::now();
+        TimerWheel wheel(std::chrono::milliseconds(100), start_time);
+        std::vector<std::unique_ptr<TimerWheel::Timer>> timers;
+        std::size_t expired = 0;
+        for (int i = 0; i < connections; ++i) {
+            timers.push_back(std::make_unique<TimerWheel::Timer>([&expired] { expired++; }));
+            wheel.schedule(*timers.back(), idle);
+        }
+
+        auto start = clock_type::now();
+        for (int index : order) wheel.schedule(*timers[index], idle);
+        double wheel_rearm_ns = elapsed_ns(start) / rearms;
+
+        // Ten simulated seconds of ticks, including the cascades; nothing is due yet
+        constexpr int ticks = 100;
+        start = clock_type::now();
+        for (int t = 1; t <= ticks; ++t) wheel.advance(start_time + t * wheel.tick());
+        double wheel_tick_us = elapsed_ns(start) / ticks / 1000.0;
+        if (expired != 0 || wheel.size() != connections) throw std::runtime_error("Timer wheel fired early");
+
+        // Then run past the idle timeout so every connection expires
+        start = clock_type::now();
+        wheel.advance(start_time + std::chrono::seconds(70));
+        double wheel_expire_ns = elapsed_ns(start) / connections;
+        if (expired != connections) throw std::runtime_error("Timer wheel missed deadlines");
+
+        asio::io_context io_context;
+        std::vector<std::unique_ptr<asio::steady_timer>> asio_timers;
+        for (int i = 0; i < connections; ++i) {
+            asio_timers.push_back(std::make_unique<asio::steady_timer>(io_context, idle));
+            asio_timers.back()->async_wait([](beast::error_code) {});
+        }
+
+        // Re-arming cancels the pending wait, whose handler then has to run
+        start = clock_type::now();
+        for (int i = 0; i < rearms; ++i) {
+            auto& timer = *asio_timers[order[i]];
+            timer.expires_after(idle);
+            timer.async_wait([](beast::error_code) {});
+            if (i % 1024 == 0) io_context.poll();
+        }
+        io_context.poll();
+        double asio_rearm_ns = elapsed_ns(start) / rearms;
+
+        return { { "wheel_rearm_ns", wheel_rearm_ns }, { "wheel_tick_us", wheel_tick_us }, { "wheel_expire_ns", wheel_expire_ns },
+            { "asio_rearm_ns", asio_rearm_ns } };
+
+    }
+
+    // Parse cost per request of each shape (40, 82, 609 and 185 bytes): Beast's
+    // request_parser against parse_request_head alone and with the ApiRequest viewed
+    // from it, which is what HttpSession hands the handler
+    MetricValues micro_http_parse(BenchContext&) {
+
+        const std::pair<std::string, std::string> requests[] = {
+            { "tiny", "GET /tasks HTTP/1.1\r\nHost: localhost\r\n\r\n" },
+            { "curl", "GET /tasks HTTP/1.1\r\nHost: localhost:8081\r\nUser-Agent: curl/8.5.0\r\nAccept: */*\r\n\r\n" },
+            { "browser", "GET /tasks?ids=1,2,3 HTTP/1.1\r\nHost: localhost:8081\r\nConnection: keep-alive\r\n"
+                "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+                "sec-ch-ua-mobile: ?0\r\nsec-ch-ua-platform: \"Windows\"\r\nUpgrade-Insecure-Requests: 1\r\n"
+                "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+                "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+                "Sec-Fetch-Site: none\r\nSec-Fetch-Mode: navigate\r\nSec-Fetch-Dest: document\r\n"
+                "Accept-Encoding: gzip, deflate, br, zstd\r\nAccept-Language: en-US,en;q=0.9\r\n\r\n" },
+            { "post", "POST /tasks HTTP/1.1\r\nHost: localhost:8081\r\nUser-Agent: curl/8.5.0\r\nAccept: */*\r\n"
+                "Content-Type: application/json\r\nContent-Length: 49\r\n\r\n{\"title\":\"Write report\",\"description\":\"Q3 draft\"}" }
+        };
+        constexpr int iterations = 200000;
+
+        MetricValues metrics;
+        for (const auto& [name, text] : requests) {
+
+            std::size_t checksum = 0;
+
+            auto start = clock_type::now();
+            for (int i = 0; i < iterations; ++i) {
+                http::request_parser<http::string_body> parser;
+                beast::error_code ec;
+                std::size_t used = 0;
+                while (!ec && !parser.is_done()) used += parser.put(asio::buffer(text.data() + used, text.size() - used), ec);
+                if (ec) throw std::runtime_error("Beast rejected the " + name + " request");
+                checksum += parser.get().target().size();
+            }
+            double beast_ns = elapsed_ns(start) / iterations;
+
+            start = clock_type::now();
+            for (int i = 0; i < iterations; ++i) {
+                RequestHead head;
+                if (parse_request_head(text, head) != HeadParse::complete) throw std::runtime_error("Fast parser rejected the " + name + " request");
+                checksum += head.target.size() + head.header_count;
+            }
+            double fast_ns = elapsed_ns(start) / iterations;
+
+            start = clock_type::now();
+            for (int i = 0; i < iterations; ++i) {
+                RequestHead head;
+                parse_request_head(text, head);
+                ApiRequest request = api_request(head, std::string_view(text).substr(head.size, head.content_length));
+                checksum += request.target.size();
+            }
+            double fast_request_ns = elapsed_ns(start) / iterations;
+
+            if (checksum == 0) throw std::runtime_error("Parsers produced nothing");
+
+            metrics[name + "_beast_ns"] = beast_ns;
+            metrics[name + "_fast_ns"] = fast_ns;
+            metrics[name + "_fast_req_ns"] = fast_request_ns;
+
+        }
+
+        return metrics;
+
+    }
+
+    // Streaming body validation: a typical POST /tasks body, fed in one piece, and a
+    // 1000-operation POST /batch body fed in 1500-byte pieces as it would arrive
+    MetricValues micro_body_validator(BenchContext&) {
+
+        const std::string create_body = R"({"title":"Write report","description":"Quarterly numbers, first draft"})";
+        std::string batch_body = R"({"ops":[)";
+        for (int i = 0; i < 1000; ++i) batch_body += std::string(i ? "," : "") + R"({"op":"update","id":)" + std::to_string(i + 1) + R"(,"title":"Task )" + std::to_string(i) + R"(","completed":true})";
+        batch_body += "]}";
+
+        constexpr int iterations = 200000;
+        auto start = clock_type::now();
+        for (int i = 0; i < iterations; ++i) {
+            BodyValidator validator(BodySchema::new_task);
+            if (!validator.write(create_body) || !validator.finish()) throw std::runtime_error("Create body rejected: " + validator.error());
+        }
+        double create_ns = elapsed_ns(start) / iterations;
+
+        constexpr int batches = 200;
+        start = clock_type::now();
+        for (int i = 0; i < batches; ++i) {
+            BodyValidator validator(BodySchema::json);
+            for (std::size_t pos = 0; pos < batch_body.size(); pos += 1500) validator.write(std::string_view(batch_body).substr(pos, 1500));
+            if (!validator.finish()) throw std::runtime_error("Batch body rejected: " + validator.error());
+        }
+        double batch_mb_per_s = static_cast<double>(batch_body.size()) * batches / (elapsed_ns(start) / 1e9) / 1e6;
+
+        return { { "create_ns", create_ns }, { "batch_mb_per_s", batch_mb_per_s } };
+
+    }
+
+    // UTF-8 validation and counting on 64 KB descriptions, all ASCII and mixed-script,
+    // and its share of a strict create_task carrying the mixed one
+    MetricValues micro_utf8(BenchContext& context) {
+
+        constexpr std::size_t size = 64 * 1024;
+        std::string ascii;
+        while (ascii.size() < size) ascii += "Quarterly numbers, first draft; check totals against the ledger. ";
+        std::string mixed;
+        while (mixed.size() < size) mixed += "Draft report \xd0\xbe\xd1\x82\xd1\x87\xd1\x91\xd1\x82 \xe5\xa0\xb1\xe5\x91\x8a caf\xc3\xa9 \xf0\x9f\x93\x88 ";
+
+        auto throughput = [](const std::string& text) {
+            constexpr int iterations = 2000;
+            std::size_t total = 0;
+            auto start = clock_type::now();
+            for (int i = 0; i < iterations; ++i) total += utf8_length(text).value_or(0);
+            double seconds = elapsed_ns(start) / 1e9;
+            if (total == 0) throw std::runtime_error("UTF-8 sample rejected");
+            return static_cast<double>(text.size()) * iterations / seconds / 1e9;
+        };
+
+        double ascii_gb_per_s = throughput(ascii);
+        double mixed_gb_per_s = throughput(mixed);
+
+        std::string path = context.path("utf8.db");
+        fs::remove(path);
+        Database db(path);
+        db.initialize();
+        db.set_profiling(false);
+        TaskManager task_manager(db);
+
+        constexpr int creates = 200;
+        auto start = clock_type::now();
+        for (int i = 0; i < creates; ++i) task_manager.create_task("Task " + std::to_string(i), mixed, Durability::strict);
+        double create_ns = elapsed_ns(start) / creates;
+        double validate_ns = static_cast<double>(mixed.size()) / mixed_gb_per_s;
+
+        return { { "ascii_gb_per_s", ascii_gb_per_s }, { "mixed_gb_per_s", mixed_gb_per_s }, { "create_share_pct", validate_ns / create_ns * 100.0 } };
+
+    }
+
+    // Full-table read and GET /tasks/export of 100k tasks with 1, 2, 4 and 8 scan threads.
+    // The export reads and serializes each id range on its scan thread and joins the pieces.
+    MetricValues scan_parallel(BenchContext& context) {
+
+        constexpr int scans = 5;
+        std::string path = context.path("parallel_scan.db");
+
+        if (!fs::exists(path)) {
+            Database db(path);
+            db.initialize();
+            db.add_tasks(BenchContext::make_tasks(100000));
+        }
+
+        MetricValues metrics;
+
+        for (unsigned threads : { 1u, 2u, 4u, 8u }) {
+
+            std::string prefix = std::to_string(threads) + "t_";
+
+            Database db(path);
+            db.set_profiling(false);
+            TaskManager task_manager(db);
+            task_manager.set_scan_threads(threads);
+            AccessLog access_log(context.path("parallel_scan.log"), 1 << 16);
+
+            std::atomic<std::size_t> rows{ 0 };
+            auto start = clock_type::now();
+            for (int i = 0; i < scans; ++i) task_manager.scan_tasks(field_all, [&](std::size_t, std::vector<Task>& tasks) { rows += tasks.size(); });
+            metrics[prefix + "read_ms"] = elapsed_ns(start) / scans / 1e6;
+            if (rows != 100000u * scans) throw std::runtime_error("Parallel scan read " + std::to_string(rows) + " rows");
+
+            asio::io_context server_io;
+            HttpServer server(server_io, 0, task_manager, access_log);
+            std::thread server_thread([&] { server_io.run(); });
+
+            asio::io_context client_io;
+            tcp::socket socket(client_io);
+            socket.connect({ asio::ip::address_v4::loopback(), server.port() });
+            beast::flat_buffer buffer;
+
+            start = clock_type::now();
+            for (int i = 0; i < scans; ++i) {
+                http::request<http::empty_body> req{ http::verb::get, "/tasks/export", 11 };
+                http::write(socket, req);
+
+                http::response_parser<http::string_body> parser;
+                parser.body_limit(std::numeric_limits<std::uint64_t>::max());
+                http::read(socket, buffer, parser);
+                if (parser.get().result() != http::status::ok) throw std::runtime_error("Export failed: " + parser.get().body());
+            }
+            metrics[prefix + "export_ms"] = elapsed_ns(start) / scans / 1e6;
+
+            socket.close();
+            server_io.stop();
+            server_thread.join();
+
+        }
+
+        return metrics;
+
+    }
+
+    // Startup against 100k tasks with a 64 MB cache: time until the first GET /tasks?ids=1
+    // is answered and until the cache is warm, with the warm-up in the background (serving
+    // from SQLite meanwhile) and, for comparison, run to completion before the server starts
+    MetricValues startup_warmup(BenchContext& context) {
+
+        std::string path = context.path("warmup.db");
+
+        if (!fs::exists(path)) {
+            Database db(path);
+            db.initialize();
+            db.add_tasks(BenchContext::make_tasks(100000));
+        }
+
+        MetricValues metrics;
+
+        for (bool background : { true, false }) {
+
+            std::string prefix = background ? "" : "blocking_";
+
+            Database db(path);
+            db.set_profiling(false);
+            AccessLog access_log(context.path("warmup.log"), 1 << 16);
+
+            auto start = clock_type::now();
+
+            TaskManager task_manager(db, 64u << 20);
+            task_manager.set_scan_threads(0);
+            task_manager.warm_cache(background);
+
+            asio::io_context server_io;
+            HttpServer server(server_io, 0, task_manager, access_log);
+            std::thread server_thread([&] { server_io.run(); });
+
+            asio::io_context client_io;
+            tcp::socket socket(client_io);
+            socket.connect({ asio::ip::address_v4::loopback(), server.port() });
+            http::request<http::empty_body> req{ http::verb::get, "/tasks?ids=1", 11 };
+            http::write(socket, req);
+            beast::flat_buffer buffer;
+            http::response<http::string_body> res;
+            http::read(socket, buffer, res);
+            metrics[prefix + "first_request_ms"] = elapsed_ns(start) / 1e6;
+
+            WarmupStats warmup;
+            while (!(warmup = task_manager.get_warmup_stats()).warm) {
+                if (warmup.failed) throw std::runtime_error("Warm-up failed: " + warmup.error);
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            metrics[prefix + "warm_ms"] = elapsed_ns(start) / 1e6;
+
+            if (task_manager.get_cache_stats().entries == 0) throw std::runtime_error("Warm-up cached no tasks");
+
+            socket.close();
+            server_io.stop();
+            server_thread.join();
+
+        }
+
+        return metrics;
+
+    }
+
+    // GET /tasks/export of 100k tasks as JSON and as an Arrow IPC stream: response size and
+    // time until the whole body has arrived. Consumer-side parsing needs an Arrow reader and
+    // is not measured here.
+    MetricValues export_arrow(BenchContext& context) {
+
+        constexpr int exports = 5;
+        std::string path = context.path("export.db");
+
+        if (!fs::exists(path)) {
+            Database db(path);
+            db.initialize();
+            db.add_tasks(BenchContext::make_tasks(100000));
+        }
+
+        Database db(path);
+        db.set_profiling(false);
+        TaskManager task_manager(db);
+        AccessLog access_log(context.path("export.log"), 1 << 16);
+
+        asio::io_context server_io;
+        HttpServer server(server_io, 0, task_manager, access_log);
+        std::thread server_thread([&] { server_io.run(); });
+
+        asio::io_context client_io;
+        tcp::socket socket(client_io);
+        socket.connect({ asio::ip::address_v4::loopback(), server.port() });
+        beast::flat_buffer buffer;
+
+        MetricValues metrics;
+
+        for (std::string format : { "json", "arrow" }) {
+            std::size_t bytes = 0;
+            auto start = clock_type::now();
+
+            for (int i = 0; i < exports; ++i) {
+                http::request<http::empty_body> req{ http::verb::get, "/tasks/export?format=" + format, 11 };
+                http::write(socket, req);
+
+                http::response_parser<http::string_body> parser;
+                parser.body_limit(std::numeric_limits<std::uint64_t>::max());
+                http::read(socket, buffer, parser);
+                if (parser.get().result() != http::status::ok) throw std::runtime_error("Export failed: " + parser.get().body());
+                bytes = parser.get().body().size();
+            }
+
+            metrics[format + "_export_ms"] = elapsed_ns(start) / exports / 1e6;
+            metrics[format + "_bytes"] = static_cast<double>(bytes);
+        }
+
+        socket.close();
+        server_io.stop();
+        server_thread.join();
+
+        return metrics;
+
+    }
+
+    // CSV import of 200k tasks, the same input at each parser thread count, into a new database
+    MetricValues import_csv_rows(BenchContext& context) {
+
+        constexpr std::size_t rows = 200000;
+        std::string path = context.path("import.db");
+
+        // Descriptions are quoted, with an escaped quote in every tenth one
+        std::string csv = "id,title,description,completed\n";
+        std::vector<Task> tasks = BenchContext::make_tasks(rows);
+        for (std::size_t i = 0; i < rows; ++i) {
+            csv += std::to_string(i + 1) + ',' + tasks[i].title + ",\"" + tasks[i].description + (i % 10 == 0 ? " \"\"quoted\"\", with comma" : "") + "\"," + (tasks[i].completed ? "true" : "false") + '\n';
+        }
+
+        MetricValues metrics;
+
+        for (unsigned threads : { 1u, 2u, 4u, 8u }) {
+
+            fs::remove(path);
+            Database db(path);
+            db.set_profiling(false);
+            db.initialize();
+            TaskManager task_manager(db);
+
+            auto start = clock_type::now();
+            CsvImportStats stats = import_csv(csv, task_manager, threads);
+            double seconds = elapsed_ns(start) / 1e9;
+
+            if (stats.rows != rows) throw std::runtime_error("CSV import wrote " + std::to_string(stats.rows) + " rows");
+            metrics[std::to_string(threads) + "t_rows_per_s"] = rows / seconds;
+
+        }
+
+        return metrics;
+
+    }
+
+    // Resident set size of this process
+    std::size_t resident_bytes() {
+
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters{};
+        GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+        return counters.WorkingSetSize;
+#else
+        std::ifstream statm("/proc/self/statm");
+        std::size_t pages = 0;
+        std::size_t resident = 0;
+        statm >> pages >> resident;
+        return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+
+    }
+
+    // Hands freed heap pages back to the OS so the next RSS delta starts clean
+    void release_free_memory() {
+
+#ifdef __GLIBC__
+        malloc_trim(0);
+#endif
+
+    }
+
+    // Raises the open-file limit as far as allowed; returns how many loopback connections
+    // fit (each one costs a client and a server descriptor)
+    unsigned max_loopback_connections() {
+
+#ifdef _WIN32
+        return std::numeric_limits<unsigned>::max();
+#else
+        rlimit limit{};
+        getrlimit(RLIMIT_NOFILE, &limit);
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+        getrlimit(RLIMIT_NOFILE, &limit);
+        return limit.rlim_cur > 512 ? static_cast<unsigned>(std::min<rlim_t>((limit.rlim_cur - 256) / 2, std::numeric_limits<unsigned>::max())) : 0;
+#endif
+
+    }
+
+    // Holds --connections loopback connections (capped by the descriptor limit) against a
+    // fresh server, once with default and once with lean buffers. Reports accept rate,
+    // RSS per connection while every connection is idle after one request and while every
+    // connection trickles a partial header, and p99 of an active client meanwhile. RSS
+    // covers both ends' user space; kernel socket buffers are not included.
+    MetricValues conn_c100k(BenchContext& context) {
+
+        unsigned connections = std::min(context.options().connections, max_loopback_connections());
+        constexpr unsigned per_source_address = 20000;
+        constexpr int probe_requests = 500;
+
+        const std::string request = "GET /tasks?ids=1 HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        const std::string partial_request = "GET /tasks?ids=1 HTTP/1.1\r\nHo";
+
+        MetricValues metrics;
+
+        for (bool lean : { false, true }) {
+
+            std::string prefix = lean ? "lean_" : "";
+            std::string path = context.path("c100k.db");
+            fs::remove(path);
+
+            Database db(path);
+            db.initialize();
+            db.set_profiling(false);
+            db.add_tasks(BenchContext::make_tasks(100));
+            TaskManager task_manager(db);
+            AccessLog access_log(context.path("c100k.log"), 1 << 16);
+
+            asio::io_context server_io;
+            HttpServer server(server_io, 0, task_manager, access_log);
+            server.set_lean_buffers(lean);
+            std::thread server_thread([&] { server_io.run(); });
+
+            tcp::endpoint endpoint(asio::ip::address_v4::loopback(), server.port());
+            asio::io_context client_io;
+
+            // GET /metrics on a fresh connection; the server counts one deadline per waiting connection
+            auto armed_deadlines = [&] {
+                tcp::socket socket(client_io);
+                socket.connect(endpoint);
+                http::request<http::empty_body> req{ http::verb::get, "/metrics", 11 };
+                req.keep_alive(false);
+                http::write(socket, req);
+                beast::flat_buffer buffer;
+                http::response<http::string_body> res;
+                http::read(socket, buffer, res);
+                return json::parse(res.body()).at("connections").at("deadlines").to_number<std::uint64_t>();
+            };
+
+            // Sequential requests on one kept-alive connection while the others sit open
+            auto probe_p99_us = [&] {
+                tcp::socket socket(client_io);
+                socket.connect(endpoint);
+                beast::flat_buffer buffer;
+                std::vector<double> latencies;
+                for (int i = 0; i < probe_requests; ++i) {
+                    auto sent = clock_type::now();
+                    asio::write(socket, asio::buffer(request));
+                    http::response<http::string_body> res;
+                    http::read(socket, buffer, res);
+                    latencies.push_back(elapsed_ns(sent) / 1000.0);
+                }
+                std::sort(latencies.begin(), latencies.end());
+                return latencies[static_cast<std::size_t>(0.99 * (latencies.size() - 1))];
+            };
+
+            release_free_memory();
+            std::size_t rss_before = resident_bytes();
+
+            std::vector<tcp::socket> sockets;
+            sockets.reserve(connections);
+            auto start = clock_type::now();
+
+            for (unsigned i = 0; i < connections; ++i) {
+                tcp::socket& socket = sockets.emplace_back(client_io);
+                socket.open(tcp::v4());
+                // Ephemeral ports run out per source address, so spread over 127.0.0.x
+                if (i >= per_source_address) {
+                    socket.bind({ asio::ip::address_v4(0x7f000001u + i / per_source_address), 0 });
+                }
+                socket.connect(endpoint);
+            }
+
+            while (armed_deadlines() < connections) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            metrics[prefix + "accept_per_s"] = connections / (elapsed_ns(start) / 1e9);
+
+            // Idle: every connection has finished one request and waits for the next
+            for (auto& socket : sockets) asio::write(socket, asio::buffer(request));
+            for (auto& socket : sockets) {
+                beast::flat_buffer buffer;
+                http::response<http::string_body> res;
+                http::read(socket, buffer, res);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            metrics[prefix + "idle_rss_per_conn"] = static_cast<double>(resident_bytes() - rss_before) / connections;
+            metrics[prefix + "active_p99_us"] = probe_p99_us();
+
+            // Trickling: every connection is part way through its request header
+            for (auto& socket : sockets) asio::write(socket, asio::buffer(partial_request));
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            metrics[prefix + "trickle_rss_per_conn"] = static_cast<double>(resident_bytes() - rss_before) / connections;
+
+            sockets.clear();
+            server_io.stop();
+            server_thread.join();
+
+        }
+
+        std::cout << " (" << connections << " connections)" << std::flush;
+        return metrics;
+
+    }
+
+    const std::vector<Benchmark>& benchmarks() {
+
+        static const std::vector<Benchmark> all = {
+            { "load.get_tasks", load_get_tasks },
+            { "load.tls_get_tasks", tls_get_tasks },
+            { "tls.handshake", tls_handshake },
+            { "micro.access_log", micro_access_log_record },
+            { "micro.query_profiler", micro_query_profiler_record },
+            { "micro.bulk_insert", micro_bulk_insert },
+            { "micro.get_all_tasks", micro_get_all_tasks },
+            { "micro.task_cache", micro_task_cache },
+            { "micro.heavy_hitters", micro_heavy_hitters },
+            { "micro.coalescing", micro_write_coalescing },
+            { "micro.patch", micro_patch },
+            { "micro.durability", micro_durability },
+            { "micro.batch", micro_batch },
+            { "micro.timer_wheel", micro_timer_wheel },
+            { "micro.http_parse", micro_http_parse },
+            { "micro.body_validator", micro_body_validator },
+            { "micro.utf8", micro_utf8 },
+            { "scan.parallel", scan_parallel },
+            { "startup.warmup", startup_warmup },
+            { "export.arrow", export_arrow },
+            { "import.csv", import_csv_rows },
+            { "conn.c100k", conn_c100k },
+        };
+        return all;
+
+    }
+
+    // Two-sided 95% critical values of Student's t for 1..30 degrees of freedom
+    double t_critical(double df) {
+
+        static const double table[] = {
+            12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+            2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+            2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+        };
+
+        if (df < 1) return table[0];
+        if (df > 30) return 1.96;
+        return table[static_cast<int>(df) - 1];
+
+    }
+
+    MetricStats summarize(const std::vector<double>& samples, bool higher) {
+
+        MetricStats stats;
+        stats.runs = static_cast<unsigned>(samples.size());
+        stats.higher_is_better = higher;
+
+        for (double v : samples) stats.mean += v;
+        stats.mean /= samples.size();
+
+        if (samples.size() > 1) {
+            double sq = 0;
+            for (double v : samples) sq += (v - stats.mean) * (v - stats.mean);
+            stats.stddev = std::sqrt(sq / (samples.size() - 1));
+        }
+
+        return stats;
+
+    }
+
+    double confidence_half_width(const MetricStats& stats) {
+
+        if (stats.runs < 2) return 0;
+        return t_critical(stats.runs - 1) * stats.stddev / std::sqrt(static_cast<double>(stats.runs));
+
+    }
+
+    // Welch's t-test: true if the two means differ at the 95% level
+    bool significantly_different(const MetricStats& a, const MetricStats& b) {
+
+        if (a.runs < 2 || b.runs < 2) return a.mean != b.mean;
+
+        double va = a.stddev * a.stddev / a.runs;
+        double vb = b.stddev * b.stddev / b.runs;
+        if (va + vb == 0) return a.mean != b.mean;
+
+        double t = std::abs(a.mean - b.mean) / std::sqrt(va + vb);
+        double df = (va + vb) * (va + vb) / (va * va / (a.runs - 1) + vb * vb / (b.runs - 1));
+        return t > t_critical(df);
+
+    }
+
+    std::map<std::string, MetricStats> load_baseline(const std::string& path) {
+
+        std::map<std::string, MetricStats> baseline;
+        std::ifstream in(path);
+        if (!in) return baseline;
+
+        std::stringstream content;
+        content << in.rdbuf();
+
+        json::value root = json::parse(content.str());
+        for (const auto& [name, value] : root.at("metrics").as_object()) {
+            MetricStats stats;
+            stats.mean = value.at("mean").to_number<double>();
+            stats.stddev = value.at("stddev").to_number<double>();
+            stats.runs = static_cast<unsigned>(value.at("runs").to_number<double>());
+            stats.higher_is_better = value.at("higher_is_better").as_bool();
+            baseline[std::string(name)] = stats;
+        }
+
+        return baseline;
+
+    }
+
+    // One metric per line so baseline updates diff cleanly
+    void save_baseline(const std::string& path, const std::map<std::string, MetricStats>& results) {
+
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) throw std::runtime_error("Failed to write baseline: " + path);
+
+        out << "{\n  \"metrics\": {\n";
+        std::size_t i = 0;
+        for (const auto& [name, stats] : results) {
+            json::object metric{
+                { "mean", stats.mean },
+                { "stddev", stats.stddev },
+                { "runs", stats.runs },
+                { "higher_is_better", stats.higher_is_better }
+            };
+            out << "    " << json::serialize(json::value(name)) << ": " << json::serialize(metric) << (++i < results.size() ? ",\n" : "\n");
+        }
+        out << "  }\n}\n";
+
+    }
+
+    BenchOptions parse_options(const std::vector<std::string>& args) {
+
+        BenchOptions options;
+
+        for (std::size_t i = 1; i < args.size(); ++i) {
+            const std::string& arg = args[i];
+            bool has_value = i + 1 < args.size();
+
+            if (arg == "--runs" && has_value) options.runs = std::max(1u, static_cast<unsigned>(std::stoul(args[++i])));
+            else if (arg == "--baseline" && has_value) options.baseline_path = args[++i];
+            else if (arg == "--update") options.update = true;
+            else if (arg == "--threshold" && has_value) options.threshold = std::stod(args[++i]);
+            else if (arg == "--filter" && has_value) options.filter = args[++i];
+            else if (arg == "--requests" && has_value) options.requests = static_cast<unsigned>(std::stoul(args[++i]));
+            else if (arg == "--clients" && has_value) options.clients = static_cast<unsigned>(std::stoul(args[++i]));
+            else if (arg == "--connections" && has_value) options.connections = static_cast<unsigned>(std::stoul(args[++i]));
+            else throw std::invalid_argument("Unknown bench argument: " + arg);
+        }
+
+        return options;
+
+    }
+
+}
+
+
+/**
+ * Runs the benchmark suites and gates on regressions.
+ * Every benchmark is run --runs times; each metric is summarized as mean and
+ * 95% confidence interval and compared with the baseline using Welch's t-test.
+ * A metric regresses when it moved in the bad direction by more than the
+ * threshold and the difference is statistically significant.
+ * With --update the baseline file is rewritten from this run instead.
+ * @param args Command line arguments, args[0] being "bench"
+ * @return int 0 if no metric regressed, 1 otherwise
+ */
+int run_bench(const std::vector<std::string>& args) {
+
+    BenchOptions options = parse_options(args);
+    BenchContext context(options);
+
+    std::map<std::string, std::vector<double>> samples;
+
+    for (const auto& benchmark : benchmarks()) {
+
+        if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos) continue;
+
+        std::cout << "Running " << benchmark.name << std::flush;
+        for (unsigned run = 0; run < options.runs; ++run) {
+            for (const auto& [metric, value] : benchmark.run(context)) samples[benchmark.name + "." + metric].push_back(value);
+            std::cout << "." << std::flush;
+        }
+        std::cout << "\n";
+
+    }
+
+    std::map<std::string, MetricStats> results;
+    for (const auto& [metric, values] : samples) results[metric] = summarize(values, higher_is_better(metric));
+
+    if (options.update) {
+        std::map<std::string, MetricStats> merged = load_baseline(options.baseline_path);
+        for (const auto& [metric, stats] : results) merged[metric] = stats;
+        save_baseline(options.baseline_path, merged);
+        std::cout << "Baseline written to " << options.baseline_path << "\n";
+        return 0;
+    }
+
+    auto baseline = load_baseline(options.baseline_path);
+    int regressions = 0;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::left << std::setw(44) << "metric" << std::right << std::setw(24) << "baseline" << std::setw(24) << "current" << std::setw(10) << "change" << "  verdict\n";
+
+    for (const auto& [metric, current] : results) {
+
+        std::cout << std::left << std::setw(44) << metric << std::right;
+
+        auto it = baseline.find(metric);
+        if (it == baseline.end()) {
+            std::cout << std::setw(24) << "-" << std::setw(14) << current.mean << " +- " << std::setw(6) << confidence_half_width(current) << std::setw(10) << "-" << "  new\n";
+            continue;
+        }
+
+        const MetricStats& base = it->second;
+        double change = base.mean != 0 ? (current.mean - base.mean) / base.mean : 0;
+        double worse = current.higher_is_better ? -change : change;
+        bool significant = significantly_different(base, current);
+
+        const char* verdict = "same";
+        if (significant && worse > options.threshold) {
+            verdict = "REGRESSION";
+            regressions++;
+        }
+        else if (significant && worse < -options.threshold) {
+            verdict = "improved";
+        }
+
+        std::cout << std::setw(14) << base.mean << " +- " << std::setw(6) << confidence_half_width(base)
+            << std::setw(14) << current.mean << " +- " << std::setw(6) << confidence_half_width(current)
+            << std::setw(9) << change * 100 << "%  " << verdict << "\n";
+
+    }
+
+    if (regressions) std::cout << regressions << " metric(s) regressed by more than " << options.threshold * 100 << "%\n";
+    return regressions ? 1 : 0;
+
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Runs the load and microbenchmark suites and compares them with a stored baseline.
+// Usage: bench [--runs 5] [--baseline bench_baseline.json] [--update] [--threshold 0.05]
+//              [--filter substring] [--requests 2000] [--clients 8] [--connections 10000]
+int run_bench(const std::vector<std::string>& args);
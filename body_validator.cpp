@@ -0,0 +1,411 @@
+#include "body_validator.h"
+#include <cstring>
+
+namespace {
+
+    // Body limits: one task's fields, a whole POST /batch, or a CSV import. An import body
+    // is held in memory until it is parsed, so a connection may pin that much; bigger files
+    // go through the import command, which reads them from disk.
+    constexpr std::size_t max_task_body = 64 * 1024;
+    constexpr std::size_t max_batch_body = 1024 * 1024;
+    constexpr std::size_t max_import_body = 16 * 1024 * 1024;
+
+    // Number grammar (RFC 8259): states after the named part
+    enum : std::uint8_t { number_minus, number_zero, number_int, number_dot, number_frac, number_e, number_e_sign, number_exp };
+
+    bool is_space(char c) {
+
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+
+    }
+
+    bool is_digit(char c) {
+
+        return c >= '0' && c <= '9';
+
+    }
+
+    int hex_value(char c) {
+
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+
+    }
+
+}
+
+/**
+ * Picks the body limit and schema for a request.
+ * @param method Request method
+ * @param target Request target; the query string is ignored
+ * @return BodyRules Largest accepted body and what it must contain
+ */
+BodyRules body_rules(std::string_view method, std::string_view target) {
+
+    std::string_view path = target.substr(0, target.find('?'));
+
+    if (method == "POST" && path == "/tasks") return { max_task_body, BodySchema::new_task };
+    if (method == "POST" && path == "/batch") return { max_batch_body, BodySchema::json };
+    if (method == "POST" && path == "/tasks/import") return { max_import_body, BodySchema::none };
+    if (method == "PATCH" && path.starts_with("/tasks/")) return { max_task_body, BodySchema::task_patch };
+
+    return { max_task_body, BodySchema::none };
+
+}
+
+
+/**
+ * Describes a body over its limit.
+ * @param limit The limit it exceeded, in bytes
+ * @return std::string Error message for the client
+ */
+std::string body_limit_error(std::size_t limit) {
+
+    return "Request body too large (max " + std::to_string(limit) + " bytes)";
+
+}
+
+
+/**
+ * Creates a validator for one body.
+ * @param schema What the body must contain
+ */
+BodyValidator::BodyValidator(BodySchema schema) : schema_(schema) {}
+
+
+/**
+ * Feeds the next piece of the body.
+ * @param data Bytes following the ones already written
+ * @return bool False once the body is known to be invalid; error() says why
+ */
+bool BodyValidator::write(std::string_view data) {
+
+    if (schema_ == BodySchema::none) return true;
+
+    for (char c : data) {
+        if (!step(c)) return false;
+        offset_++;
+    }
+
+    return true;
+
+}
+
+
+/**
+ * Ends the body.
+ * @return bool False if the document is incomplete or was already found invalid
+ */
+bool BodyValidator::finish() {
+
+    if (schema_ == BodySchema::none) return true;
+    if (state_ == State::failed) return false;
+
+    // A number at the very end has nothing after it to terminate it
+    if (state_ == State::number && !end_number()) return false;
+
+    if (state_ != State::done) return fail(offset_ == 0 ? "Request body is empty" : "Request body is incomplete JSON");
+    return true;
+
+}
+
+
+/**
+ * Reason the body was rejected.
+ * @return const std::string& Error message, empty while the body is valid
+ */
+const std::string& BodyValidator::error() const {
+
+    return error_;
+
+}
+
+
+/**
+ * Advances the state machine by one byte.
+ * @param c Next byte of the body
+ * @return bool False if the byte makes the body invalid
+ */
+bool BodyValidator::step(char c) {
+
+    switch (state_) {
+
+    case State::value:
+    case State::value_or_close:
+        if (is_space(c)) return true;
+        if (c == ']' && state_ == State::value_or_close) {
+            depth_--;
+            return end_value();
+        }
+        return begin_value(c);
+
+    case State::key:
+    case State::key_or_close:
+        if (is_space(c)) return true;
+        if (c == '}' && state_ == State::key_or_close) return end_object();
+        if (c != '"') break;
+        in_key_ = true;
+        key_size_ = 0;
+        state_ = State::string;
+        return true;
+
+    case State::colon:
+        if (is_space(c)) return true;
+        if (c != ':') break;
+        state_ = State::value;
+        return true;
+
+    case State::after_value:
+        if (is_space(c)) return true;
+        if (depth_ > 0 && c == ',') {
+            state_ = stack_[depth_ - 1] == '{' ? State::key : State::value;
+            return true;
+        }
+        if (depth_ > 0 && c == '}' && stack_[depth_ - 1] == '{') return end_object();
+        if (depth_ > 0 && c == ']' && stack_[depth_ - 1] == '[') {
+            depth_--;
+            return end_value();
+        }
+        break;
+
+    case State::string:
+        if (c == '"') {
+            if (in_key_) {
+                in_key_ = false;
+                state_ = State::colon;
+                return true;
+            }
+            if (field_ && field_->required && length_ == 0) return fail("Task " + std::string(field_->name) + " cannot be empty");
+            return end_value();
+        }
+        if (c == '\\') {
+            state_ = State::escape;
+            return true;
+        }
+        if (static_cast<unsigned char>(c) < 0x20) break;
+        if (in_key_) {
+            if (key_size_ < max_key) key_[key_size_] = c;
+            key_size_++;
+            return true;
+        }
+        // UTF-8 continuation bytes belong to the character before them
+        return !field_ || (c & 0xC0) == 0x80 || add_char();
+
+    case State::escape:
+        if (c == 'u') {
+            code_point_ = 0;
+            hex_digits_ = 0;
+            state_ = State::unicode;
+            return true;
+        }
+        if (c == '\0' || !std::strchr("\"\\/bfnrt", c)) break;
+        state_ = State::string;
+        if (in_key_) key_size_ = max_key + 1;
+        return in_key_ || !field_ || add_char();
+
+    case State::unicode: {
+        int digit = hex_value(c);
+        if (digit < 0) break;
+        code_point_ = code_point_ << 4 | static_cast<std::uint32_t>(digit);
+        if (++hex_digits_ < 4) return true;
+        state_ = State::string;
+        if (in_key_) key_size_ = max_key + 1;
+        if (in_key_ || !field_) return true;
+
+        // A surrogate pair is one character, counted at its first half
+        return (code_point_ >= 0xDC00 && code_point_ <= 0xDFFF) || add_char();
+    }
+
+    case State::number:
+        if (is_digit(c)) {
+            if (number_ == number_zero) break;
+            if (number_ == number_minus) number_ = c == '0' ? number_zero : number_int;
+            else if (number_ == number_dot) number_ = number_frac;
+            else if (number_ == number_e || number_ == number_e_sign) number_ = number_exp;
+            return true;
+        }
+        if (c == '.' && (number_ == number_zero || number_ == number_int)) {
+            number_ = number_dot;
+            return true;
+        }
+        if ((c == 'e' || c == 'E') && (number_ == number_zero || number_ == number_int || number_ == number_frac)) {
+            number_ = number_e;
+            return true;
+        }
+        if ((c == '+' || c == '-') && number_ == number_e) {
+            number_ = number_e_sign;
+            return true;
+        }
+        return end_number() && step(c);
+
+    case State::literal:
+        if (c != *literal_) break;
+        if (*++literal_ == '\0') return end_value();
+        return true;
+
+    case State::done:
+        if (is_space(c)) return true;
+        break;
+
+    case State::failed:
+        return false;
+
+    }
+
+    return fail("Invalid JSON at byte " + std::to_string(offset_));
+
+}
+
+
+/**
+ * Starts a value; for top-level fields, checks that it has the expected type.
+ * @param c First byte of the value
+ * @return bool False if no value can start with c, or the field has the wrong type
+ */
+bool BodyValidator::begin_value(char c) {
+
+    field_ = nullptr;
+
+    if (depth_ == 0 && (schema_ == BodySchema::new_task || schema_ == BodySchema::task_patch) && c != '{') {
+        return fail("Request body must be a JSON object");
+    }
+
+    // Only top-level fields of the task schemas are checked
+    if (depth_ == 1 && stack_[0] == '{' && schema_ != BodySchema::json) {
+        std::string_view key = key_size_ <= max_key ? std::string_view(key_, key_size_) : std::string_view();
+
+        const ColumnRule* column = find_column(key);
+
+        if (column && column->writable) {
+            bool typed = column->kind == ColumnKind::text ? c == '"' : column->kind == ColumnKind::boolean ? c == 't' || c == 'f' : c == '-' || is_digit(c);
+            if (!typed) {
+                static constexpr const char* kinds[] = { "an integer", "a string", "a boolean" };
+                return fail("Field '" + std::string(key) + "' must be " + kinds[static_cast<int>(column->kind)]);
+            }
+
+            seen_ |= column->flag;
+            if (column->kind == ColumnKind::text) field_ = column;
+            length_ = 0;
+        }
+    }
+
+    switch (c) {
+
+    case '{':
+    case '[':
+        if (depth_ == max_depth) return fail("JSON nested too deeply");
+        stack_[depth_++] = c;
+        state_ = c == '{' ? State::key_or_close : State::value_or_close;
+        return true;
+
+    case '"':
+        state_ = State::string;
+        return true;
+
+    case 't':
+        literal_ = "rue";
+        state_ = State::literal;
+        return true;
+
+    case 'f':
+        literal_ = "alse";
+        state_ = State::literal;
+        return true;
+
+    case 'n':
+        literal_ = "ull";
+        state_ = State::literal;
+        return true;
+
+    case '-':
+        number_ = number_minus;
+        state_ = State::number;
+        return true;
+
+    default:
+        if (!is_digit(c)) return fail("Invalid JSON at byte " + std::to_string(offset_));
+        number_ = c == '0' ? number_zero : number_int;
+        state_ = State::number;
+        return true;
+
+    }
+
+}
+
+
+/**
+ * Moves past a complete value (scalar or closed container).
+ * @return bool Always true
+ */
+bool BodyValidator::end_value() {
+
+    field_ = nullptr;
+    state_ = depth_ == 0 ? State::done : State::after_value;
+    return true;
+
+}
+
+
+/**
+ * Ends a number at the byte after it (or at the end of the body).
+ * @return bool False if the number stopped half way ("-", "1.", "1e")
+ */
+bool BodyValidator::end_number() {
+
+    if (number_ == number_minus || number_ == number_dot || number_ == number_e || number_ == number_e_sign) {
+        return fail("Invalid JSON at byte " + std::to_string(offset_));
+    }
+
+    return end_value();
+
+}
+
+
+/**
+ * Records the first error and stops the validator.
+ * @param message Why the body is invalid
+ * @return bool Always false
+ */
+bool BodyValidator::fail(const std::string& message) {
+
+    state_ = State::failed;
+    error_ = message;
+    return false;
+
+}
+
+
+/**
+ * Closes an object; closing the top-level one of a new task checks its required fields.
+ * @return bool False if a required field is missing
+ */
+bool BodyValidator::end_object() {
+
+    depth_--;
+
+    if (depth_ == 0 && schema_ == BodySchema::new_task) {
+        for (const ColumnRule& column : column_rules) {
+            if (column.required && !(seen_ & column.flag)) return fail("Field '" + std::string(column.name) + "' is required");
+        }
+    }
+
+    return end_value();
+
+}
+
+
+/**
+ * Counts one more character of the text field being read.
+ * @return bool False once the text is over its column's limit
+ */
+bool BodyValidator::add_char() {
+
+    length_++;
+    if (field_->max_chars > 0 && length_ > field_->max_chars) {
+        return fail("Task " + std::string(field_->name) + " too long (max " + std::to_string(field_->max_chars) + " chars)");
+    }
+    return true;
+
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#pragma once
+#include "task_schema.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// What a request body has to look like
+enum class BodySchema {
+
+	none,		// not inspected
+	json,		// any well-formed JSON document
+	new_task,	// object of task fields, the required ones included
+	task_patch	// object of task fields, all optional
+
+};
+
+struct BodyRules {
+
+	std::size_t limit;
+	BodySchema schema;
+
+};
+
+// Size limit and schema for the body of a request, by method and target
+BodyRules body_rules(std::string_view method, std::string_view target);
+
+// Error message for a body over its limit
+std::string body_limit_error(std::size_t limit);
+
+
+// Checks a JSON request body piece by piece while it is still arriving. Syntax errors,
+// text over its column's length limit or a field of the wrong type are reported at the
+// byte that gives them away; a missing required field as soon as the top-level object
+// closes. Field names, types and limits come from the task schema.
+class BodyValidator {
+public:
+
+	// Constructor
+	explicit BodyValidator(BodySchema schema);
+
+	// Methods
+	bool write(std::string_view data);	// false once the body is known to be invalid
+	bool finish();						// false if the document is incomplete or invalid
+	const std::string& error() const;
+
+private:
+
+	enum class State : std::uint8_t { value, value_or_close, key, key_or_close, colon, after_value, string, escape, unicode, number, literal, done, failed };
+
+	static constexpr std::size_t max_depth = 64;
+	static constexpr std::size_t max_key = 16;
+
+	bool step(char c);
+	bool begin_value(char c);
+	bool end_value();
+	bool end_number();
+	bool fail(const std::string& message);
+	bool end_object();
+	bool add_char();
+
+	BodySchema schema_;
+	State state_ = State::value;
+	std::string error_;
+	std::size_t offset_ = 0;
+
+	// Containers open at the current position, innermost last ('{' or '[')
+	char stack_[max_depth];
+	std::size_t depth_ = 0;
+	bool in_key_ = false;
+
+	// Partial tokens
+	std::uint32_t code_point_ = 0;
+	int hex_digits_ = 0;
+	std::uint8_t number_ = 0;
+	const char* literal_ = nullptr;
+
+	// Top-level fields
+	char key_[max_key];
+	std::size_t key_size_ = 0;
+	const ColumnRule* field_ = nullptr;	// task column whose value is being read
+	std::size_t length_ = 0;			// characters of that value so far
+	unsigned seen_ = 0;					// TaskField mask of the fields given
+
+};
@@ -0,0 +1,405 @@
+#include "csv_import.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CSV_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define CSV_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+    // Smallest chunk worth a hand-off between threads
+    constexpr std::size_t min_chunk_bytes = 4096;
+
+    // Parsed chunks a parser may run ahead of the writer, per thread
+    constexpr std::size_t chunks_ahead = 2;
+
+    // One field of a record; last is set when it ends the record
+    struct Field {
+
+        std::string_view value;
+        bool last;
+
+    };
+
+    // A piece of the input that starts on a record boundary, and what became of it
+    struct Chunk {
+
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        std::vector<Task> tasks;
+        std::string error;			// first problem, empty if none
+        std::size_t error_row = 0;	// records of the chunk before the bad one
+        bool done = false;
+
+    };
+
+    // First ',', '"', '\r' or '\n' in [p, end), or end; 16 bytes are tested at a time
+    const char* find_special(const char* p, const char* end) {
+
+#if CSV_SSE2
+        const __m128i comma = _mm_set1_epi8(',');
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i lf = _mm_set1_epi8('\n');
+
+        for (; end - p >= 16; p += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, comma), _mm_cmpeq_epi8(block, quote)),
+                _mm_or_si128(_mm_cmpeq_epi8(block, cr), _mm_cmpeq_epi8(block, lf)));
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+            if (mask != 0) return p + std::countr_zero(mask);
+        }
+#elif CSV_NEON
+        for (; end - p >= 16; p += 16) {
+            uint8x16_t block = vld1q_u8(reinterpret_cast<const std::uint8_t*>(p));
+            uint8x16_t hits = vorrq_u8(vorrq_u8(vceqq_u8(block, vdupq_n_u8(',')), vceqq_u8(block, vdupq_n_u8('"'))),
+                vorrq_u8(vceqq_u8(block, vdupq_n_u8('\r')), vceqq_u8(block, vdupq_n_u8('\n'))));
+            // Narrowing shift leaves four mask bits per byte
+            std::uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)), 0);
+            if (mask != 0) return p + std::countr_zero(mask) / 4;
+        }
+#endif
+
+        for (; p < end; ++p) {
+            if (*p == ',' || *p == '"' || *p == '\r' || *p == '\n') return p;
+        }
+        return end;
+
+    }
+
+    // Number of '"' in [p, end)
+    std::size_t count_quotes(const char* p, const char* end) {
+
+        std::size_t count = 0;
+
+#if CSV_SSE2
+        const __m128i quote = _mm_set1_epi8('"');
+        for (; end - p >= 16; p += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            count += static_cast<std::size_t>(std::popcount(static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, quote)))));
+        }
+#elif CSV_NEON
+        for (; end - p >= 16; p += 16) {
+            uint8x16_t block = vld1q_u8(reinterpret_cast<const std::uint8_t*>(p));
+            count += vaddvq_u8(vandq_u8(vceqq_u8(block, vdupq_n_u8('"')), vdupq_n_u8(1)));
+        }
+#endif
+
+        return count + static_cast<std::size_t>(std::count(p, end, '"'));
+
+    }
+
+    // Start of the first record after p, given whether p is inside a quoted field
+    const char* next_record(const char* p, const char* end, bool quoted) {
+
+        for (; p < end; ++p) {
+            if (*p == '"') quoted = !quoted;
+            else if (*p == '\n' && !quoted) return p + 1;
+        }
+        return end;
+
+    }
+
+    // Reads the field at p and moves p past its delimiter. The value points into the input
+    // unless it has escaped quotes, in which case it is unescaped into scratch.
+    Field read_field(const char*& p, const char* end, std::string& scratch) {
+
+        std::string_view value;
+
+        if (p < end && *p == '"') {
+            const char* start = ++p;
+            bool escaped = false;
+            scratch.clear();
+
+            for (;;) {
+                const char* quote = static_cast<const char*>(std::memchr(p, '"', static_cast<std::size_t>(end - p)));
+                if (!quote) throw std::invalid_argument("Unterminated quoted field");
+
+                if (quote + 1 < end && quote[1] == '"') {
+                    scratch.append(p, quote + 1);
+                    p = quote + 2;
+                    escaped = true;
+                    continue;
+                }
+
+                if (escaped) {
+                    scratch.append(p, quote);
+                    value = scratch;
+                }
+                else {
+                    value = { start, static_cast<std::size_t>(quote - start) };
+                }
+                p = quote + 1;
+                break;
+            }
+
+            if (p == end) return { value, true };
+            if (*p == ',') { ++p; return { value, false }; }
+            if (*p == '\n') { ++p; return { value, true }; }
+            if (*p == '\r' && p + 1 < end && p[1] == '\n') { p += 2; return { value, true }; }
+            throw std::invalid_argument("Unexpected character after a quoted field");
+        }
+
+        const char* stop = find_special(p, end);
+        value = { p, static_cast<std::size_t>(stop - p) };
+
+        if (stop == end) { p = end; return { value, true }; }
+        if (*stop == ',') { p = stop + 1; return { value, false }; }
+        if (*stop == '\n') { p = stop + 1; return { value, true }; }
+        if (*stop == '\r' && stop + 1 < end && stop[1] == '\n') { p = stop + 2; return { value, true }; }
+        if (*stop == '"') throw std::invalid_argument("Quote inside an unquoted field");
+        throw std::invalid_argument("Carriage return inside an unquoted field");
+
+    }
+
+    bool parse_bool(std::string_view name, std::string_view value) {
+
+        if (value.empty() || value == "0" || value == "false" || value == "FALSE" || value == "False") return false;
+        if (value == "1" || value == "true" || value == "TRUE" || value == "True") return true;
+        throw std::invalid_argument("Task " + std::string(name) + " must be true, false, 1 or 0");
+
+    }
+
+    // Sets the task member of column (index in task_columns) from its CSV text
+    void store_field(Task& task, int column, std::string_view value) {
+
+        int index = 0;
+        for_each_column([&](const auto& descriptor) {
+            if (index++ != column) return;
+
+            if constexpr (std::decay_t<decltype(descriptor)>::kind == ColumnKind::text) {
+                (task.*descriptor.member).assign(value);
+            }
+            else if constexpr (std::decay_t<decltype(descriptor)>::kind == ColumnKind::boolean) {
+                task.*descriptor.member = parse_bool(descriptor.name, value);
+            }
+            else {
+                typename std::decay_t<decltype(descriptor)>::value_type number{};
+                auto [last, ec] = std::from_chars(value.data(), value.data() + value.size(), number);
+                if (ec != std::errc() || last != value.data() + value.size()) throw std::invalid_argument("Task " + std::string(descriptor.name) + " must be an integer");
+                task.*descriptor.member = number;
+            }
+        });
+
+    }
+
+    // Maps each header field to a writable column (index in task_columns), or -1 for the key
+    std::vector<int> read_header(const char*& p, const char* end) {
+
+        if (p == end) throw std::invalid_argument("CSV input is empty");
+
+        std::vector<int> layout;
+        std::string scratch;
+        unsigned seen = 0;
+
+        for (;;) {
+            Field field = read_field(p, end, scratch);
+            const ColumnRule* rule = find_column(field.value);
+
+            if (!rule) throw std::invalid_argument("Unknown CSV column '" + std::string(field.value) + "'");
+            if (seen & rule->flag) throw std::invalid_argument("Duplicate CSV column '" + std::string(field.value) + "'");
+
+            seen |= rule->flag;
+            layout.push_back(rule->writable ? static_cast<int>(rule - column_rules.data()) : -1);
+            if (field.last) break;
+        }
+
+        for (const ColumnRule& rule : column_rules) {
+            if (rule.required && !(seen & rule.flag)) throw std::invalid_argument("CSV column '" + std::string(rule.name) + "' is required");
+        }
+
+        return layout;
+
+    }
+
+    // Turns the records of a chunk into tasks, each checked like a create. Blank lines are
+    // skipped; the first error stops the chunk.
+    void parse_chunk(Chunk& chunk, const std::vector<int>& layout) {
+
+        const char* p = chunk.begin;
+        std::string scratch;
+
+        chunk.tasks.reserve(static_cast<std::size_t>(chunk.end - chunk.begin) / 64);
+
+        try {
+            while (p < chunk.end) {
+                if (*p == '\n') { ++p; continue; }
+                if (*p == '\r' && p + 1 < chunk.end && p[1] == '\n') { p += 2; continue; }
+
+                Task task{ 0, {}, {}, false };
+                std::size_t count = 0;
+
+                for (;;) {
+                    Field field = read_field(p, chunk.end, scratch);
+                    if (count < layout.size() && layout[count] >= 0) store_field(task, layout[count], field.value);
+                    count++;
+                    if (field.last) break;
+                }
+
+                if (count != layout.size()) throw std::invalid_argument("Expected " + std::to_string(layout.size()) + " fields, found " + std::to_string(count));
+
+                TaskManager::validate_task(task);
+                chunk.tasks.push_back(std::move(task));
+            }
+        }
+        catch (const std::exception& e) {
+            chunk.error = e.what();
+            chunk.error_row = chunk.tasks.size();
+        }
+
+    }
+
+    // Runs work(i) for every i below count on up to threads threads
+    template <typename Work>
+    void run_parallel(unsigned threads, std::size_t count, const Work& work) {
+
+        std::atomic<std::size_t> next{ 0 };
+        auto worker = [&] { for (std::size_t i; (i = next.fetch_add(1)) < count;) work(i); };
+
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < std::min<std::size_t>(threads, count); ++t) pool.emplace_back(worker);
+        worker();
+        for (auto& thread : pool) thread.join();
+
+    }
+
+}
+
+
+/**
+ * Imports tasks from CSV text.
+ * Chunk boundaries are found without a sequential pass over the records: the quotes of
+ * each nominal chunk are counted in parallel, their running parity says whether a cut
+ * falls inside a quoted field, and the cut moves forward to the next line end outside
+ * quotes. Parser threads then take chunks in order, at most a few ahead of the writer,
+ * which drains them one by one into a single transaction.
+ * @param csv Input, a header record followed by task records
+ * @param task_manager Validates and writes the tasks
+ * @param threads Parser threads; 0 uses one per core
+ * @param chunk_bytes Approximate size of the pieces handed to parser threads
+ * @return CsvImportStats Rows written and how the input was split
+ * @throws std::invalid_argument If the header or a row is malformed or fails validation; nothing is written
+ * @throws std::runtime_error If the database write fails; nothing is written
+ */
+CsvImportStats import_csv(std::string_view csv, TaskManager& task_manager, unsigned threads, std::size_t chunk_bytes) {
+
+    auto start = std::chrono::steady_clock::now();
+
+    CsvImportStats stats;
+    stats.bytes = csv.size();
+    stats.threads = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+    chunk_bytes = std::max(chunk_bytes, min_chunk_bytes);
+
+    const char* p = csv.data();
+    const char* end = p + csv.size();
+    if (csv.starts_with("\xEF\xBB\xBF")) p += 3;
+
+    std::vector<int> layout = read_header(p, end);
+
+    // Nominal cuts every chunk_bytes, then moved to record boundaries
+    std::size_t count = std::max<std::size_t>(1, (static_cast<std::size_t>(end - p) + chunk_bytes - 1) / chunk_bytes);
+    auto nominal = [&](std::size_t i) { return i == count ? end : p + i * chunk_bytes; };
+
+    std::vector<std::size_t> quotes(count);
+    run_parallel(stats.threads, count, [&](std::size_t i) { quotes[i] = count_quotes(nominal(i), nominal(i + 1)); });
+
+    std::vector<Chunk> chunks(count);
+    bool quoted = false;
+    chunks[0].begin = p;
+    for (std::size_t i = 1; i < count; ++i) {
+        quoted ^= (quotes[i - 1] & 1) != 0;
+        chunks[i].begin = std::max(chunks[i - 1].begin, next_record(nominal(i), end, quoted));
+        chunks[i - 1].end = chunks[i].begin;
+    }
+    chunks[count - 1].end = end;
+
+    std::mutex mutex;
+    std::condition_variable parsed;
+    std::condition_variable drained;
+    std::size_t written = 0;
+    bool stop = false;
+    std::atomic<std::size_t> next{ 0 };
+
+    auto parser = [&] {
+        for (std::size_t i; (i = next.fetch_add(1)) < count;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                drained.wait(lock, [&] { return stop || i < written + chunks_ahead * stats.threads; });
+                if (stop) return;
+            }
+
+            parse_chunk(chunks[i], layout);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                chunks[i].done = true;
+            }
+            parsed.notify_all();
+        }
+    };
+
+    std::vector<std::thread> parsers;
+    for (unsigned t = 0; t < std::min<std::size_t>(stats.threads, count); ++t) parsers.emplace_back(parser);
+
+    auto finish = [&] {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        drained.notify_all();
+        for (auto& thread : parsers) thread.join();
+    };
+
+    std::size_t index = 0;
+    std::size_t rows = 0;
+
+    try {
+        stats.rows = task_manager.import_tasks([&](std::vector<Task>& batch) {
+
+            if (index == count) return false;
+            Chunk& chunk = chunks[index];
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                parsed.wait(lock, [&] { return chunk.done; });
+            }
+
+            if (!chunk.error.empty()) throw std::invalid_argument("CSV row " + std::to_string(rows + chunk.error_row + 1) + ": " + chunk.error);
+
+            batch = std::move(chunk.tasks);
+            chunk.tasks = {};
+            rows += batch.size();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                written = ++index;
+            }
+            drained.notify_all();
+            return true;
+
+        });
+    }
+    catch (...) {
+        finish();
+        throw;
+    }
+
+    finish();
+
+    stats.chunks = count;
+    stats.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+
+}
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+#include "task_manager.h"
+#include <string_view>
+
+// Outcome of a CSV import
+struct CsvImportStats {
+
+	std::size_t rows = 0;		// tasks written
+	std::size_t bytes = 0;		// input size
+	std::size_t chunks = 0;		// pieces the input was parsed in
+	unsigned threads = 0;		// parser threads
+	double elapsed_ms = 0;
+
+};
+
+constexpr std::size_t default_csv_chunk_bytes = 1u << 20;
+
+// Imports tasks from CSV text (RFC 4180: comma separated, LF or CRLF line ends, fields
+// optionally quoted with "" as an escaped quote). The first record names the columns after
+// the task columns, in any order; an id column is read and dropped, as ids are assigned on
+// insert. completed takes true, false, 1, 0 or an empty field.
+// The input is cut into chunks of about chunk_bytes on record boundaries, parsed and checked
+// with the create rules on threads parser threads (0 for one per core), and handed in input
+// order to a single writer that adds them through TaskManager::import_tasks. The import is
+// all or nothing: the first bad row aborts it with its row number.
+CsvImportStats import_csv(std::string_view csv, TaskManager& task_manager, unsigned threads = 0, std::size_t chunk_bytes = default_csv_chunk_bytes);
\ No newline at end of file
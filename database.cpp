@@ -1,46 +1,290 @@
 #include "database.h"
 #include <iostream>
+#include <cstring>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <thread>
 
+namespace {
+
+    using SqlText = FixedText<256>;
+
+    // A parallel scan cuts the id span into this many ranges per thread, so threads that
+    // finish early take over ranges from slower ones
+    constexpr std::size_t ranges_per_thread = 4;
+
+    // Smaller id spans are read on the calling thread; handing ranges out costs more
+    constexpr sqlite3_int64 min_parallel_span = 8192;
+
+    // How long a connection waits for another connection's lock before failing
+    constexpr int busy_timeout_ms = 5000;
+
+    // Comma-separated column list for a TaskField mask, in declaration order
+    constexpr SqlText make_select_list(unsigned fields) {
+
+        SqlText columns;
+        for_each_column([&](const auto& column) {
+            if (!(fields & column.flag)) return;
+            if (columns.size) columns += ", ";
+            columns += column.name;
+        });
+        return columns;
+
+    }
+
+    // "UPDATE tasks SET a = ?, b = ? WHERE id = ?;" for the value columns in a TaskField mask
+    constexpr SqlText make_update(unsigned fields) {
+
+        SqlText sql;
+        sql += "UPDATE tasks SET ";
+        bool first = true;
+        for_each_value_column([&](const auto& column) {
+            if (!(fields & column.flag)) return;
+            if (!first) sql += ", ";
+            sql += column.name;
+            sql += " = ?";
+            first = false;
+        });
+        sql += " WHERE id = ?;";
+        return sql;
+
+    }
+
+    constexpr SqlText create_table_sql = [] {
+
+        SqlText sql;
+        sql += "CREATE TABLE IF NOT EXISTS tasks (";
+        for_each_column([&](const auto& column) {
+            if (column.flag != field_id) sql += ", ";
+            sql += column.name;
+            sql += " ";
+            sql += column.definition;
+        });
+        sql += ");";
+        return sql;
+
+    }();
+
+    constexpr SqlText insert_sql = [] {
+
+        SqlText columns;
+        SqlText values;
+        for_each_value_column([&](const auto& column) {
+            if (columns.size) { columns += ", "; values += ", "; }
+            columns += column.name;
+            values += "?";
+        });
+
+        SqlText sql;
+        sql += "INSERT INTO tasks (";
+        sql += columns.view();
+        sql += ") VALUES (";
+        sql += values.view();
+        sql += ");";
+        return sql;
+
+    }();
+
+    // Indexed by TaskField mask; entry 0 is unused
+    constexpr std::array<SqlText, field_all + 1> select_lists = [] {
+
+        std::array<SqlText, field_all + 1> lists{};
+        for (unsigned fields = 1; fields <= field_all; ++fields) lists[fields] = make_select_list(fields);
+        return lists;
+
+    }();
+
+    // Indexed by TaskField mask of value columns; masks with field_id or no column are unused
+    constexpr std::array<SqlText, field_all + 1> update_sql = [] {
+
+        std::array<SqlText, field_all + 1> statements{};
+        for (unsigned fields = field_id << 1; fields <= field_all; fields += field_id << 1) statements[fields] = make_update(fields);
+        return statements;
+
+    }();
+
+    constexpr SqlText select_by_id_sql = [] {
+
+        SqlText sql;
+        sql += "SELECT ";
+        sql += select_lists[field_all].view();
+        sql += " FROM tasks WHERE id = ?;";
+        return sql;
+
+    }();
+
+    void bind_value(sqlite3_stmt* stmt, int index, int value) {
+
+        sqlite3_bind_int(stmt, index, value);
+
+    }
+
+    void bind_value(sqlite3_stmt* stmt, int index, bool value) {
+
+        sqlite3_bind_int(stmt, index, value ? 1 : 0);
+
+    }
+
+    void bind_value(sqlite3_stmt* stmt, int index, const std::string& value) {
+
+        sqlite3_bind_text(stmt, index, value.data(), static_cast<int>(value.size()), SQLITE_STATIC);
+
+    }
+
+    void read_value(sqlite3_stmt* stmt, int column, int& value) {
+
+        value = sqlite3_column_int(stmt, column);
+
+    }
+
+    void read_value(sqlite3_stmt* stmt, int column, bool& value) {
+
+        value = sqlite3_column_int(stmt, column) != 0;
+
+    }
+
+    // NULL reads as an empty string
+    void read_value(sqlite3_stmt* stmt, int column, std::string& value) {
+
+        const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+        if (text) value.assign(text, sqlite3_column_bytes(stmt, column));
+        else value.clear();
+
+    }
+
+    // Binds the value columns of a task to parameters 1..n, as insert_sql and
+    // update_sql[all value columns] expect; returns the next parameter index
+    int bind_task(sqlite3_stmt* stmt, const Task& task) {
+
+        int index = 1;
+        for_each_value_column([&](const auto& column) { bind_value(stmt, index++, task.*column.member); });
+        return index;
+
+    }
+
+    // Binds the fields set in a patch, as update_sql[patch_fields(patch)] expects; returns
+    // the next parameter index
+    int bind_patch(sqlite3_stmt* stmt, const TaskPatch& patch) {
+
+        int index = 1;
+        for_each_value_column([&](const auto& column) {
+            if (const auto& value = patch.*column.patch_member) bind_value(stmt, index++, *value);
+        });
+        return index;
+
+    }
+
+    // Reads the current row of a statement built from select_lists[fields]; other members stay default
+    Task read_task(sqlite3_stmt* stmt, unsigned fields) {
+
+        Task task{ 0, {}, {}, false };
+        int index = 0;
+        for_each_column([&](const auto& column) {
+            if (fields & column.flag) read_value(stmt, index++, task.*column.member);
+        });
+        return task;
+
+    }
+
+}
 
 /**
  * Database class constructor.
  * Opens a connection to the SQLite database at the specified path.
+ * Installs a profile hook that records per-statement timings. Waits up to
+ * busy_timeout_ms for locks held by other connections, such as scan readers.
  * @param db_path Path to the database file
  * @throws std::runtime_error If failed to open the database
  */
-Database::Database(const std::string& db_path) {
+Database::Database(const std::string& db_path)
+	: path_(db_path)
+{
 
 	if (sqlite3_open(db_path.c_str(), &db_) != SQLITE_OK) throw std::runtime_error("Failed to open database: " + std::string(sqlite3_errmsg(db_)));
+	sqlite3_busy_timeout(db_, busy_timeout_ms);
+
+	set_profiling(true);
 
 }
 
 
 /**
  * Database class destructor.
- * Closes the database connection.
+ * Stops the scan helpers, finalizes cached statements and closes the read connections and
+ * the database connection.
  */
 Database::~Database() {
 
+	stop_scan_workers();
+	for (sqlite3_stmt* stmt : patch_statements_) sqlite3_finalize(stmt);
+	for (sqlite3* reader : idle_readers_) sqlite3_close(reader);
 	sqlite3_close(db_);
 
 }
 
 
+/**
+ * Leases a read connection: an idle one, a newly opened one, or db_ when no other
+ * connection can open the database.
+ * @param db Database to read
+ * @throws std::runtime_error If a new connection cannot be opened
+ */
+Database::Reader::Reader(Database& db) : db_(db), connection_(db.db_) {
+
+	if (!db.readers_shared()) return;
+
+	{
+		std::lock_guard<std::mutex> lock(db.readers_mutex_);
+		if (!db.idle_readers_.empty()) {
+			connection_ = db.idle_readers_.back();
+			db.idle_readers_.pop_back();
+			return;
+		}
+	}
+
+	connection_ = db.open_reader();
+
+}
+
+
+/**
+ * Hands the connection back for the next read.
+ */
+Database::Reader::~Reader() {
+
+	if (connection_ == db_.db_) return;
+
+	std::lock_guard<std::mutex> lock(db_.readers_mutex_);
+	db_.idle_readers_.push_back(connection_);
+
+}
+
+
+/**
+ * The leased connection.
+ * @return sqlite3* Connection, used by this lease's thread only
+ */
+sqlite3* Database::Reader::get() const {
+
+	return connection_;
+
+}
+
+
 
 /**
  * Initializes the database structure.
- * Creates the tasks table if it doesn't exist.
+ * Switches the file to write-ahead logging, so scan and warm-up readers on their own
+ * connections never block a commit on this one, and creates the tasks table if it
+ * doesn't exist. Bulk loads (configure_bulk_load) and in-memory databases keep their
+ * memory journal.
  * @throws std::runtime_error If SQL execution fails
  */
 void Database::initialize() {
 
-    const char* sql = "CREATE TABLE IF NOT EXISTS tasks ("
-        "id INTEGER PRIMARY KEY AUTOINCREMENT, "
-        "title TEXT NOT NULL, "
-        "description TEXT, "
-        "completed BOOLEAN DEFAULT 0);";
-
-    execute_sql(sql);
+    if (!exclusive_) execute_sql("PRAGMA journal_mode = WAL;");
+    execute_sql(create_table_sql.c_str());
 
 }
 
@@ -53,15 +297,8 @@ void Database::initialize() {
  */
 int Database::add_task(const Task& task) {
 
-    // sql query
-    const char* sql = "INSERT INTO tasks (title, description, completed) VALUES (?, ?, ?);";
-    sqlite3_stmt* stmt;
-
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) throw std::runtime_error(sqlite3_errmsg(db_));
-        
-    sqlite3_bind_text(stmt, 1, task.title.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, task.description.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 3, task.completed ? 1 : 0);
+    sqlite3_stmt* stmt = prepare(insert_sql.c_str());
+    bind_task(stmt, task);
 
     if (sqlite3_step(stmt) != SQLITE_DONE) {
         sqlite3_finalize(stmt);
@@ -74,6 +311,50 @@ int Database::add_task(const Task& task) {
 }
 
 
+/**
+ * Inserts many tasks with a single prepared statement.
+ * Runs inside its own transaction unless one is already open, in which case
+ * the rows become part of the caller's transaction.
+ * @param tasks Tasks to insert (ids are ignored)
+ * @throws std::runtime_error If SQL preparation or execution fails
+ */
+void Database::add_tasks(const std::vector<Task>& tasks) {
+
+    bool own_transaction = sqlite3_get_autocommit(db_) != 0;
+
+    if (own_transaction) begin_transaction();
+
+    sqlite3_stmt* stmt;
+    try {
+        stmt = prepare(insert_sql.c_str());
+    }
+    catch (...) {
+        if (own_transaction) rollback_transaction();
+        throw;
+    }
+
+    for (const auto& task : tasks) {
+
+        bind_task(stmt, task);
+
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            std::string error = sqlite3_errmsg(db_);
+            sqlite3_finalize(stmt);
+            if (own_transaction) rollback_transaction();
+            throw std::runtime_error("Failed to insert task: " + error);
+        }
+
+        sqlite3_reset(stmt);
+
+    }
+
+    sqlite3_finalize(stmt);
+
+    if (own_transaction) commit_transaction();
+
+}
+
+
 /**
  * Updates an existing task in the database.
  * @param task Task object with updated data
@@ -82,21 +363,16 @@ int Database::add_task(const Task& task) {
  */
 bool Database::update_task(const Task& task) {
 
-    const char* sql = "UPDATE tasks SET title = ?, description = ?, completed = ? WHERE id = ?;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) throw std::runtime_error(sqlite3_errmsg(db_));
+    sqlite3_stmt* stmt = prepare(update_sql[field_all & ~field_id].c_str());
 
-    sqlite3_bind_text(stmt, 1, task.title.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 2, task.description.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_int(stmt, 3, task.completed);
-    sqlite3_bind_int(stmt, 4, task.id);
+    int index = bind_task(stmt, task);
+    sqlite3_bind_int(stmt, index, task.id);
 
     bool success =  (sqlite3_step(stmt) == SQLITE_DONE);
 
     if (success && sqlite3_changes(db_) == 0) {
-        throw std::runtime_error(sqlite3_errmsg(db_));
-        success = false;
+        sqlite3_finalize(stmt);
+        throw std::runtime_error("Task not found with id: " + std::to_string(task.id));
     }
 
     sqlite3_finalize(stmt);
@@ -105,6 +381,50 @@ bool Database::update_task(const Task& task) {
 }
 
 
+/**
+ * Writes only the fields set in a patch.
+ * Each combination of fields has its own prepared statement, built on first use and
+ * kept for the lifetime of the connection.
+ * @param id ID of the task to change
+ * @param patch Fields to write
+ * @return bool True if the task exists (and was changed, if any field was set)
+ * @throws std::runtime_error If SQL preparation or execution fails
+ */
+bool Database::patch_task(int id, const TaskPatch& patch) {
+
+    unsigned columns = patch_fields(patch);
+
+    std::lock_guard<std::mutex> lock(patch_mutex_);
+
+    if (columns == 0) {
+        const char* sql = "SELECT 1 FROM tasks WHERE id = ?;";
+        sqlite3_stmt* stmt = prepare(sql);
+        sqlite3_bind_int(stmt, 1, id);
+        bool exists = sqlite3_step(stmt) == SQLITE_ROW;
+        sqlite3_finalize(stmt);
+        return exists;
+    }
+
+    sqlite3_stmt*& stmt = patch_statements_[columns];
+    if (!stmt) stmt = prepare(update_sql[columns].c_str());
+
+    int index = bind_patch(stmt, patch);
+    sqlite3_bind_int(stmt, index, id);
+
+    int rc = sqlite3_step(stmt);
+    std::string error = rc == SQLITE_DONE ? std::string() : sqlite3_errmsg(db_);
+    bool changed = rc == SQLITE_DONE && sqlite3_changes(db_) > 0;
+
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    if (rc != SQLITE_DONE) throw std::runtime_error("Failed to update task: " + error);
+
+    return changed;
+
+}
+
+
 /**
  * Deletes a task from the database by ID.
  * @param id ID of the task to delete
@@ -114,17 +434,15 @@ bool Database::update_task(const Task& task) {
 bool Database::delete_task(int id) {
 
     const char* sql = "DELETE FROM tasks WHERE id = ?;";
-    sqlite3_stmt* stmt;
-
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) throw std::runtime_error(sqlite3_errmsg(db_));
+    sqlite3_stmt* stmt = prepare(sql);
 
     sqlite3_bind_int(stmt, 1, id);
 
     bool success = (sqlite3_step(stmt) == SQLITE_DONE);
 
     if (success && sqlite3_changes(db_) == 0) {
-        throw std::runtime_error(sqlite3_errmsg(db_));
-        success = false;
+        sqlite3_finalize(stmt);
+        throw std::runtime_error("Task not found with id: " + std::to_string(id));
     }
 
     sqlite3_finalize(stmt);
@@ -133,6 +451,109 @@ bool Database::delete_task(int id) {
 }
 
 
+/**
+ * Runs creates, updates and deletes in order as one all-or-nothing unit.
+ * The batch is a savepoint, so it commits on its own or becomes part of the caller's
+ * open transaction. Inserts and deletes each reuse one prepared statement for the
+ * whole batch and updates use the cached patch statements. The first operation that
+ * fails or targets a missing task stops the batch: earlier operations are rolled
+ * back and later ones are skipped.
+ * @param ops Operations in execution order
+ * @return std::vector<TaskOpResult> One result per operation
+ * @throws std::runtime_error If the savepoint cannot be opened or released
+ */
+std::vector<TaskOpResult> Database::apply_batch(std::span<const TaskOp> ops) {
+
+    std::vector<TaskOpResult> results;
+    results.reserve(ops.size());
+
+    sqlite3_stmt* insert = nullptr;
+    sqlite3_stmt* remove = nullptr;
+    bool ok = true;
+
+    execute_sql("SAVEPOINT task_batch;");
+
+    for (const auto& op : ops) {
+
+        TaskOpResult result{ TaskOpResult::Status::ok, op.id, {} };
+
+        if (!ok) {
+            result.status = TaskOpResult::Status::skipped;
+            results.push_back(std::move(result));
+            continue;
+        }
+
+        try {
+            switch (op.kind) {
+
+            case TaskOp::Kind::create: {
+                if (!insert) insert = prepare(insert_sql.c_str());
+
+                Task task = task_from_patch(op.fields);
+                bind_task(insert, task);
+
+                int rc = sqlite3_step(insert);
+                sqlite3_reset(insert);
+                if (rc != SQLITE_DONE) throw std::runtime_error("Failed to insert task: " + std::string(sqlite3_errmsg(db_)));
+
+                result.id = static_cast<int>(sqlite3_last_insert_rowid(db_));
+                break;
+            }
+
+            case TaskOp::Kind::update:
+                if (!patch_task(op.id, op.fields)) result.status = TaskOpResult::Status::not_found;
+                break;
+
+            case TaskOp::Kind::remove: {
+                if (!remove) remove = prepare("DELETE FROM tasks WHERE id = ?;");
+
+                sqlite3_bind_int(remove, 1, op.id);
+
+                int rc = sqlite3_step(remove);
+                sqlite3_reset(remove);
+                if (rc != SQLITE_DONE) throw std::runtime_error("Failed to delete task: " + std::string(sqlite3_errmsg(db_)));
+                if (sqlite3_changes(db_) == 0) result.status = TaskOpResult::Status::not_found;
+                break;
+            }
+
+            }
+        }
+        catch (const std::exception& e) {
+            result.status = TaskOpResult::Status::failed;
+            result.error = e.what();
+        }
+
+        ok = result.status == TaskOpResult::Status::ok;
+        results.push_back(std::move(result));
+
+    }
+
+    sqlite3_finalize(insert);
+    sqlite3_finalize(remove);
+
+    if (ok) {
+        try {
+            execute_sql("RELEASE task_batch;");
+            return results;
+        }
+        catch (...) {
+            sqlite3_exec(db_, "ROLLBACK TO task_batch; RELEASE task_batch;", nullptr, nullptr, nullptr);
+            throw;
+        }
+    }
+
+    sqlite3_exec(db_, "ROLLBACK TO task_batch; RELEASE task_batch;", nullptr, nullptr, nullptr);
+
+    for (std::size_t i = 0; i < results.size() && results[i].status == TaskOpResult::Status::ok; ++i) {
+        results[i].status = TaskOpResult::Status::rolled_back;
+        if (ops[i].kind == TaskOp::Kind::create) results[i].id = 0;
+    }
+
+    return results;
+
+}
+
+
 /**
  * Retrieves a task from the database by ID.
  * @param id ID of the task to retrieve
@@ -141,26 +562,18 @@ bool Database::delete_task(int id) {
  */
 Task Database::get_task_by_id(int id) {
 
-    const char* sql = "SELECT id, title, description, completed FROM tasks WHERE id = ?;";
-    sqlite3_stmt* stmt;
-    Task task;
-    task.id = -1;
-
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) throw std::runtime_error(sqlite3_errmsg(db_));
+    Reader reader(*this);
+    sqlite3_stmt* stmt = prepare(reader.get(), select_by_id_sql.c_str());
 
     sqlite3_bind_int(stmt, 1, id);
 
     if (sqlite3_step(stmt) != SQLITE_ROW) {
-        task.id = sqlite3_column_int(stmt, 0);
-        task.title = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        task.description = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        task.completed = sqlite3_column_int(stmt, 3) != 0;
-    }
-    else {
         sqlite3_finalize(stmt);
         throw std::runtime_error("Task not found with id: " + std::to_string(id));
     }
 
+    Task task = read_task(stmt, field_all);
+
     sqlite3_finalize(stmt);
     return task;
 
@@ -168,28 +581,77 @@ Task Database::get_task_by_id(int id) {
 
 
 
+/**
+ * Retrieves the tasks with the given ids using one IN (...) statement per chunk.
+ * Placeholder counts are rounded up to a power of two and the spare slots bound
+ * to NULL, so only a handful of distinct statement texts are ever prepared.
+ * @param ids Ids to fetch; duplicates and unknown ids are allowed
+ * @param fields TaskField mask of columns to read; id is always read
+ * @return std::vector<Task> Tasks that exist, in no particular order
+ * @throws std::runtime_error If SQL preparation or execution fails
+ */
+std::vector<Task> Database::get_tasks_by_ids(std::span<const int> ids, unsigned fields) {
+
+    constexpr std::size_t max_chunk = 256;
+    fields |= field_id;
+
+    std::vector<Task> tasks;
+    tasks.reserve(ids.size());
+
+    Reader reader(*this);
+
+    for (std::size_t offset = 0; offset < ids.size(); offset += max_chunk) {
+
+        auto chunk = ids.subspan(offset, std::min(max_chunk, ids.size() - offset));
+
+        std::size_t slots = 1;
+        while (slots < chunk.size()) slots <<= 1;
+
+        std::string sql = "SELECT " + std::string(select_lists[fields & field_all].view()) + " FROM tasks WHERE id IN (?";
+        for (std::size_t i = 1; i < slots; ++i) sql += ",?";
+        sql += ");";
+
+        sqlite3_stmt* stmt = prepare(reader.get(), sql.c_str());
+
+        for (std::size_t i = 0; i < chunk.size(); ++i) sqlite3_bind_int(stmt, static_cast<int>(i + 1), chunk[i]);
+        for (std::size_t i = chunk.size(); i < slots; ++i) sqlite3_bind_null(stmt, static_cast<int>(i + 1));
+
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) tasks.push_back(read_task(stmt, fields));
+
+        if (rc != SQLITE_DONE) {
+            std::string error = sqlite3_errmsg(reader.get());
+            sqlite3_finalize(stmt);
+            throw std::runtime_error("Failed to fetch tasks: " + error);
+        }
+
+        sqlite3_finalize(stmt);
+
+    }
+
+    return tasks;
+
+}
+
+
+
 /**
  * Retrieves all tasks from the database.
+ * Only the requested columns are selected, so unneeded text is never copied out of SQLite.
+ * @param fields TaskField mask of columns to read; the rest stay default-initialized
  * @return std::vector<Task> Vector containing all task objects
  * @throws std::runtime_error If SQL preparation fails
  */
-std::vector<Task> Database::get_all_tasks() {
+std::vector<Task> Database::get_all_tasks(unsigned fields) {
 
-    std::vector<Task> tasks;
-    const char* sql = "SELECT id, title, description, completed FROM tasks;";
-    sqlite3_stmt* stmt;
+    if ((fields & field_all) == 0) fields = field_all;
 
-    if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK) throw std::runtime_error(sqlite3_errmsg(db_));
+    std::vector<Task> tasks;
+    std::string sql = "SELECT " + std::string(select_lists[fields & field_all].view()) + " FROM tasks;";
+    Reader reader(*this);
+    sqlite3_stmt* stmt = prepare(reader.get(), sql.c_str());
 
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        Task task;
-        task.id = sqlite3_column_int(stmt, 0);
-        task.title = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        task.description = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        task.completed = sqlite3_column_int(stmt, 3);
-        
-        tasks.push_back(task);
-    }
+    while (sqlite3_step(stmt) == SQLITE_ROW) tasks.push_back(read_task(stmt, fields));
 
     sqlite3_finalize(stmt);
     return tasks;
@@ -197,6 +659,252 @@ std::vector<Task> Database::get_all_tasks() {
 }
 
 
+/**
+ * Reads every task in rowid ranges on several read-only connections at once.
+ * The span [MIN(id), MAX(id)] is cut into scan_ranges() equal ranges. The calling thread,
+ * on a leased read connection, and the scan helpers (see set_scan_threads), each on the
+ * connection it keeps, claim ranges in turn and hand the tasks of each non-empty one, in
+ * id order, to visit. Callers that need the output in order store per-range results by
+ * range number and stitch them afterwards. Helpers busy with another scan join late or
+ * not at all; the caller never waits for a helper that has not started.
+ * Reads everything as range 0 on the calling thread instead when there are no helpers,
+ * the span is small, or no other connection can open the database (in-memory, or locked
+ * by configure_bulk_load). Every connection reads its own snapshot, so a write committed
+ * during the scan may show up in some ranges and not in others.
+ * @param fields TaskField mask of columns to read
+ * @param visit Called once per non-empty range, from the thread that read it
+ * @throws std::runtime_error If a connection cannot be opened or a query fails;
+ *         exceptions thrown by visit are passed on as well
+ */
+void Database::scan_tasks(unsigned fields, const ScanVisitor& visit) {
+
+    if ((fields & field_all) == 0) fields = field_all;
+
+    sqlite3_int64 first = 0;
+    sqlite3_int64 last = -1;
+
+    {
+        Reader reader(*this);
+        sqlite3_stmt* bounds = prepare(reader.get(), "SELECT MIN(id), MAX(id) FROM tasks;");
+        if (sqlite3_step(bounds) == SQLITE_ROW && sqlite3_column_type(bounds, 0) != SQLITE_NULL) {
+            first = sqlite3_column_int64(bounds, 0);
+            last = sqlite3_column_int64(bounds, 1);
+        }
+        sqlite3_finalize(bounds);
+    }
+
+    unsigned threads = scan_threads_;
+    if (threads <= 1 || !readers_shared() || last - first + 1 < min_parallel_span) {
+        std::vector<Task> tasks = get_all_tasks(fields);
+        if (!tasks.empty()) visit(0, tasks);
+        return;
+    }
+
+    std::size_t ranges = scan_ranges();
+    sqlite3_int64 width = (last - first) / static_cast<sqlite3_int64>(ranges) + 1;
+    std::string sql = "SELECT " + std::string(select_lists[fields & field_all].view()) + " FROM tasks WHERE id BETWEEN ? AND ? ORDER BY id;";
+
+    std::atomic<std::size_t> next{ 0 };
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    auto scan = [&](sqlite3*& connection) {
+        try {
+            if (!connection) connection = open_reader(false);
+
+            sqlite3_stmt* raw_stmt = nullptr;
+            if (sqlite3_prepare_v2(connection, sql.c_str(), -1, &raw_stmt, nullptr) != SQLITE_OK) {
+                throw std::runtime_error("Failed to prepare scan: " + std::string(sqlite3_errmsg(connection)));
+            }
+            std::unique_ptr<sqlite3_stmt, int (*)(sqlite3_stmt*)> stmt(raw_stmt, sqlite3_finalize);
+
+            for (std::size_t range = next++; range < ranges; range = next++) {
+                sqlite3_int64 low = first + static_cast<sqlite3_int64>(range) * width;
+                if (low > last) break;
+
+                sqlite3_bind_int64(stmt.get(), 1, low);
+                sqlite3_bind_int64(stmt.get(), 2, std::min(low + width - 1, last));
+
+                int rc;
+                std::vector<Task> tasks;
+                while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) tasks.push_back(read_task(stmt.get(), fields));
+                sqlite3_reset(stmt.get());
+                if (rc != SQLITE_DONE) throw std::runtime_error("Failed to scan tasks: " + std::string(sqlite3_errmsg(connection)));
+
+                if (!tasks.empty()) visit(range, tasks);
+            }
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) error = std::current_exception();
+            next = ranges;
+        }
+    };
+
+    // A helper may take its job after the scan is over; it then leaves without touching
+    // scan, which only lives until every helper that did start has finished
+    struct Helpers {
+        std::mutex mutex;
+        std::condition_variable idle;
+        unsigned active = 0;
+        bool done = false;
+    };
+    auto helpers = std::make_shared<Helpers>();
+
+    {
+        std::lock_guard<std::mutex> lock(scan_mutex_);
+        for (unsigned i = 1; i < threads; ++i) {
+            scan_jobs_.emplace_back([helpers, &scan](sqlite3*& connection) {
+                {
+                    std::lock_guard<std::mutex> lock(helpers->mutex);
+                    if (helpers->done) return;
+                    ++helpers->active;
+                }
+                scan(connection);
+                std::lock_guard<std::mutex> lock(helpers->mutex);
+                if (--helpers->active == 0) helpers->idle.notify_all();
+            });
+        }
+    }
+    scan_ready_.notify_all();
+
+    {
+        Reader reader(*this);
+        sqlite3* connection = reader.get();
+        scan(connection);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(helpers->mutex);
+        helpers->done = true;
+        helpers->idle.wait(lock, [&] { return helpers->active == 0; });
+    }
+
+    if (error) std::rethrow_exception(error);
+
+}
+
+
+/**
+ * Number of ranges scan_tasks may report with the current thread count.
+ * @return std::size_t Upper bound (exclusive) of the range numbers handed to the visitor
+ */
+std::size_t Database::scan_ranges() const {
+
+    return scan_threads_ <= 1 ? 1 : scan_threads_ * ranges_per_thread;
+
+}
+
+
+/**
+ * Sets how many threads full-table scans use: the caller plus threads - 1 helpers, started
+ * here and kept until the next call or destruction. Each helper opens its read connection
+ * on start (or on its first job, if the database cannot be read yet) and keeps it, so a
+ * scan costs neither threads nor connections. Not to be called while a scan runs.
+ * @param threads Thread count, the caller included; 0 and 1 scan on the caller only
+ */
+void Database::set_scan_threads(unsigned threads) {
+
+    stop_scan_workers();
+
+    scan_threads_ = std::max(1u, threads);
+    for (unsigned i = 1; i < scan_threads_; ++i) scan_workers_.emplace_back([this] { run_scan_worker(); });
+
+}
+
+
+/**
+ * Body of a scan helper: runs queued jobs on its own read connection until stopped.
+ */
+void Database::run_scan_worker() {
+
+    sqlite3* connection = nullptr;
+    if (readers_shared()) {
+        try {
+            connection = open_reader(false);
+        }
+        catch (const std::exception&) {
+            // Opened by the first job instead, which reports the error to its scan
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(scan_mutex_);
+    while (true) {
+        scan_ready_.wait(lock, [this] { return scan_stopping_ || !scan_jobs_.empty(); });
+        if (scan_jobs_.empty()) break;
+
+        auto job = std::move(scan_jobs_.front());
+        scan_jobs_.pop_front();
+        lock.unlock();
+        job(connection);
+        lock.lock();
+    }
+
+    sqlite3_close(connection);
+
+}
+
+
+/**
+ * Stops the scan helpers once the queued jobs are taken, and waits for them.
+ */
+void Database::stop_scan_workers() {
+
+    {
+        std::lock_guard<std::mutex> lock(scan_mutex_);
+        scan_stopping_ = true;
+    }
+    scan_ready_.notify_all();
+
+    for (auto& worker : scan_workers_) worker.join();
+    scan_workers_.clear();
+    scan_stopping_ = false;
+
+}
+
+
+/**
+ * Streams every task, in id order, to a sink one column value at a time.
+ * Values go from the cursor to the sink directly (text as a view into SQLite's buffer,
+ * valid only during the call), so no Task or std::string is built per row.
+ * @param fields TaskField mask of columns to read; none means all
+ * @param sink Receives the values of each row in column order, then end_row
+ * @throws std::runtime_error If SQL preparation or execution fails; exceptions thrown by
+ *         the sink are passed on
+ */
+void Database::read_columns(unsigned fields, ColumnSink& sink) {
+
+    if ((fields & field_all) == 0) fields = field_all;
+
+    std::string sql = "SELECT " + std::string(select_lists[fields & field_all].view()) + " FROM tasks ORDER BY id;";
+    Reader reader(*this);
+    std::unique_ptr<sqlite3_stmt, int (*)(sqlite3_stmt*)> stmt(prepare(reader.get(), sql.c_str()), sqlite3_finalize);
+
+    int rc;
+    while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+        int index = 0;
+        std::size_t column = 0;
+        for_each_column([&](const auto& descriptor) {
+            constexpr ColumnKind kind = std::decay_t<decltype(descriptor)>::kind;
+            if (fields & descriptor.flag) {
+                if constexpr (kind == ColumnKind::text) {
+                    const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), index));
+                    sink.text(column, text ? std::string_view(text, sqlite3_column_bytes(stmt.get(), index)) : std::string_view());
+                }
+                else if constexpr (kind == ColumnKind::boolean) sink.boolean(column, sqlite3_column_int(stmt.get(), index) != 0);
+                else sink.integer(column, sqlite3_column_int64(stmt.get(), index));
+                index++;
+            }
+            column++;
+        });
+        sink.end_row();
+    }
+
+    if (rc != SQLITE_DONE) throw std::runtime_error("Failed to read tasks: " + std::string(sqlite3_errmsg(reader.get())));
+
+}
+
+
 /**
  * Executes a raw SQL query.
  * Primarily used for database initialization and schema changes.
@@ -214,3 +922,203 @@ void Database::execute_sql(const char* sql) {
     }
 
 }
+
+
+/**
+ * Returns the profile of every statement executed on the writer's and the read connections.
+ * @return std::vector<StatementProfile> Statement profiles, slowest total time first
+ */
+std::vector<StatementProfile> Database::get_statement_profiles() const {
+
+    return profiler_.snapshot();
+
+}
+
+
+/**
+ * Enables or disables the statement profile hook.
+ * Bulk loaders turn it off to save a clock read and a map update per row.
+ * @param enabled True to record statement profiles
+ */
+void Database::set_profiling(bool enabled) {
+
+    auto apply = [&](sqlite3* connection) {
+        if (enabled) sqlite3_trace_v2(connection, SQLITE_TRACE_PROFILE, &Database::trace_callback, this);
+        else sqlite3_trace_v2(connection, 0, nullptr, nullptr);
+    };
+
+    std::lock_guard<std::mutex> lock(readers_mutex_);
+    profiling_ = enabled;
+    apply(db_);
+    for (sqlite3* reader : idle_readers_) apply(reader);
+
+}
+
+
+/**
+ * Whether other connections can open the database: not for in-memory databases, nor
+ * while configure_bulk_load holds the file lock.
+ * @return bool True if reads can use connections of their own
+ */
+bool Database::readers_shared() const {
+
+    return !exclusive_ && !path_.empty() && path_ != ":memory:" && path_.rfind("file::memory:", 0) != 0;
+
+}
+
+
+/**
+ * Opens a read-only connection with the same busy timeout and profiling as db_.
+ * @return sqlite3* New connection, owned by the caller
+ * @throws std::runtime_error If the connection cannot be opened
+ */
+sqlite3* Database::open_reader(bool profiled) {
+
+    sqlite3* raw = nullptr;
+    int rc = sqlite3_open_v2(path_.c_str(), &raw, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr);
+    if (rc != SQLITE_OK) {
+        std::string error = raw ? sqlite3_errmsg(raw) : "out of memory";
+        sqlite3_close(raw);
+        throw std::runtime_error("Failed to open read connection: " + error);
+    }
+
+    sqlite3_busy_timeout(raw, busy_timeout_ms);
+
+    std::lock_guard<std::mutex> lock(readers_mutex_);
+    if (profiled && profiling_) sqlite3_trace_v2(raw, SQLITE_TRACE_PROFILE, &Database::trace_callback, this);
+    return raw;
+
+}
+
+
+/**
+ * Prepares a statement on the writer's connection.
+ * @param sql SQL query string
+ * @return sqlite3_stmt* Prepared statement, owned by the caller
+ * @throws std::runtime_error If SQL preparation fails
+ */
+sqlite3_stmt* Database::prepare(const char* sql) {
+
+    return prepare(db_, sql);
+
+}
+
+
+/**
+ * Prepares a statement.
+ * On first use of a statement text its EXPLAIN QUERY PLAN is captured for the profiler.
+ * @param connection Connection to prepare it on: db_ or a leased reader
+ * @param sql SQL query string
+ * @return sqlite3_stmt* Prepared statement, owned by the caller
+ * @throws std::runtime_error If SQL preparation fails
+ */
+sqlite3_stmt* Database::prepare(sqlite3* connection, const char* sql) {
+
+    sqlite3_stmt* stmt;
+
+    if (sqlite3_prepare_v2(connection, sql, -1, &stmt, nullptr) != SQLITE_OK) throw std::runtime_error(sqlite3_errmsg(connection));
+
+    if (!profiler_.has_plan(sql)) {
+
+        std::vector<std::string> plan;
+        std::string explain = std::string("EXPLAIN QUERY PLAN ") + sql;
+        sqlite3_stmt* explain_stmt;
+
+        if (sqlite3_prepare_v2(connection, explain.c_str(), -1, &explain_stmt, nullptr) == SQLITE_OK) {
+            while (sqlite3_step(explain_stmt) == SQLITE_ROW) {
+                plan.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(explain_stmt, 3)));
+            }
+            sqlite3_finalize(explain_stmt);
+        }
+
+        profiler_.set_plan(sql, std::move(plan));
+
+    }
+
+    return stmt;
+
+}
+
+
+/**
+ * SQLite trace hook.
+ * Receives SQLITE_TRACE_PROFILE events and forwards them to the profiler.
+ * Statement counters are read with reset so each event covers one execution.
+ * @param type Trace event type
+ * @param context Database instance
+ * @param p Finished statement
+ * @param x Pointer to the elapsed time in nanoseconds
+ * @return int Always 0
+ */
+int Database::trace_callback(unsigned type, void* context, void* p, void* x) {
+
+    if (type != SQLITE_TRACE_PROFILE) return 0;
+
+    auto* self = static_cast<Database*>(context);
+    auto* stmt = static_cast<sqlite3_stmt*>(p);
+    const char* sql = sqlite3_sql(stmt);
+
+    if (!sql || std::strncmp(sql, "EXPLAIN", 7) == 0) return 0;
+
+    self->profiler_.record(
+        sql,
+        static_cast<std::uint64_t>(*static_cast<sqlite3_int64*>(x)),
+        static_cast<std::uint64_t>(sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1)),
+        static_cast<std::uint64_t>(sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1))
+    );
+
+    return 0;
+
+}
+
+
+/**
+ * Starts a transaction.
+ * @throws std::runtime_error If a transaction is already open
+ */
+void Database::begin_transaction() {
+
+    execute_sql("BEGIN;");
+
+}
+
+
+/**
+ * Commits the open transaction.
+ * @throws std::runtime_error If no transaction is open or the commit fails
+ */
+void Database::commit_transaction() {
+
+    execute_sql("COMMIT;");
+
+}
+
+
+/**
+ * Rolls back the open transaction.
+ * Errors are ignored so this is safe to call while unwinding.
+ */
+void Database::rollback_transaction() {
+
+    sqlite3_exec(db_, "ROLLBACK;", nullptr, nullptr, nullptr);
+
+}
+
+
+/**
+ * Relaxes durability for bulk loading on this connection.
+ * Turns off fsync, keeps the rollback journal in memory and holds the file lock
+ * for the lifetime of the connection. A crash during loading can corrupt the
+ * database, so only use this for seeding and imports.
+ * @throws std::runtime_error If SQL execution fails
+ */
+void Database::configure_bulk_load() {
+
+    execute_sql("PRAGMA synchronous = OFF;");
+    execute_sql("PRAGMA journal_mode = MEMORY;");
+    execute_sql("PRAGMA cache_size = -262144;");
+    execute_sql("PRAGMA temp_store = MEMORY;");
+    execute_sql("PRAGMA locking_mode = EXCLUSIVE;");
+    exclusive_ = true;
+
+}
@@ -1,19 +1,59 @@
 #pragma once
 #include <sqlite3.h>
+#include "query_profiler.h"
+#include "task_schema.h"
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
 #include <vector>
+#include <span>
+#include <thread>
 #include <string>
 #include <stdexcept>
 
-// Database task structure
-struct Task {
+// One step of a mixed batch; create takes title, description and completed from fields
+// (unset ones default), update writes the fields that are set
+struct TaskOp {
 
+	enum class Kind { create, update, remove };
+
+	Kind kind;
+	int id;
+	TaskPatch fields;
+
+};
+
+// Outcome of one TaskOp; id is the new task's id for a committed create
+struct TaskOpResult {
+
+	enum class Status { ok, not_found, failed, rolled_back, skipped };
+
+	Status status;
 	int id;
-	std::string title;
-	std::string description;
-	bool completed;
+	std::string error;
 
 };
 
+// Receives the tasks of one rowid range of a parallel scan, on the thread that read them;
+// range numbers follow id order
+using ScanVisitor = std::function<void(std::size_t range, std::vector<Task>& tasks)>;
+
+// Receives query results value by value, straight from the statement and without building
+// Tasks; column is the index in task_columns, and end_row follows the last value of a row
+class ColumnSink {
+public:
+
+	virtual ~ColumnSink() = default;
+
+	virtual void integer(std::size_t column, std::int64_t value) = 0;
+	virtual void text(std::size_t column, std::string_view value) = 0;
+	virtual void boolean(std::size_t column, bool value) = 0;
+	virtual void end_row() = 0;
+
+};
 
 class Database {
 public:
@@ -27,14 +67,79 @@ public:
 	// Methods
 	void initialize();
 	int add_task(const Task& task);
+	void add_tasks(const std::vector<Task>& tasks);
 	bool update_task(const Task& task);
+	bool patch_task(int id, const TaskPatch& patch);
 	bool delete_task(int id);
+	std::vector<TaskOpResult> apply_batch(std::span<const TaskOp> ops);
 	Task get_task_by_id(int id);
-	std::vector<Task> get_all_tasks();
+	std::vector<Task> get_tasks_by_ids(std::span<const int> ids, unsigned fields = field_all);
+	std::vector<Task> get_all_tasks(unsigned fields = field_all);
+	void scan_tasks(unsigned fields, const ScanVisitor& visit);
+	std::size_t scan_ranges() const;
+	void set_scan_threads(unsigned threads);
+	void read_columns(unsigned fields, ColumnSink& sink);
+	std::vector<StatementProfile> get_statement_profiles() const;
+	void set_profiling(bool enabled);
+
+	// Transactions and bulk loading
+	void begin_transaction();
+	void commit_transaction();
+	void rollback_transaction();
+	void configure_bulk_load();
 
 private:
+
+	// A read-only connection leased for one read and handed back after it. Reads on db_
+	// would see the writer's open transaction, including rows a rollback later discards.
+	// Where no other connection can open the database, the lease is db_ itself.
+	class Reader {
+	public:
+
+		explicit Reader(Database& db);
+		~Reader();
+		Reader(const Reader&) = delete;
+		Reader& operator=(const Reader&) = delete;
+
+		sqlite3* get() const;
+
+	private:
+
+		Database& db_;
+		sqlite3* connection_;
+
+	};
 	
-	sqlite3* db_;
+	sqlite3* db_;	// the writer's connection
+	std::string path_;
+	bool exclusive_ = false;	// file lock held by configure_bulk_load; no other connection can read
+	QueryProfiler profiler_;
+
+	// Idle read connections; one is opened whenever every existing one is leased
+	std::mutex readers_mutex_;
+	std::vector<sqlite3*> idle_readers_;
+	bool profiling_ = false;
+
+	// Helper threads of parallel scans (see set_scan_threads); each keeps its own read
+	// connection for its lifetime and runs the jobs scan_tasks queues
+	std::mutex scan_mutex_;
+	std::condition_variable scan_ready_;
+	std::deque<std::function<void(sqlite3*&)>> scan_jobs_;
+	std::vector<std::thread> scan_workers_;
+	bool scan_stopping_ = false;
+	unsigned scan_threads_ = 1;
+
+	// One cached UPDATE per TaskField mask of patched columns
+	std::mutex patch_mutex_;
+	std::array<sqlite3_stmt*, 1u << task_column_count> patch_statements_{};
+
+	bool readers_shared() const;
+	sqlite3* open_reader(bool profiled = true);
+	void run_scan_worker();
+	void stop_scan_workers();
 	void execute_sql(const char* sql);
+	sqlite3_stmt* prepare(const char* sql);
+	sqlite3_stmt* prepare(sqlite3* connection, const char* sql);
+	static int trace_callback(unsigned type, void* context, void* p, void* x);
 
 };
\ No newline at end of file
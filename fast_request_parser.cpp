@@ -0,0 +1,194 @@
+#include "fast_request_parser.h"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FAST_PARSER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+    // RFC 9110 tchar, for header names
+    constexpr std::array<bool, 256> make_token_table() {
+
+        std::array<bool, 256> table{};
+        for (int c = '0'; c <= '9'; ++c) table[c] = true;
+        for (int c = 'a'; c <= 'z'; ++c) table[c] = true;
+        for (int c = 'A'; c <= 'Z'; ++c) table[c] = true;
+        for (char c : std::string_view("!#$%&'*+-.^_`|~")) table[static_cast<unsigned char>(c)] = true;
+        return table;
+
+    }
+
+    constexpr std::array<bool, 256> token_table = make_token_table();
+
+    // Is c a delimiter for a target (anything but visible ASCII) or, with text set, for a
+    // header value (control characters other than tab; bytes >= 0x80 are obs-text)
+    bool is_delimiter(unsigned char c, bool text) {
+
+        if (text) return (c < 0x20 && c != '\t') || c == 0x7f;
+        return c <= 0x20 || c >= 0x7f;
+
+    }
+
+    // First delimiter in [p, end), or end
+    const char* find_delimiter(const char* p, const char* end, bool text) {
+
+#ifdef FAST_PARSER_SSE2
+        const __m128i space = _mm_set1_epi8(text ? 0x1f : 0x20);
+        const __m128i del = _mm_set1_epi8(0x7f);
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i high = _mm_set1_epi8(static_cast<char>(0x80));
+
+        for (; end - p >= 16; p += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+
+            // Unsigned v <= limit, via min; then DEL, and for targets every byte >= 0x80
+            __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(_mm_min_epu8(v, space), v), _mm_cmpeq_epi8(v, del));
+            if (text) hit = _mm_andnot_si128(_mm_cmpeq_epi8(v, tab), hit);
+            else hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_and_si128(v, high), high));
+
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hit));
+            if (mask != 0) return p + std::countr_zero(mask);
+        }
+#endif
+
+        for (; p < end; ++p) {
+            if (is_delimiter(static_cast<unsigned char>(*p), text)) return p;
+        }
+        return end;
+
+    }
+
+    bool iequals(std::string_view a, std::string_view b) {
+
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+            return (x | 0x20) == (y | 0x20);
+        });
+
+    }
+
+    // Does a comma-separated Connection value list the token
+    bool has_token(std::string_view list, std::string_view token) {
+
+        while (!list.empty()) {
+            std::size_t comma = list.find(',');
+            std::string_view item = list.substr(0, comma);
+            while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+            while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+            if (iequals(item, token)) return true;
+            if (comma == std::string_view::npos) break;
+            list.remove_prefix(comma + 1);
+        }
+        return false;
+
+    }
+
+}
+
+
+/**
+ * Parses the head of an HTTP/1.1 request in place.
+ * On complete, every view in head points into input, head.size is the length of the
+ * head and head.content_length the body length that follows. Nothing is copied.
+ * @param input Bytes received so far
+ * @param head Receives the parsed head
+ * @param limit Largest head handled here; longer ones fall back
+ * @return HeadParse complete, incomplete or fallback
+ */
+HeadParse parse_request_head(std::string_view input, RequestHead& head, std::size_t limit) {
+
+    const char* const begin = input.data();
+    const char* const end = begin + std::min(input.size(), limit);
+    const HeadParse short_input = input.size() >= limit ? HeadParse::fallback : HeadParse::incomplete;
+    const char* p = begin;
+
+    head.header_count = 0;
+    head.content_length = 0;
+
+    // Method: uppercase letters up to a single space
+    const char* q = find_delimiter(p, end, false);
+    if (q == end) return short_input;
+    if (*q != ' ' || q == p || !std::all_of(p, q, [](char c) { return c >= 'A' && c <= 'Z'; })) return HeadParse::fallback;
+    head.method = { p, static_cast<std::size_t>(q - p) };
+    p = q + 1;
+
+    // Target: origin-form only
+    q = find_delimiter(p, end, false);
+    if (q == end) return short_input;
+    if (*q != ' ' || q == p || *p != '/') return HeadParse::fallback;
+    head.target = { p, static_cast<std::size_t>(q - p) };
+    p = q + 1;
+
+    // Version
+    std::string_view rest(p, static_cast<std::size_t>(end - p));
+    if (rest.size() < 10) {
+        bool prefix = std::string_view("HTTP/1.1\r\n").starts_with(rest) || std::string_view("HTTP/1.0\r\n").starts_with(rest);
+        return prefix ? short_input : HeadParse::fallback;
+    }
+    if (std::string_view(p, 7) != "HTTP/1." || (p[7] != '0' && p[7] != '1') || p[8] != '\r' || p[9] != '\n') return HeadParse::fallback;
+    head.minor_version = p[7] - '0';
+    head.keep_alive = head.minor_version == 1;
+    p += 10;
+
+    bool has_length = false;
+
+    for (;;) {
+
+        if (end - p < 2) return short_input;
+        if (p[0] == '\r') {
+            if (p[1] != '\n') return HeadParse::fallback;
+            p += 2;
+            break;
+        }
+
+        if (head.header_count == RequestHead::max_headers) return HeadParse::fallback;
+
+        // Name: tchars up to the colon (names are short, so a table beats SIMD here)
+        q = p;
+        while (q < end && token_table[static_cast<unsigned char>(*q)]) ++q;
+        if (q == end) return short_input;
+        if (*q != ':' || q == p) return HeadParse::fallback;
+        std::string_view name(p, q - p);
+        p = q + 1;
+
+        while (p < end && (*p == ' ' || *p == '\t')) ++p;
+
+        // Value: up to CRLF, without trailing whitespace
+        q = find_delimiter(p, end, true);
+        if (q == end || (*q == '\r' && q + 1 == end)) return short_input;
+        if (*q != '\r' || q[1] != '\n') return HeadParse::fallback;
+        const char* value_end = q;
+        while (value_end > p && (value_end[-1] == ' ' || value_end[-1] == '\t')) --value_end;
+        std::string_view value(p, value_end - p);
+        p = q + 2;
+
+        head.headers[head.header_count++] = { name, value };
+
+        if (iequals(name, "content-length")) {
+            if (has_length || value.empty() || value.size() > 15) return HeadParse::fallback;
+            std::size_t length = 0;
+            for (char c : value) {
+                if (c < '0' || c > '9') return HeadParse::fallback;
+                length = length * 10 + static_cast<std::size_t>(c - '0');
+            }
+            head.content_length = length;
+            has_length = true;
+        }
+        else if (iequals(name, "connection")) {
+            if (has_token(value, "close")) head.keep_alive = false;
+            else if (has_token(value, "keep-alive")) head.keep_alive = true;
+            if (has_token(value, "upgrade")) return HeadParse::fallback;
+        }
+        else if (iequals(name, "transfer-encoding") || iequals(name, "upgrade") || iequals(name, "expect")) {
+            return HeadParse::fallback;
+        }
+
+    }
+
+    head.size = static_cast<std::size_t>(p - begin);
+    return HeadParse::complete;
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+// One request header; both views point into the parsed input
+struct HeaderView {
+
+	std::string_view name;
+	std::string_view value;
+
+};
+
+// Request line and headers of an HTTP/1.1 request, without copying anything
+struct RequestHead {
+
+	static constexpr std::size_t max_headers = 32;
+
+	std::string_view method;
+	std::string_view target;
+	int minor_version = 1;
+	std::array<HeaderView, max_headers> headers;
+	std::size_t header_count = 0;
+	std::size_t content_length = 0;
+	bool keep_alive = true;
+	std::size_t size = 0;	// bytes up to and including the blank line
+
+};
+
+enum class HeadParse {
+
+	complete,	// head parsed; the body (content_length bytes) follows at size
+	incomplete,	// a valid prefix; read more and parse again
+	fallback	// valid or not, not the common case: let the full parser decide
+
+};
+
+// Fast path for the requests this server mostly sees: uppercase method, origin-form
+// target, HTTP/1.0 or 1.1, at most max_headers plain headers and an optional
+// Content-Length body. Delimiters are found 16 bytes at a time with SSE2 where
+// available. Anything else (chunked bodies, Upgrade, Expect, folded or malformed
+// lines, heads over limit bytes) returns fallback without judging it.
+HeadParse parse_request_head(std::string_view input, RequestHead& head, std::size_t limit = 8192);
+
+
+
+// Copies a parsed head and its body into a Beast-style request (anything with
+// method_string, target, version, insert and body)
+template <class Request>
+void fill_request(const RequestHead& head, std::string_view body, Request& req) {
+
+	req.method_string({ head.method.data(), head.method.size() });
+	req.target({ head.target.data(), head.target.size() });
+	req.version(10 + head.minor_version);
+	for (std::size_t i = 0; i < head.header_count; ++i) {
+		req.insert({ head.headers[i].name.data(), head.headers[i].name.size() }, { head.headers[i].value.data(), head.headers[i].value.size() });
+	}
+	req.body().assign(body.data(), body.size());
+
+}
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include "heavy_hitters.h"
+#include <algorithm>
+#include <bit>
+#include <unordered_map>
+
+namespace {
+
+    std::atomic<std::uint64_t> next_instance_id{ 1 };
+
+    // Per-thread shard cache; a few slots so one thread can feed several sketches
+    // (task ids and routes) without a lock. Keyed by instance id so a reused
+    // address never matches a dead sketch. A miss only costs a lookup: the sketch
+    // itself remembers each thread's shard.
+    struct ShardCache {
+        std::uint64_t owner = 0;
+        void* shard = nullptr;
+    };
+
+    thread_local ShardCache shard_cache[4];
+    thread_local unsigned shard_cache_next = 0;
+
+    std::uint64_t mix(std::uint64_t x) {
+
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdull;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ull;
+        x ^= x >> 33;
+        return x;
+
+    }
+
+    // Owner-only increment: a plain load and store, readers tolerate a stale value
+    std::uint32_t bump(std::atomic<std::uint32_t>& counter) {
+
+        std::uint32_t value = counter.load(std::memory_order_relaxed) + 1;
+        counter.store(value, std::memory_order_relaxed);
+        return value;
+
+    }
+
+}
+
+
+/**
+ * HeavyHitters::Shard constructor.
+ * @param k Candidate table size
+ * @param width Counters per sketch row
+ */
+HeavyHitters::Shard::Shard(std::size_t k, std::size_t width)
+    : counters(std::make_unique<std::atomic<std::uint32_t>[]>(depth * width)),
+      candidates(std::make_unique<std::atomic<std::uint64_t>[]>(k)) {
+
+    keys.reserve(k);
+    counts.reserve(k);
+
+}
+
+
+/**
+ * HeavyHitters class constructor.
+ * @param k Number of hottest keys to track
+ * @param width Counters per sketch row, rounded up to a power of two (at most 65536)
+ */
+HeavyHitters::HeavyHitters(std::size_t k, std::size_t width)
+    : k_(std::max<std::size_t>(k, 1)),
+      mask_(std::bit_ceil(std::clamp<std::size_t>(width, 64, 65536)) - 1),
+      instance_id_(next_instance_id.fetch_add(1)) {
+}
+
+
+/**
+ * Counts one occurrence of a key.
+ * The common path is one hash, four counter bumps and a compare; the candidate table
+ * is only touched when the key's estimate reaches the current k-th largest.
+ * @param key Key to count (task id, route index, ...)
+ */
+void HeavyHitters::record(std::uint64_t key) {
+
+    Shard& shard = local_shard();
+    std::uint64_t hash = mix(key);
+
+    std::uint32_t count = UINT32_MAX;
+    for (int row = 0; row < depth; ++row) count = std::min(count, bump(shard.counters[slot(hash, row)]));
+
+    shard.total.store(shard.total.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    // Once the table is full, keys above the floor are offered on every 8th count only;
+    // a new heavy hitter still gets in within 8 occurrences and current candidates
+    // mostly skip the table scan
+    if (shard.keys.size() < k_ || (count > shard.floor && (count & 7) == 0)) offer(shard, key, count);
+    if (++shard.since_aging == aging_window) age(shard);
+
+}
+
+
+/**
+ * Merges all shards into the current top-k.
+ * Candidates of every shard are re-estimated against the summed sketch.
+ * @return std::vector<HeavyHitter> Up to k keys, most frequent first
+ */
+std::vector<HeavyHitter> HeavyHitters::top() const {
+
+    std::lock_guard<std::mutex> lock(shards_mutex_);
+
+    std::vector<std::uint64_t> keys;
+    for (const auto& shard : shards_) {
+        for (std::size_t i = 0; i < k_; ++i) {
+            std::uint64_t key = shard->candidates[i].load(std::memory_order_relaxed);
+            if (key != 0) keys.push_back(key - 1);
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    std::vector<HeavyHitter> result;
+    for (std::uint64_t key : keys) {
+        std::uint64_t count = UINT64_MAX;
+        for (int row = 0; row < depth; ++row) {
+            std::uint64_t sum = 0;
+            for (const auto& shard : shards_) sum += shard->counters[slot(mix(key), row)].load(std::memory_order_relaxed);
+            count = std::min(count, sum);
+        }
+        if (count > 0) result.push_back({ key, count });
+    }
+
+    std::sort(result.begin(), result.end(), [](const HeavyHitter& a, const HeavyHitter& b) { return a.count > b.count; });
+    if (result.size() > k_) result.resize(k_);
+    return result;
+
+}
+
+
+/**
+ * Returns the number of records since start, after aging.
+ * @return std::uint64_t Record count
+ */
+std::uint64_t HeavyHitters::total() const {
+
+    std::lock_guard<std::mutex> lock(shards_mutex_);
+
+    std::uint64_t total = 0;
+    for (const auto& shard : shards_) total += shard->total.load(std::memory_order_relaxed);
+    return total;
+
+}
+
+
+/**
+ * Returns the calling thread's shard, creating it on the thread's first record.
+ * A thread evicted from the cache by other sketches gets its own shard back, so
+ * there is never more than one shard per thread.
+ * @return Shard& Shard owned by the calling thread
+ */
+HeavyHitters::Shard& HeavyHitters::local_shard() {
+
+    for (const auto& cached : shard_cache) {
+        if (cached.owner == instance_id_) return *static_cast<Shard*>(cached.shard);
+    }
+
+    std::lock_guard<std::mutex> lock(shards_mutex_);
+
+    Shard*& shard = thread_shards_[std::this_thread::get_id()];
+    if (!shard) {
+        shards_.push_back(std::make_unique<Shard>(k_, mask_ + 1));
+        shard = shards_.back().get();
+    }
+
+    ShardCache& cached = shard_cache[shard_cache_next++ % 4];
+    cached.owner = instance_id_;
+    cached.shard = shard;
+    return *shard;
+
+}
+
+
+/**
+ * Computes the counter index of a key in one sketch row.
+ * Each row takes a different 16-bit slice of the key's hash.
+ * @param hash Mixed key
+ * @param row Sketch row
+ * @return std::size_t Index into the counter table
+ */
+std::size_t HeavyHitters::slot(std::uint64_t hash, int row) const {
+
+    return row * (mask_ + 1) + ((hash >> (row * 16)) & mask_);
+
+}
+
+
+/**
+ * Offers a key whose estimate passed the floor to the shard's candidate table.
+ * A candidate just has its estimate refreshed; any other key replaces the weakest
+ * candidate. The table is mirrored into atomics for readers, storing keys plus one
+ * so that 0 marks an empty slot.
+ * @param shard Owning shard
+ * @param key Key
+ * @param count Estimated count of key
+ */
+void HeavyHitters::offer(Shard& shard, std::uint64_t key, std::uint32_t count) {
+
+    auto it = std::find(shard.keys.begin(), shard.keys.end(), key);
+    std::size_t index = it - shard.keys.begin();
+
+    if (it == shard.keys.end()) {
+        if (shard.keys.size() < k_) {
+            shard.keys.push_back(key);
+            shard.counts.push_back(count);
+        }
+        else {
+            index = shard.weakest;
+            shard.keys[index] = key;
+            shard.counts[index] = count;
+        }
+        shard.candidates[index].store(key + 1, std::memory_order_relaxed);
+    }
+    else {
+        shard.counts[index] = count;
+    }
+
+    // The floor only matters once the table is full
+    if (shard.keys.size() < k_) return;
+
+    shard.weakest = std::min_element(shard.counts.begin(), shard.counts.end()) - shard.counts.begin();
+    shard.floor = shard.counts[shard.weakest];
+
+}
+
+
+/**
+ * Halves every counter of a shard so old traffic fades out.
+ * @param shard Owning shard
+ */
+void HeavyHitters::age(Shard& shard) {
+
+    for (std::size_t i = 0; i < depth * (mask_ + 1); ++i) shard.counters[i].store(shard.counters[i].load(std::memory_order_relaxed) >> 1, std::memory_order_relaxed);
+
+    shard.total.store(shard.total.load(std::memory_order_relaxed) >> 1, std::memory_order_relaxed);
+    for (auto& count : shard.counts) count >>= 1;
+    shard.floor >>= 1;
+    shard.since_aging = 0;
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// One frequent key and its estimated count
+struct HeavyHitter {
+
+	std::uint64_t key;
+	std::uint64_t count;
+
+};
+
+
+// Streaming top-k: a count-min sketch estimates every key's frequency and a small
+// candidate table remembers the keys whose estimate beat the current k-th largest.
+// Each recording thread owns a shard it updates without locks or read-modify-write
+// atomics; readers merge the shards. Counts decay by half every aging_window records
+// per shard, so the ranking follows recent traffic.
+class HeavyHitters {
+public:
+
+	// Constructor
+	explicit HeavyHitters(std::size_t k = 16, std::size_t width = 1024);
+
+	HeavyHitters(const HeavyHitters&) = delete;
+	HeavyHitters& operator=(const HeavyHitters&) = delete;
+
+	// Methods
+	void record(std::uint64_t key);
+	std::vector<HeavyHitter> top() const;
+	std::uint64_t total() const;
+
+	static constexpr std::uint32_t aging_window = 1u << 20;
+
+private:
+
+	static constexpr int depth = 4;
+
+	struct Shard {
+
+		Shard(std::size_t k, std::size_t width);
+
+		std::unique_ptr<std::atomic<std::uint32_t>[]> counters;
+		std::unique_ptr<std::atomic<std::uint64_t>[]> candidates;
+		std::atomic<std::uint64_t> total{ 0 };
+
+		// Owner-thread state: candidate keys and their last seen estimates
+		std::vector<std::uint64_t> keys;
+		std::vector<std::uint32_t> counts;
+		std::size_t weakest = 0;
+		std::uint32_t floor = 0;
+		std::uint32_t since_aging = 0;
+
+	};
+
+	Shard& local_shard();
+	std::size_t slot(std::uint64_t hash, int row) const;
+	void offer(Shard& shard, std::uint64_t key, std::uint32_t count);
+	void age(Shard& shard);
+
+	std::size_t k_;
+	std::size_t mask_;
+	std::uint64_t instance_id_;
+
+	mutable std::mutex shards_mutex_;
+	std::vector<std::unique_ptr<Shard>> shards_;
+	std::unordered_map<std::thread::id, Shard*> thread_shards_;	// one shard per recording thread
+
+};
@@ -0,0 +1,495 @@
+#include "hpack.h"
+#include <array>
+#include <memory>
+
+namespace {
+
+    // Static table (RFC 7541 Appendix A), index 1..61
+    const HeaderField static_table[] = {
+        { ":authority", "" },
+        { ":method", "GET" },
+        { ":method", "POST" },
+        { ":path", "/" },
+        { ":path", "/index.html" },
+        { ":scheme", "http" },
+        { ":scheme", "https" },
+        { ":status", "200" },
+        { ":status", "204" },
+        { ":status", "206" },
+        { ":status", "304" },
+        { ":status", "400" },
+        { ":status", "404" },
+        { ":status", "500" },
+        { "accept-charset", "" },
+        { "accept-encoding", "gzip, deflate" },
+        { "accept-language", "" },
+        { "accept-ranges", "" },
+        { "accept", "" },
+        { "access-control-allow-origin", "" },
+        { "age", "" },
+        { "allow", "" },
+        { "authorization", "" },
+        { "cache-control", "" },
+        { "content-disposition", "" },
+        { "content-encoding", "" },
+        { "content-language", "" },
+        { "content-length", "" },
+        { "content-location", "" },
+        { "content-range", "" },
+        { "content-type", "" },
+        { "cookie", "" },
+        { "date", "" },
+        { "etag", "" },
+        { "expect", "" },
+        { "expires", "" },
+        { "from", "" },
+        { "host", "" },
+        { "if-match", "" },
+        { "if-modified-since", "" },
+        { "if-none-match", "" },
+        { "if-range", "" },
+        { "if-unmodified-since", "" },
+        { "last-modified", "" },
+        { "link", "" },
+        { "location", "" },
+        { "max-forwards", "" },
+        { "proxy-authenticate", "" },
+        { "proxy-authorization", "" },
+        { "range", "" },
+        { "referer", "" },
+        { "refresh", "" },
+        { "retry-after", "" },
+        { "server", "" },
+        { "set-cookie", "" },
+        { "strict-transport-security", "" },
+        { "transfer-encoding", "" },
+        { "user-agent", "" },
+        { "vary", "" },
+        { "via", "" },
+        { "www-authenticate", "" }
+    };
+
+    constexpr std::size_t static_table_size = std::size(static_table);
+
+    // Huffman code and bit length per symbol (RFC 7541 Appendix B), symbol 256 is EOS
+    struct HuffmanCode {
+        std::uint32_t code;
+        std::uint8_t bits;
+    };
+
+    const HuffmanCode huffman_codes[257] = {
+        { 0x1ff8, 13 }, { 0x7fffd8, 23 }, { 0xfffffe2, 28 }, { 0xfffffe3, 28 }, { 0xfffffe4, 28 }, { 0xfffffe5, 28 },
+        { 0xfffffe6, 28 }, { 0xfffffe7, 28 }, { 0xfffffe8, 28 }, { 0xffffea, 24 }, { 0x3ffffffc, 30 }, { 0xfffffe9, 28 },
+        { 0xfffffea, 28 }, { 0x3ffffffd, 30 }, { 0xfffffeb, 28 }, { 0xfffffec, 28 }, { 0xfffffed, 28 }, { 0xfffffee, 28 },
+        { 0xfffffef, 28 }, { 0xffffff0, 28 }, { 0xffffff1, 28 }, { 0xffffff2, 28 }, { 0x3ffffffe, 30 }, { 0xffffff3, 28 },
+        { 0xffffff4, 28 }, { 0xffffff5, 28 }, { 0xffffff6, 28 }, { 0xffffff7, 28 }, { 0xffffff8, 28 }, { 0xffffff9, 28 },
+        { 0xffffffa, 28 }, { 0xffffffb, 28 }, { 0x14, 6 }, { 0x3f8, 10 }, { 0x3f9, 10 }, { 0xffa, 12 },
+        { 0x1ff9, 13 }, { 0x15, 6 }, { 0xf8, 8 }, { 0x7fa, 11 }, { 0x3fa, 10 }, { 0x3fb, 10 },
+        { 0xf9, 8 }, { 0x7fb, 11 }, { 0xfa, 8 }, { 0x16, 6 }, { 0x17, 6 }, { 0x18, 6 },
+        { 0x0, 5 }, { 0x1, 5 }, { 0x2, 5 }, { 0x19, 6 }, { 0x1a, 6 }, { 0x1b, 6 },
+        { 0x1c, 6 }, { 0x1d, 6 }, { 0x1e, 6 }, { 0x1f, 6 }, { 0x5c, 7 }, { 0xfb, 8 },
+        { 0x7ffc, 15 }, { 0x20, 6 }, { 0xffb, 12 }, { 0x3fc, 10 }, { 0x1ffa, 13 }, { 0x21, 6 },
+        { 0x5d, 7 }, { 0x5e, 7 }, { 0x5f, 7 }, { 0x60, 7 }, { 0x61, 7 }, { 0x62, 7 },
+        { 0x63, 7 }, { 0x64, 7 }, { 0x65, 7 }, { 0x66, 7 }, { 0x67, 7 }, { 0x68, 7 },
+        { 0x69, 7 }, { 0x6a, 7 }, { 0x6b, 7 }, { 0x6c, 7 }, { 0x6d, 7 }, { 0x6e, 7 },
+        { 0x6f, 7 }, { 0x70, 7 }, { 0x71, 7 }, { 0x72, 7 }, { 0xfc, 8 }, { 0x73, 7 },
+        { 0xfd, 8 }, { 0x1ffb, 13 }, { 0x7fff0, 19 }, { 0x1ffc, 13 }, { 0x3ffc, 14 }, { 0x22, 6 },
+        { 0x7ffd, 15 }, { 0x3, 5 }, { 0x23, 6 }, { 0x4, 5 }, { 0x24, 6 }, { 0x5, 5 },
+        { 0x25, 6 }, { 0x26, 6 }, { 0x27, 6 }, { 0x6, 5 }, { 0x74, 7 }, { 0x75, 7 },
+        { 0x28, 6 }, { 0x29, 6 }, { 0x2a, 6 }, { 0x7, 5 }, { 0x2b, 6 }, { 0x76, 7 },
+        { 0x2c, 6 }, { 0x8, 5 }, { 0x9, 5 }, { 0x2d, 6 }, { 0x77, 7 }, { 0x78, 7 },
+        { 0x79, 7 }, { 0x7a, 7 }, { 0x7b, 7 }, { 0x7ffe, 15 }, { 0x7fc, 11 }, { 0x3ffd, 14 },
+        { 0x1ffd, 13 }, { 0xffffffc, 28 }, { 0xfffe6, 20 }, { 0x3fffd2, 22 }, { 0xfffe7, 20 }, { 0xfffe8, 20 },
+        { 0x3fffd3, 22 }, { 0x3fffd4, 22 }, { 0x3fffd5, 22 }, { 0x7fffd9, 23 }, { 0x3fffd6, 22 }, { 0x7fffda, 23 },
+        { 0x7fffdb, 23 }, { 0x7fffdc, 23 }, { 0x7fffdd, 23 }, { 0x7fffde, 23 }, { 0xffffeb, 24 }, { 0x7fffdf, 23 },
+        { 0xffffec, 24 }, { 0xffffed, 24 }, { 0x3fffd7, 22 }, { 0x7fffe0, 23 }, { 0xffffee, 24 }, { 0x7fffe1, 23 },
+        { 0x7fffe2, 23 }, { 0x7fffe3, 23 }, { 0x7fffe4, 23 }, { 0x1fffdc, 21 }, { 0x3fffd8, 22 }, { 0x7fffe5, 23 },
+        { 0x3fffd9, 22 }, { 0x7fffe6, 23 }, { 0x7fffe7, 23 }, { 0xffffef, 24 }, { 0x3fffda, 22 }, { 0x1fffdd, 21 },
+        { 0xfffe9, 20 }, { 0x3fffdb, 22 }, { 0x3fffdc, 22 }, { 0x7fffe8, 23 }, { 0x7fffe9, 23 }, { 0x1fffde, 21 },
+        { 0x7fffea, 23 }, { 0x3fffdd, 22 }, { 0x3fffde, 22 }, { 0xfffff0, 24 }, { 0x1fffdf, 21 }, { 0x3fffdf, 22 },
+        { 0x7fffeb, 23 }, { 0x7fffec, 23 }, { 0x1fffe0, 21 }, { 0x1fffe1, 21 }, { 0x3fffe0, 22 }, { 0x1fffe2, 21 },
+        { 0x7fffed, 23 }, { 0x3fffe1, 22 }, { 0x7fffee, 23 }, { 0x7fffef, 23 }, { 0xfffea, 20 }, { 0x3fffe2, 22 },
+        { 0x3fffe3, 22 }, { 0x3fffe4, 22 }, { 0x7ffff0, 23 }, { 0x3fffe5, 22 }, { 0x3fffe6, 22 }, { 0x7ffff1, 23 },
+        { 0x3ffffe0, 26 }, { 0x3ffffe1, 26 }, { 0xfffeb, 20 }, { 0x7fff1, 19 }, { 0x3fffe7, 22 }, { 0x7ffff2, 23 },
+        { 0x3fffe8, 22 }, { 0x1ffffec, 25 }, { 0x3ffffe2, 26 }, { 0x3ffffe3, 26 }, { 0x3ffffe4, 26 }, { 0x7ffffde, 27 },
+        { 0x7ffffdf, 27 }, { 0x3ffffe5, 26 }, { 0xfffff1, 24 }, { 0x1ffffed, 25 }, { 0x7fff2, 19 }, { 0x1fffe3, 21 },
+        { 0x3ffffe6, 26 }, { 0x7ffffe0, 27 }, { 0x7ffffe1, 27 }, { 0x3ffffe7, 26 }, { 0x7ffffe2, 27 }, { 0xfffff2, 24 },
+        { 0x1fffe4, 21 }, { 0x1fffe5, 21 }, { 0x3ffffe8, 26 }, { 0x3ffffe9, 26 }, { 0xffffffd, 28 }, { 0x7ffffe3, 27 },
+        { 0x7ffffe4, 27 }, { 0x7ffffe5, 27 }, { 0xfffec, 20 }, { 0xfffff3, 24 }, { 0xfffed, 20 }, { 0x1fffe6, 21 },
+        { 0x3fffe9, 22 }, { 0x1fffe7, 21 }, { 0x1fffe8, 21 }, { 0x7ffff3, 23 }, { 0x3fffea, 22 }, { 0x3fffeb, 22 },
+        { 0x1ffffee, 25 }, { 0x1ffffef, 25 }, { 0xfffff4, 24 }, { 0xfffff5, 24 }, { 0x3ffffea, 26 }, { 0x7ffff4, 23 },
+        { 0x3ffffeb, 26 }, { 0x7ffffe6, 27 }, { 0x3ffffec, 26 }, { 0x3ffffed, 26 }, { 0x7ffffe7, 27 }, { 0x7ffffe8, 27 },
+        { 0x7ffffe9, 27 }, { 0x7ffffea, 27 }, { 0x7ffffeb, 27 }, { 0xffffffe, 28 }, { 0x7ffffec, 27 }, { 0x7ffffed, 27 },
+        { 0x7ffffee, 27 }, { 0x7ffffef, 27 }, { 0x7fffff0, 27 }, { 0x3ffffee, 26 }, { 0x3fffffff, 30 }
+    };
+
+    // Binary decoding tree built once from the code table
+    struct HuffmanTree {
+
+        struct Node {
+            std::int32_t child[2] = { -1, -1 };
+            std::int32_t symbol = -1;
+        };
+
+        std::vector<Node> nodes;
+
+        HuffmanTree() {
+
+            nodes.emplace_back();
+
+            for (int symbol = 0; symbol < 257; ++symbol) {
+                std::size_t node = 0;
+                for (int bit = huffman_codes[symbol].bits - 1; bit >= 0; --bit) {
+                    int branch = (huffman_codes[symbol].code >> bit) & 1;
+                    if (nodes[node].child[branch] < 0) {
+                        nodes[node].child[branch] = static_cast<std::int32_t>(nodes.size());
+                        nodes.emplace_back();
+                    }
+                    node = nodes[node].child[branch];
+                }
+                nodes[node].symbol = symbol;
+            }
+
+        }
+
+    };
+
+    const HuffmanTree& huffman_tree() {
+
+        static const HuffmanTree tree;
+        return tree;
+
+    }
+
+    std::string huffman_decode(std::string_view input) {
+
+        const auto& nodes = huffman_tree().nodes;
+        std::string out;
+        out.reserve(input.size() * 8 / 5);
+
+        std::size_t node = 0;
+        int pending_bits = 0;
+        bool pending_all_ones = true;
+
+        for (unsigned char byte : input) {
+            for (int bit = 7; bit >= 0; --bit) {
+                int branch = (byte >> bit) & 1;
+                node = nodes[node].child[branch];
+                if (static_cast<std::int32_t>(node) < 0) throw HpackError("Invalid Huffman code");
+
+                pending_bits++;
+                pending_all_ones = pending_all_ones && branch;
+
+                if (nodes[node].symbol >= 0) {
+                    if (nodes[node].symbol == 256) throw HpackError("EOS in Huffman string");
+                    out += static_cast<char>(nodes[node].symbol);
+                    node = 0;
+                    pending_bits = 0;
+                    pending_all_ones = true;
+                }
+            }
+        }
+
+        // Padding must be a prefix of EOS (all ones) and shorter than a byte
+        if (pending_bits > 7 || !pending_all_ones) throw HpackError("Invalid Huffman padding");
+
+        return out;
+
+    }
+
+    std::size_t decode_integer(std::string_view block, std::size_t& pos, int prefix_bits) {
+
+        if (pos >= block.size()) throw HpackError("Truncated integer");
+
+        std::size_t mask = (1u << prefix_bits) - 1;
+        std::size_t value = static_cast<unsigned char>(block[pos++]) & mask;
+        if (value < mask) return value;
+
+        for (int shift = 0; ; shift += 7) {
+            if (pos >= block.size()) throw HpackError("Truncated integer");
+            if (shift > 28) throw HpackError("Integer overflow");
+
+            unsigned char byte = static_cast<unsigned char>(block[pos++]);
+            value += static_cast<std::size_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+
+    }
+
+    std::string decode_string(std::string_view block, std::size_t& pos) {
+
+        if (pos >= block.size()) throw HpackError("Truncated string");
+
+        bool huffman = static_cast<unsigned char>(block[pos]) & 0x80;
+        std::size_t length = decode_integer(block, pos, 7);
+        if (length > block.size() - pos) throw HpackError("Truncated string");
+
+        std::string_view raw = block.substr(pos, length);
+        pos += length;
+
+        return huffman ? huffman_decode(raw) : std::string(raw);
+
+    }
+
+    void encode_integer(std::string& out, std::size_t value, int prefix_bits, unsigned char first_byte_flags) {
+
+        std::size_t mask = (1u << prefix_bits) - 1;
+
+        if (value < mask) {
+            out += static_cast<char>(first_byte_flags | value);
+            return;
+        }
+
+        out += static_cast<char>(first_byte_flags | mask);
+        value -= mask;
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+
+    }
+
+    void encode_string(std::string& out, std::string_view value) {
+
+        encode_integer(out, value.size(), 7, 0);
+        out.append(value.data(), value.size());
+
+    }
+
+    std::size_t entry_size(std::string_view name, std::string_view value) {
+
+        return name.size() + value.size() + 32;
+
+    }
+
+}
+
+
+/**
+ * HpackTable class constructor.
+ * @param max_size Maximum table size in HPACK octets
+ */
+HpackTable::HpackTable(std::size_t max_size) : max_size_(max_size) {}
+
+
+/**
+ * Inserts an entry at index 1, evicting the oldest entries to make room.
+ * An entry larger than the whole table empties it (RFC 7541 section 4.4).
+ * @param name Header name
+ * @param value Header value
+ */
+void HpackTable::add(std::string_view name, std::string_view value) {
+
+    std::size_t size = entry_size(name, value);
+
+    if (size > max_size_) {
+        evict(0);
+        return;
+    }
+
+    evict(max_size_ - size);
+    entries_.emplace_front(std::string(name), std::string(value));
+    size_ += size;
+
+}
+
+
+/**
+ * Changes the maximum size, evicting entries that no longer fit.
+ * @param max_size New maximum size in HPACK octets
+ */
+void HpackTable::set_max_size(std::size_t max_size) {
+
+    max_size_ = max_size;
+    evict(max_size_);
+
+}
+
+
+/**
+ * Returns the maximum table size.
+ */
+std::size_t HpackTable::max_size() const {
+
+    return max_size_;
+
+}
+
+
+/**
+ * Returns the number of entries in the table.
+ */
+std::size_t HpackTable::count() const {
+
+    return entries_.size();
+
+}
+
+
+/**
+ * Returns the entry at a dynamic table index.
+ * @param index 1-based index, 1 being the newest entry
+ * @throws HpackError If the index is out of range
+ */
+const HeaderField& HpackTable::at(std::size_t index) const {
+
+    if (index == 0 || index > entries_.size()) throw HpackError("Invalid dynamic table index");
+    return entries_[index - 1];
+
+}
+
+
+/**
+ * Evicts the oldest entries until the table size is at most limit.
+ */
+void HpackTable::evict(std::size_t limit) {
+
+    while (size_ > limit && !entries_.empty()) {
+        size_ -= entry_size(entries_.back().first, entries_.back().second);
+        entries_.pop_back();
+    }
+
+}
+
+
+/**
+ * HpackDecoder class constructor.
+ * @param max_table_size Table size we advertise in SETTINGS_HEADER_TABLE_SIZE
+ */
+HpackDecoder::HpackDecoder(std::size_t max_table_size) : table_(max_table_size), settings_max_size_(max_table_size) {}
+
+
+/**
+ * Decodes a complete header block.
+ * The dynamic table is updated as a side effect, so blocks must be decoded in
+ * the order they were received on the connection.
+ * @param block Concatenated HEADERS/CONTINUATION fragments
+ * @return HeaderList Decoded header fields in order
+ * @throws HpackError If the block is malformed
+ */
+HeaderList HpackDecoder::decode(std::string_view block) {
+
+    HeaderList headers;
+    std::size_t pos = 0;
+
+    while (pos < block.size()) {
+
+        unsigned char byte = static_cast<unsigned char>(block[pos]);
+
+        if (byte & 0x80) {
+            // Indexed header field
+            std::size_t index = decode_integer(block, pos, 7);
+            headers.push_back(lookup(index));
+        }
+        else if ((byte & 0xE0) == 0x20) {
+            // Dynamic table size update
+            std::size_t size = decode_integer(block, pos, 5);
+            if (size > settings_max_size_) throw HpackError("Table size update above SETTINGS_HEADER_TABLE_SIZE");
+            table_.set_max_size(size);
+        }
+        else {
+            // Literal: with incremental indexing (01), without indexing (0000) or never indexed (0001)
+            bool incremental = (byte & 0xC0) == 0x40;
+            std::size_t name_index = decode_integer(block, pos, incremental ? 6 : 4);
+
+            std::string name = name_index ? lookup(name_index).first : decode_string(block, pos);
+            std::string value = decode_string(block, pos);
+
+            if (incremental) table_.add(name, value);
+            headers.emplace_back(std::move(name), std::move(value));
+        }
+
+    }
+
+    return headers;
+
+}
+
+
+/**
+ * Resolves a combined static/dynamic table index.
+ * @throws HpackError If the index is out of range
+ */
+const HeaderField& HpackDecoder::lookup(std::size_t index) const {
+
+    if (index == 0) throw HpackError("Index 0 is not valid");
+    if (index <= static_table_size) return static_table[index - 1];
+    return table_.at(index - static_table_size);
+
+}
+
+
+/**
+ * Applies the peer's SETTINGS_HEADER_TABLE_SIZE.
+ * The table never grows beyond the default; a change is signalled to the peer
+ * with a size update at the start of the next header block.
+ * @param max_size Size advertised by the peer
+ */
+void HpackEncoder::set_max_table_size(std::size_t max_size) {
+
+    std::size_t size = std::min(max_size, default_table_size);
+    if (size == table_.max_size()) return;
+
+    table_.set_max_size(size);
+    size_update_pending_ = true;
+
+}
+
+
+/**
+ * Starts a header block, emitting a pending table size update.
+ * @param out Header block buffer
+ */
+void HpackEncoder::begin_block(std::string& out) {
+
+    if (!size_update_pending_) return;
+
+    encode_integer(out, table_.max_size(), 5, 0x20);
+    size_update_pending_ = false;
+
+}
+
+
+/**
+ * Encodes one header field.
+ * Exact matches become a one-byte index. Otherwise the field is sent as a literal
+ * (reusing an indexed name when possible) and, if indexed is set, added to the
+ * dynamic table so repeats of it cost a single byte. Huffman coding is not used.
+ * @param name Lowercase header name
+ * @param value Header value
+ * @param indexed Whether the field should be added to the dynamic table
+ * @param out Header block buffer
+ */
+void HpackEncoder::encode(std::string_view name, std::string_view value, bool indexed, std::string& out) {
+
+    std::size_t name_index = 0;
+
+    for (std::size_t i = 0; i < static_table_size; ++i) {
+        if (static_table[i].first != name) continue;
+        if (static_table[i].second == value) {
+            encode_integer(out, i + 1, 7, 0x80);
+            return;
+        }
+        if (!name_index) name_index = i + 1;
+    }
+
+    for (std::size_t i = 1; i <= table_.count(); ++i) {
+        const HeaderField& field = table_.at(i);
+        if (field.first != name) continue;
+        if (field.second == value) {
+            encode_integer(out, static_table_size + i, 7, 0x80);
+            return;
+        }
+        if (!name_index) name_index = static_table_size + i;
+    }
+
+    if (indexed) encode_integer(out, name_index, 6, 0x40);
+    else encode_integer(out, name_index, 4, 0x00);
+
+    if (!name_index) encode_string(out, name);
+    encode_string(out, value);
+
+    if (indexed) table_.add(name, value);
+
+}
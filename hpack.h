@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using HeaderField = std::pair<std::string, std::string>;
+using HeaderList = std::vector<HeaderField>;
+
+// Thrown on malformed header blocks; maps to an HTTP/2 COMPRESSION_ERROR
+class HpackError : public std::runtime_error {
+public:
+	using std::runtime_error::runtime_error;
+};
+
+
+// HPACK dynamic table (RFC 7541 section 2.3.2). Index 1 is the newest entry.
+class HpackTable {
+public:
+
+	explicit HpackTable(std::size_t max_size = 4096);
+
+	// Methods
+	void add(std::string_view name, std::string_view value);
+	void set_max_size(std::size_t max_size);
+	std::size_t max_size() const;
+	std::size_t count() const;
+	const HeaderField& at(std::size_t index) const;
+
+private:
+
+	void evict(std::size_t limit);
+
+	std::deque<HeaderField> entries_;
+	std::size_t size_ = 0;
+	std::size_t max_size_;
+
+};
+
+
+class HpackDecoder {
+public:
+
+	// Constructor (max_table_size is our SETTINGS_HEADER_TABLE_SIZE)
+	explicit HpackDecoder(std::size_t max_table_size = 4096);
+
+	// Methods
+	HeaderList decode(std::string_view block);
+
+private:
+
+	const HeaderField& lookup(std::size_t index) const;
+
+	HpackTable table_;
+	std::size_t settings_max_size_;
+
+};
+
+
+class HpackEncoder {
+public:
+
+	// Methods
+	void set_max_table_size(std::size_t max_size);
+	void begin_block(std::string& out);
+	void encode(std::string_view name, std::string_view value, bool indexed, std::string& out);
+
+private:
+
+	// Encoder table is kept at or below the default so a peer can never make us grow it
+	static constexpr std::size_t default_table_size = 4096;
+
+	HpackTable table_{ default_table_size };
+	bool size_update_pending_ = false;
+
+};
@@ -0,0 +1,943 @@
+#include "http2_session.h"
+#include "http_server.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <limits>
+
+namespace {
+
+    // Frame types (RFC 7540 section 6)
+    constexpr std::uint8_t frame_data = 0x0;
+    constexpr std::uint8_t frame_headers = 0x1;
+    constexpr std::uint8_t frame_priority = 0x2;
+    constexpr std::uint8_t frame_rst_stream = 0x3;
+    constexpr std::uint8_t frame_settings = 0x4;
+    constexpr std::uint8_t frame_push_promise = 0x5;
+    constexpr std::uint8_t frame_ping = 0x6;
+    constexpr std::uint8_t frame_goaway = 0x7;
+    constexpr std::uint8_t frame_window_update = 0x8;
+    constexpr std::uint8_t frame_continuation = 0x9;
+
+    // Flags
+    constexpr std::uint8_t flag_end_stream = 0x1;
+    constexpr std::uint8_t flag_ack = 0x1;
+    constexpr std::uint8_t flag_end_headers = 0x4;
+    constexpr std::uint8_t flag_padded = 0x8;
+    constexpr std::uint8_t flag_priority = 0x20;
+
+    // Error codes
+    constexpr std::uint32_t error_no_error = 0x0;
+    constexpr std::uint32_t error_protocol = 0x1;
+    constexpr std::uint32_t error_flow_control = 0x3;
+    constexpr std::uint32_t error_stream_closed = 0x5;
+    constexpr std::uint32_t error_frame_size = 0x6;
+    constexpr std::uint32_t error_refused_stream = 0x7;
+    constexpr std::uint32_t error_compression = 0x9;
+    constexpr std::uint32_t error_enhance_your_calm = 0xb;
+
+    // Settings identifiers
+    constexpr std::uint16_t setting_header_table_size = 0x1;
+    constexpr std::uint16_t setting_max_concurrent_streams = 0x3;
+    constexpr std::uint16_t setting_initial_window_size = 0x4;
+    constexpr std::uint16_t setting_max_frame_size = 0x5;
+
+    // Local limits
+    constexpr std::uint32_t max_concurrent_streams = 256;
+    constexpr std::uint32_t max_frame_size = 16384;
+    constexpr std::size_t max_header_block = 64 * 1024;
+    constexpr std::int64_t max_window = 0x7FFFFFFF;
+
+    std::uint32_t read_u32(std::string_view data) {
+
+        return (static_cast<std::uint32_t>(static_cast<unsigned char>(data[0])) << 24) |
+            (static_cast<std::uint32_t>(static_cast<unsigned char>(data[1])) << 16) |
+            (static_cast<std::uint32_t>(static_cast<unsigned char>(data[2])) << 8) |
+            static_cast<std::uint32_t>(static_cast<unsigned char>(data[3]));
+
+    }
+
+    void append_u32(std::string& out, std::uint32_t value) {
+
+        out += static_cast<char>(value >> 24);
+        out += static_cast<char>(value >> 16);
+        out += static_cast<char>(value >> 8);
+        out += static_cast<char>(value);
+
+    }
+
+    // Decodes the base64url HTTP2-Settings header of an upgrade request
+    std::string base64url_decode(std::string_view input) {
+
+        std::string out;
+        std::uint32_t accumulator = 0;
+        int bits = 0;
+
+        for (char c : input) {
+            int value;
+            if (c >= 'A' && c <= 'Z') value = c - 'A';
+            else if (c >= 'a' && c <= 'z') value = c - 'a' + 26;
+            else if (c >= '0' && c <= '9') value = c - '0' + 52;
+            else if (c == '-' || c == '+') value = 62;
+            else if (c == '_' || c == '/') value = 63;
+            else if (c == '=') break;
+            else throw std::invalid_argument("Invalid HTTP2-Settings header");
+
+            accumulator = (accumulator << 6) | static_cast<std::uint32_t>(value);
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                out += static_cast<char>((accumulator >> bits) & 0xFF);
+            }
+        }
+
+        return out;
+
+    }
+
+    bool contains_token(std::string_view list, std::string_view token) {
+
+        auto lower = [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); };
+
+        std::string haystack(list.size(), '\0');
+        std::transform(list.begin(), list.end(), haystack.begin(), lower);
+        return haystack.find(token) != std::string::npos;
+
+    }
+
+    std::string_view to_std(beast::string_view value) {
+
+        return { value.data(), value.size() };
+
+    }
+
+}
+
+
+/**
+ * Http2Session class constructor.
+ * @param server Server whose request handler answers the streams
+ * @param socket Accepted client connection
+ * @param buffer Bytes already read from the connection
+ */
+Http2Session::Http2Session(HttpServer& server, tcp::socket socket, beast::flat_buffer buffer)
+    : server_(server), socket_(std::move(socket)), read_buffer_(std::move(buffer)),
+      idle_deadline_([this] { server_.idle_closed_++; close(); }) {
+
+    beast::error_code ec;
+    client_ = socket_.remote_endpoint(ec);
+
+    // The HTTP/1.1 session may have capped the buffer; frame sizes are bounded by SETTINGS instead
+    read_buffer_.max_size(std::numeric_limits<std::size_t>::max());
+
+}
+
+
+/**
+ * Checks whether an HTTP/1.1 request asks to upgrade to h2c (RFC 7540 section 3.2).
+ * @param req Parsed HTTP/1.1 request
+ * @return bool True if the request carries Upgrade: h2c and an HTTP2-Settings header
+ */
+bool Http2Session::is_upgrade_request(const http::request<http::string_body>& req) {
+
+    return req.version() == 11 &&
+        contains_token(to_std(req[http::field::upgrade]), "h2c") &&
+        req.find("HTTP2-Settings") != req.end();
+
+}
+
+
+/**
+ * Starts a session whose client sent the connection preface directly (prior knowledge).
+ */
+void Http2Session::start() {
+
+    write_settings();
+    flush_writes();
+    process_input();
+    if (!closing_) do_read();
+
+}
+
+
+/**
+ * Starts a session from an HTTP/1.1 Upgrade: h2c request.
+ * Replies with 101, applies the HTTP2-Settings header, and answers the
+ * upgraded request on stream 1 before reading the client preface.
+ * @param req The HTTP/1.1 request that carried the upgrade
+ */
+void Http2Session::start_upgraded(const http::request<http::string_body>& req) {
+
+    write_queue_ = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+    write_settings();
+
+    try {
+        handle_settings(base64url_decode(to_std(req["HTTP2-Settings"])), false);
+    }
+    catch (const std::exception&) {
+        connection_error(error_protocol);
+        flush_writes();
+        return;
+    }
+
+    last_stream_id_ = 1;
+    Stream& stream = streams_[1];
+    stream.request = req;
+    stream.request.erase(http::field::upgrade);
+    stream.request.erase(http::field::connection);
+    stream.request.erase("HTTP2-Settings");
+    stream.send_window = peer_initial_window_;
+    stream.start = std::chrono::steady_clock::now();
+
+    dispatch(1);
+    flush_writes();
+
+    process_input();
+    if (!closing_) do_read();
+
+}
+
+
+/**
+ * Reads more bytes from the socket and processes all complete frames.
+ * A lean session with nothing buffered frees its read buffer and only waits for the
+ * socket to become readable, so an idle connection holds no buffer.
+ */
+void Http2Session::do_read() {
+
+    if (!server_.lean_buffers_ || read_buffer_.size() > 0) return read_frames();
+
+    read_buffer_.shrink_to_fit();
+
+    socket_.async_wait(tcp::socket::wait_read,
+        [self = shared_from_this()](beast::error_code ec) {
+
+            if (ec) {
+                self->closing_ = true;
+                self->flush_writes();
+                return;
+            }
+
+            self->read_frames();
+
+        }
+    );
+
+}
+
+
+/**
+ * Reads what is available (at most one full frame for lean sessions) and processes it.
+ */
+void Http2Session::read_frames() {
+
+    socket_.async_read_some(read_buffer_.prepare(server_.lean_buffers_ ? 16 * 1024 + 9 : 64 * 1024),
+        [self = shared_from_this()](beast::error_code ec, std::size_t bytes) {
+
+            if (ec) {
+                self->closing_ = true;
+                self->flush_writes();
+                return;
+            }
+
+            self->read_buffer_.commit(bytes);
+            self->process_input();
+            self->flush_writes();
+
+            if (!self->closing_) self->do_read();
+
+        }
+    );
+
+}
+
+
+/**
+ * Consumes the client preface and every complete frame in the read buffer.
+ */
+void Http2Session::process_input() {
+
+    if (!preface_received_) {
+
+        std::string_view data(static_cast<const char*>(read_buffer_.data().data()), read_buffer_.size());
+        std::size_t n = std::min(data.size(), preface.size());
+
+        if (data.substr(0, n) != preface.substr(0, n)) {
+            connection_error(error_protocol);
+            return;
+        }
+        if (n < preface.size()) return;
+
+        read_buffer_.consume(preface.size());
+        preface_received_ = true;
+
+    }
+
+    while (!closing_) {
+
+        std::string_view data(static_cast<const char*>(read_buffer_.data().data()), read_buffer_.size());
+        if (data.size() < 9) break;
+
+        std::uint32_t length = read_u32(data) >> 8;
+        std::uint8_t type = static_cast<std::uint8_t>(data[3]);
+        std::uint8_t flags = static_cast<std::uint8_t>(data[4]);
+        std::uint32_t stream_id = read_u32(data.substr(5)) & 0x7FFFFFFF;
+
+        if (length > max_frame_size) {
+            connection_error(error_frame_size);
+            return;
+        }
+        if (data.size() < 9 + length) break;
+
+        handle_frame(type, flags, stream_id, data.substr(9, length));
+        read_buffer_.consume(9 + length);
+
+    }
+
+}
+
+
+/**
+ * Dispatches one frame by type.
+ * @param type Frame type
+ * @param flags Frame flags
+ * @param stream_id Stream identifier
+ * @param payload Frame payload
+ */
+void Http2Session::handle_frame(std::uint8_t type, std::uint8_t flags, std::uint32_t stream_id, std::string_view payload) {
+
+    // A header block must be contiguous; the first frame must be SETTINGS
+    if (expect_continuation_ && (type != frame_continuation || stream_id != header_stream_)) return connection_error(error_protocol);
+    if (!settings_received_ && type != frame_settings) return connection_error(error_protocol);
+
+    switch (type) {
+
+    case frame_data:
+        handle_data(flags, stream_id, payload);
+        break;
+
+    case frame_headers:
+        handle_headers(flags, stream_id, payload);
+        break;
+
+    case frame_continuation:
+        if (!expect_continuation_) return connection_error(error_protocol);
+        if (header_block_.size() + payload.size() > max_header_block) return connection_error(error_enhance_your_calm);
+        header_block_.append(payload.data(), payload.size());
+        if (flags & flag_end_headers) finish_headers();
+        break;
+
+    case frame_settings:
+        if (stream_id != 0) return connection_error(error_protocol);
+        if (flags & flag_ack) {
+            if (!payload.empty()) connection_error(error_frame_size);
+            break;
+        }
+        handle_settings(payload, true);
+        break;
+
+    case frame_window_update:
+        handle_window_update(stream_id, payload);
+        break;
+
+    case frame_ping:
+        if (stream_id != 0) return connection_error(error_protocol);
+        if (payload.size() != 8) return connection_error(error_frame_size);
+        if (!(flags & flag_ack)) write_frame(frame_ping, flag_ack, 0, payload);
+        break;
+
+    case frame_rst_stream:
+        if (stream_id == 0) return connection_error(error_protocol);
+        if (payload.size() != 4) return connection_error(error_frame_size);
+        streams_.erase(stream_id);
+        break;
+
+    case frame_goaway:
+        // Streams already open are still answered (see on_streams_changed)
+        goaway_received_ = true;
+        break;
+
+    case frame_priority:
+        if (payload.size() != 5) return connection_error(error_frame_size);
+        break;
+
+    case frame_push_promise:
+        connection_error(error_protocol);
+        break;
+
+    default:
+        // Unknown frame types are ignored (RFC 7540 section 4.1)
+        break;
+
+    }
+
+}
+
+
+/**
+ * Handles a HEADERS frame: opens a stream (or receives trailers) and starts a header block.
+ */
+void Http2Session::handle_headers(std::uint8_t flags, std::uint32_t stream_id, std::string_view payload) {
+
+    if (stream_id == 0 || !(stream_id & 1)) return connection_error(error_protocol);
+
+    if (flags & flag_padded) {
+        if (payload.empty()) return connection_error(error_protocol);
+        std::size_t padding = static_cast<unsigned char>(payload[0]);
+        if (padding >= payload.size()) return connection_error(error_protocol);
+        payload = payload.substr(1, payload.size() - 1 - padding);
+    }
+    if (flags & flag_priority) {
+        if (payload.size() < 5) return connection_error(error_protocol);
+        payload.remove_prefix(5);
+    }
+
+    auto it = streams_.find(stream_id);
+    header_refused_ = false;
+
+    if (it == streams_.end()) {
+        if (stream_id <= last_stream_id_) return connection_error(error_stream_closed);
+        last_stream_id_ = stream_id;
+        header_refused_ = streams_.size() >= max_concurrent_streams;
+    }
+    else if (it->second.request_complete) {
+        return connection_error(error_stream_closed);
+    }
+
+    header_stream_ = stream_id;
+    header_end_stream_ = flags & flag_end_stream;
+    header_block_.assign(payload.data(), payload.size());
+
+    if (flags & flag_end_headers) finish_headers();
+    else expect_continuation_ = true;
+
+}
+
+
+/**
+ * Decodes a complete header block and creates or completes its stream.
+ * The block is always decoded, even for refused streams, to keep HPACK state in sync.
+ */
+void Http2Session::finish_headers() {
+
+    expect_continuation_ = false;
+
+    HeaderList headers;
+    try {
+        headers = decoder_.decode(header_block_);
+    }
+    catch (const HpackError&) {
+        return connection_error(error_compression);
+    }
+    header_block_.clear();
+
+    std::uint32_t stream_id = header_stream_;
+
+    if (header_refused_) return reset_stream(stream_id, error_refused_stream);
+
+    auto it = streams_.find(stream_id);
+    if (it != streams_.end()) {
+        // Trailers: nothing to keep, but they may end the stream
+        if (header_end_stream_) dispatch(stream_id);
+        return;
+    }
+
+    Stream& stream = streams_[stream_id];
+    stream.send_window = peer_initial_window_;
+    stream.recv_window = 65535;
+    stream.start = std::chrono::steady_clock::now();
+    stream.request.version(11);
+
+    bool has_method = false;
+    bool has_path = false;
+
+    for (const auto& [name, value] : headers) {
+        if (name == ":method") {
+            stream.request.method_string(value);
+            has_method = true;
+        }
+        else if (name == ":path") {
+            stream.request.target(value);
+            has_path = true;
+        }
+        else if (name == ":authority") {
+            stream.request.set(http::field::host, value);
+        }
+        else if (!name.empty() && name[0] != ':') {
+            stream.request.insert(name, value);
+        }
+    }
+
+    if (!has_method || !has_path) {
+        streams_.erase(stream_id);
+        return reset_stream(stream_id, error_protocol);
+    }
+
+    BodyRules rules = body_rules(to_std(stream.request.method_string()), to_std(stream.request.target()));
+    stream.body_limit = rules.limit;
+    if (rules.schema != BodySchema::none) stream.validator = std::make_unique<BodyValidator>(rules.schema);
+
+    // A declared length over the limit is refused before any DATA arrives
+    auto content_length = stream.request.find(http::field::content_length);
+    std::uint64_t declared = 0;
+    if (content_length != stream.request.end()) std::from_chars(content_length->value().data(), content_length->value().data() + content_length->value().size(), declared);
+    if (declared > stream.body_limit) return reject_stream(stream_id, http::status::payload_too_large, body_limit_error(stream.body_limit));
+
+    if (header_end_stream_) dispatch(stream_id);
+
+}
+
+
+/**
+ * Handles a DATA frame: appends to the request body and returns the flow-control credit.
+ */
+void Http2Session::handle_data(std::uint8_t flags, std::uint32_t stream_id, std::string_view payload) {
+
+    if (stream_id == 0) return connection_error(error_protocol);
+
+    // Flow control covers the whole frame payload, padding included
+    std::uint32_t length = static_cast<std::uint32_t>(payload.size());
+    connection_recv_window_ -= length;
+    if (connection_recv_window_ < 0) return connection_error(error_flow_control);
+
+    if (length) {
+        std::string increment;
+        append_u32(increment, length);
+        write_frame(frame_window_update, 0, 0, increment);
+        connection_recv_window_ += length;
+    }
+
+    if (flags & flag_padded) {
+        if (payload.empty()) return connection_error(error_protocol);
+        std::size_t padding = static_cast<unsigned char>(payload[0]);
+        if (padding >= payload.size()) return connection_error(error_protocol);
+        payload = payload.substr(1, payload.size() - 1 - padding);
+    }
+
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end() || it->second.request_complete) {
+        if (stream_id > last_stream_id_) return connection_error(error_protocol);
+        return reset_stream(stream_id, error_stream_closed);
+    }
+
+    Stream& stream = it->second;
+    stream.recv_window -= length;
+    if (stream.recv_window < 0) {
+        streams_.erase(it);
+        return reset_stream(stream_id, error_flow_control);
+    }
+
+    if (stream.request.body().size() + payload.size() > stream.body_limit) {
+        return reject_stream(stream_id, http::status::payload_too_large, body_limit_error(stream.body_limit));
+    }
+    stream.request.body().append(payload.data(), payload.size());
+
+    if (stream.validator && !stream.validator->write(payload)) return reject_stream(stream_id, http::status::bad_request, stream.validator->error());
+
+    if (flags & flag_end_stream) {
+        dispatch(stream_id);
+    }
+    else if (length) {
+        std::string increment;
+        append_u32(increment, length);
+        write_frame(frame_window_update, 0, stream_id, increment);
+        stream.recv_window += length;
+    }
+
+}
+
+
+/**
+ * Applies a SETTINGS payload from the peer.
+ * @param payload Sequence of 6-byte identifier/value pairs
+ * @param send_ack Whether to acknowledge (false for the HTTP2-Settings upgrade header)
+ */
+void Http2Session::handle_settings(std::string_view payload, bool send_ack) {
+
+    if (payload.size() % 6) return connection_error(error_frame_size);
+
+    for (std::size_t pos = 0; pos < payload.size(); pos += 6) {
+
+        std::uint16_t id = static_cast<std::uint16_t>((static_cast<unsigned char>(payload[pos]) << 8) | static_cast<unsigned char>(payload[pos + 1]));
+        std::uint32_t value = read_u32(payload.substr(pos + 2));
+
+        switch (id) {
+
+        case setting_header_table_size:
+            encoder_.set_max_table_size(value);
+            break;
+
+        case setting_initial_window_size: {
+            if (value > max_window) return connection_error(error_flow_control);
+            std::int64_t delta = static_cast<std::int64_t>(value) - peer_initial_window_;
+            peer_initial_window_ = value;
+            for (auto& [id, stream] : streams_) stream.send_window += delta;
+            break;
+        }
+
+        case setting_max_frame_size:
+            if (value < 16384 || value > 16777215) return connection_error(error_protocol);
+            peer_max_frame_size_ = value;
+            break;
+
+        default:
+            break;
+
+        }
+
+    }
+
+    if (send_ack) {
+        settings_received_ = true;
+        write_frame(frame_settings, flag_ack, 0, {});
+        flush_all_streams();
+    }
+
+}
+
+
+/**
+ * Handles WINDOW_UPDATE for the connection or a stream and resumes blocked responses.
+ */
+void Http2Session::handle_window_update(std::uint32_t stream_id, std::string_view payload) {
+
+    if (payload.size() != 4) return connection_error(error_frame_size);
+
+    std::uint32_t increment = read_u32(payload) & 0x7FFFFFFF;
+
+    if (stream_id == 0) {
+        if (increment == 0) return connection_error(error_protocol);
+        connection_send_window_ += increment;
+        if (connection_send_window_ > max_window) return connection_error(error_flow_control);
+        flush_all_streams();
+        return;
+    }
+
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end()) return;
+
+    if (increment == 0) {
+        streams_.erase(it);
+        return reset_stream(stream_id, error_protocol);
+    }
+
+    it->second.send_window += increment;
+    if (it->second.send_window > max_window) {
+        streams_.erase(it);
+        return reset_stream(stream_id, error_flow_control);
+    }
+
+    flush_stream(stream_id);
+
+}
+
+
+/**
+ * Runs the request of a completed stream through the API handler on the API threads
+ * and sends the response once it is back. The request moves out of the stream, which a
+ * RST_STREAM may drop meanwhile; the stream keeps its method and target for the log.
+ */
+void Http2Session::dispatch(std::uint32_t stream_id) {
+
+    Stream& stream = streams_.at(stream_id);
+    stream.request_complete = true;
+
+    if (stream.validator && !stream.validator->finish()) return reject_stream(stream_id, http::status::bad_request, stream.validator->error());
+    stream.validator.reset();
+
+    stream.request.prepare_payload();
+
+    server_.capture_request(stream.request);
+
+    auto request = std::make_shared<http::request<http::string_body>>(std::move(stream.request));
+    stream.request = {};
+    stream.request.method_string(request->method_string());
+    stream.request.target(request->target());
+
+    server_.post_api_request(api_request(*request), socket_.get_executor(), [self = shared_from_this(), stream_id, request](http::response<http::string_body>& res) {
+
+        if (!self->streams_.count(stream_id)) return;
+        self->send_response(stream_id, res);
+        self->flush_writes();
+
+    });
+
+}
+
+
+/**
+ * Answers a stream whose body was refused before it reached the handler. If the
+ * client is still sending, the stream is then reset with NO_ERROR so it stops
+ * (RFC 9113 section 8.1); DATA already in flight is answered with STREAM_CLOSED.
+ * @param stream_id Stream to answer
+ * @param status 413 or 400
+ * @param message Error for the client
+ */
+void Http2Session::reject_stream(std::uint32_t stream_id, http::status status, const std::string& message) {
+
+    Stream& stream = streams_.at(stream_id);
+    bool still_sending = !stream.request_complete;
+    stream.request_complete = true;
+
+    auto res = server_.reject_body(11, status, message);
+    stream.validator.reset();
+    send_response(stream_id, res);
+
+    if (still_sending && !streams_.contains(stream_id)) reset_stream(stream_id, error_no_error);
+
+}
+
+
+/**
+ * Encodes the response headers and queues the body behind flow control.
+ * Repeated headers (server, content-type, CORS) are indexed in the HPACK
+ * dynamic table so after the first response they cost one byte each.
+ */
+void Http2Session::send_response(std::uint32_t stream_id, http::response<http::string_body>& res) {
+
+    Stream& stream = streams_.at(stream_id);
+
+    std::string block;
+    encoder_.begin_block(block);
+    encoder_.encode(":status", std::to_string(res.result_int()), true, block);
+
+    std::string name;
+    for (const auto& field : res) {
+        auto raw = field.name_string();
+        name.assign(raw.data(), raw.size());
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        // Connection-specific headers are not allowed in HTTP/2
+        if (name == "connection" || name == "keep-alive" || name == "transfer-encoding" || name == "upgrade") continue;
+
+        encoder_.encode(name, to_std(field.value()), name != "content-length" && name != "date", block);
+    }
+
+    stream.pending = std::move(res.body());
+    stream.status = res.result_int();
+    stream.bytes = block.size();
+    stream.response_started = true;
+
+    // HEADERS followed by CONTINUATION if the block exceeds the peer's frame size
+    std::string_view remaining(block);
+    std::uint8_t type = frame_headers;
+    std::uint8_t end_stream = stream.pending.empty() ? flag_end_stream : 0;
+
+    do {
+        std::string_view fragment = remaining.substr(0, peer_max_frame_size_);
+        remaining.remove_prefix(fragment.size());
+
+        std::uint8_t flags = remaining.empty() ? flag_end_headers : 0;
+        if (type == frame_headers) flags |= end_stream;
+
+        write_frame(type, flags, stream_id, fragment);
+        type = frame_continuation;
+    } while (!remaining.empty());
+
+    if (stream.pending.empty()) finish_stream(stream_id);
+    else flush_stream(stream_id);
+
+}
+
+
+/**
+ * Sends as much of a stream's pending body as the stream and connection windows allow.
+ */
+void Http2Session::flush_stream(std::uint32_t stream_id) {
+
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end() || !it->second.response_started) return;
+
+    Stream& stream = it->second;
+
+    while (stream.sent < stream.pending.size()) {
+
+        std::int64_t window = std::min(stream.send_window, connection_send_window_);
+        if (window <= 0) return;
+
+        std::size_t n = std::min({ stream.pending.size() - stream.sent, static_cast<std::size_t>(window), static_cast<std::size_t>(peer_max_frame_size_) });
+        bool last = stream.sent + n == stream.pending.size();
+
+        write_frame(frame_data, last ? flag_end_stream : 0, stream_id, std::string_view(stream.pending).substr(stream.sent, n));
+
+        stream.sent += n;
+        stream.bytes += n;
+        stream.send_window -= static_cast<std::int64_t>(n);
+        connection_send_window_ -= static_cast<std::int64_t>(n);
+
+    }
+
+    finish_stream(stream_id);
+
+}
+
+
+/**
+ * Resumes every stream that has a response waiting for window.
+ */
+void Http2Session::flush_all_streams() {
+
+    std::vector<std::uint32_t> ids;
+    for (const auto& [id, stream] : streams_) {
+        if (stream.response_started) ids.push_back(id);
+    }
+
+    for (std::uint32_t id : ids) {
+        if (connection_send_window_ <= 0) break;
+        flush_stream(id);
+    }
+
+}
+
+
+/**
+ * Logs a fully sent stream and releases it.
+ */
+void Http2Session::finish_stream(std::uint32_t stream_id) {
+
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end()) return;
+
+    Stream& stream = it->second;
+    auto method = stream.request.method_string();
+    auto target = stream.request.target();
+
+    server_.access_log_.record(to_std(method), to_std(target), stream.status,
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - stream.start), stream.bytes, client_);
+
+    streams_.erase(it);
+
+}
+
+
+/**
+ * Applies the open stream count once everything queued has been written.
+ * The idle deadline only runs while no stream is open and no write is in flight, so
+ * slow handlers and long responses keep their connection; each read that leaves
+ * nothing to send restarts it. After the peer's GOAWAY, the connection closes once the
+ * last open stream is answered.
+ */
+void Http2Session::on_streams_changed() {
+
+    if (closing_) return;
+
+    if (!streams_.empty()) return server_.deadlines_.cancel(idle_deadline_);
+
+    if (goaway_received_) {
+        closing_ = true;
+        return;
+    }
+
+    server_.deadlines_.schedule(idle_deadline_, server_.timeouts_.idle);
+
+}
+
+
+/**
+ * Appends a frame to the write queue.
+ */
+void Http2Session::write_frame(std::uint8_t type, std::uint8_t flags, std::uint32_t stream_id, std::string_view payload) {
+
+    append_u32(write_queue_, static_cast<std::uint32_t>(payload.size()) << 8 | type);
+    write_queue_ += static_cast<char>(flags);
+    append_u32(write_queue_, stream_id & 0x7FFFFFFF);
+    write_queue_.append(payload.data(), payload.size());
+
+}
+
+
+/**
+ * Queues the server connection preface (our SETTINGS).
+ */
+void Http2Session::write_settings() {
+
+    std::string payload;
+    payload += static_cast<char>(setting_max_concurrent_streams >> 8);
+    payload += static_cast<char>(setting_max_concurrent_streams & 0xFF);
+    append_u32(payload, max_concurrent_streams);
+
+    write_frame(frame_settings, 0, 0, payload);
+
+}
+
+
+/**
+ * Queues RST_STREAM for a stream.
+ */
+void Http2Session::reset_stream(std::uint32_t stream_id, std::uint32_t error_code) {
+
+    std::string payload;
+    append_u32(payload, error_code);
+    write_frame(frame_rst_stream, 0, stream_id, payload);
+
+}
+
+
+/**
+ * Queues GOAWAY and closes the connection once it has been written.
+ */
+void Http2Session::connection_error(std::uint32_t error_code) {
+
+    if (closing_) return;
+
+    std::string payload;
+    append_u32(payload, last_stream_id_);
+    append_u32(payload, error_code);
+    write_frame(frame_goaway, 0, 0, payload);
+
+    closing_ = true;
+
+}
+
+
+/**
+ * Writes everything queued so far with a single async_write.
+ * Frames produced while a write is in flight are batched into the next one.
+ */
+void Http2Session::flush_writes() {
+
+    if (writing_) return;
+
+    if (write_queue_.empty()) {
+        on_streams_changed();
+        if (closing_) close();
+        return;
+    }
+
+    server_.deadlines_.cancel(idle_deadline_);
+    write_buffer_.swap(write_queue_);
+    write_queue_.clear();
+    writing_ = true;
+
+    asio::async_write(socket_, asio::buffer(write_buffer_),
+        [self = shared_from_this()](beast::error_code ec, std::size_t) {
+
+            self->writing_ = false;
+            self->write_buffer_.clear();
+            if (self->server_.lean_buffers_) self->write_buffer_.shrink_to_fit();
+
+            if (ec) {
+                self->closing_ = true;
+                self->write_queue_.clear();
+            }
+
+            self->flush_writes();
+
+        }
+    );
+
+}
+
+
+/**
+ * Disarms the idle deadline and shuts the socket down.
+ */
+void Http2Session::close() {
+
+    server_.deadlines_.cancel(idle_deadline_);
+
+    beast::error_code ec;
+    socket_.shutdown(tcp::socket::shutdown_both, ec);
+    socket_.close(ec);
+
+}
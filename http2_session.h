@@ -0,0 +1,118 @@
+#pragma once
+#include "body_validator.h"
+#include "hpack.h"
+#include "timer_wheel.h"
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+
+class HttpServer;
+
+// One cleartext HTTP/2 (h2c) connection. Streams are multiplexed over the socket
+// and each completed request is answered through HttpServer::handle_api_request.
+class Http2Session : public std::enable_shared_from_this<Http2Session> {
+public:
+
+	// Client connection preface (RFC 7540 section 3.5)
+	static constexpr std::string_view preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+	Http2Session(HttpServer& server, tcp::socket socket, beast::flat_buffer buffer);
+
+	// Methods
+	static bool is_upgrade_request(const http::request<http::string_body>& req);
+	void start();
+	void start_upgraded(const http::request<http::string_body>& req);
+
+private:
+
+	struct Stream {
+
+		http::request<http::string_body> request;
+		bool request_complete = false;
+		bool response_started = false;
+		std::int64_t send_window = 0;
+		std::int64_t recv_window = 0;
+		std::string pending;
+		std::size_t sent = 0;
+		std::size_t bytes = 0;
+		unsigned status = 0;
+		std::chrono::steady_clock::time_point start;
+		std::size_t body_limit = 0;
+		std::unique_ptr<BodyValidator> validator;	// only while a JSON body is read
+
+	};
+
+	// Frame handling
+	void do_read();
+	void read_frames();
+	void process_input();
+	void handle_frame(std::uint8_t type, std::uint8_t flags, std::uint32_t stream_id, std::string_view payload);
+	void handle_headers(std::uint8_t flags, std::uint32_t stream_id, std::string_view payload);
+	void handle_data(std::uint8_t flags, std::uint32_t stream_id, std::string_view payload);
+	void handle_settings(std::string_view payload, bool send_ack);
+	void handle_window_update(std::uint32_t stream_id, std::string_view payload);
+	void finish_headers();
+
+	// Responses and flow control
+	void dispatch(std::uint32_t stream_id);
+	void reject_stream(std::uint32_t stream_id, http::status status, const std::string& message);
+	void send_response(std::uint32_t stream_id, http::response<http::string_body>& res);
+	void flush_stream(std::uint32_t stream_id);
+	void flush_all_streams();
+	void finish_stream(std::uint32_t stream_id);
+	void on_streams_changed();
+
+	// Output
+	void write_frame(std::uint8_t type, std::uint8_t flags, std::uint32_t stream_id, std::string_view payload);
+	void write_settings();
+	void reset_stream(std::uint32_t stream_id, std::uint32_t error_code);
+	void connection_error(std::uint32_t error_code);
+	void flush_writes();
+	void close();
+
+	HttpServer& server_;
+	tcp::socket socket_;
+	beast::flat_buffer read_buffer_;
+	tcp::endpoint client_;
+
+	// Closes the connection after the idle timeout without any input; off while a stream is open
+	TimerWheel::Timer idle_deadline_;
+
+	HpackDecoder decoder_;
+	HpackEncoder encoder_;
+
+	bool preface_received_ = false;
+	bool settings_received_ = false;
+	bool closing_ = false;
+	bool goaway_received_ = false;	// the peer opens no more streams; close once the open ones are answered
+	bool writing_ = false;
+	std::string write_queue_;
+	std::string write_buffer_;
+
+	std::uint32_t last_stream_id_ = 0;
+	std::unordered_map<std::uint32_t, Stream> streams_;
+
+	// Header block being assembled from HEADERS + CONTINUATION
+	std::uint32_t header_stream_ = 0;
+	bool header_end_stream_ = false;
+	bool header_refused_ = false;
+	bool expect_continuation_ = false;
+	std::string header_block_;
+
+	// Peer settings and connection-level windows
+	std::uint32_t peer_max_frame_size_ = 16384;
+	std::int64_t peer_initial_window_ = 65535;
+	std::int64_t connection_send_window_ = 65535;
+	std::int64_t connection_recv_window_ = 65535;
+
+};
@@ -1,18 +1,552 @@
 #include <iostream>
 #include "http_server.h"
+#include "http_session.h"
+#include "http2_session.h"
+#include "tls_session.h"
+#include "arrow_ipc.h"
+#include "csv_import.h"
 #include <boost/json.hpp>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <thread>
 
 namespace json = boost::json;
 
+namespace {
+
+    // Upper bound on ids accepted by one multi-get request
+    constexpr std::size_t max_multi_get_ids = 1000;
+
+    // Upper bound on operations accepted by one POST /batch
+    constexpr std::size_t max_batch_ops = 1000;
+
+    // API threads when none are configured. Handlers mostly wait on SQLite and on group
+    // commits, and every waiting write is one more that can share a commit, so there are
+    // more of them than cores.
+    unsigned default_api_threads() {
+
+        return std::max(8u, 2 * std::thread::hardware_concurrency());
+
+    }
+
+    // Routes counted by the heavy-hitter sketch; the index is the sketch key
+    enum Route { route_list_tasks, route_multi_get, route_export_tasks, route_create_task, route_import_tasks, route_patch_task, route_batch, route_metrics, route_admin_hot, route_other, route_count };
+
+    constexpr const char* route_names[route_count] = {
+        "GET /tasks", "GET /tasks?ids", "GET /tasks/export", "POST /tasks", "POST /tasks/import", "PATCH /tasks/{id}", "POST /batch", "GET /metrics", "GET /admin/hot", "other"
+    };
+
+    // Task id of a "/tasks/{id}" path, or 0 if the path has another shape
+    int task_id_from_path(std::string_view path) {
+
+        constexpr std::string_view prefix = "/tasks/";
+        if (path.substr(0, prefix.size()) != prefix) return 0;
+
+        int id = 0;
+        auto [end, ec] = std::from_chars(path.data() + prefix.size(), path.data() + path.size(), id);
+        return ec == std::errc() && end == path.data() + path.size() && id > 0 ? id : 0;
+
+    }
+
+    // Value of a query parameter, or nullopt when absent
+    std::optional<std::string_view> query_param(std::string_view query, std::string_view name) {
+
+        while (!query.empty()) {
+            std::size_t end = query.find('&');
+            std::string_view pair = query.substr(0, end);
+
+            if (pair.size() > name.size() && pair.substr(0, name.size()) == name && pair[name.size()] == '=') return pair.substr(name.size() + 1);
+
+            if (end == std::string_view::npos) break;
+            query.remove_prefix(end + 1);
+        }
+
+        return std::nullopt;
+
+    }
+
+    // Parses "1,2,3" (commas may be URL-encoded as %2C) into out without allocating; returns the count
+    std::size_t parse_id_list(std::string_view list, std::span<int> out) {
+
+        std::size_t count = 0;
+        const char* p = list.data();
+        const char* end = p + list.size();
+
+        while (p < end) {
+
+            if (count == out.size()) throw std::invalid_argument("Too many ids (max " + std::to_string(out.size()) + ")");
+
+            auto [next, ec] = std::from_chars(p, end, out[count]);
+            if (ec != std::errc() || out[count] <= 0) throw std::invalid_argument("Invalid task ID in ids");
+            ++count;
+            p = next;
+
+            if (p == end) break;
+            if (*p == ',') ++p;
+            else if (end - p >= 3 && p[0] == '%' && p[1] == '2' && (p[2] == 'C' || p[2] == 'c')) p += 3;
+            else throw std::invalid_argument("Invalid task ID in ids");
+            if (p == end) throw std::invalid_argument("Invalid task ID in ids");
+
+        }
+
+        return count;
+
+    }
+
+    // Parses "id,title" (commas may be URL-encoded as %2C) into a TaskField mask
+    unsigned parse_field_list(std::string_view list) {
+
+        unsigned fields = 0;
+
+        while (true) {
+            std::size_t comma = list.find(',');
+            std::size_t encoded = std::min(list.find("%2C"), list.find("%2c"));
+            std::size_t end = std::min(comma, encoded);
+            std::string_view name = list.substr(0, end);
+
+            const ColumnRule* column = find_column(name);
+            if (!column) throw std::invalid_argument("Unknown field '" + std::string(name) + "'");
+            fields |= column->flag;
+
+            if (end == std::string_view::npos) break;
+            list.remove_prefix(end + (end == comma ? 1 : 3));
+        }
+
+        return fields;
+
+    }
+
+    // TaskField mask of a read's "fields" parameter; every field when it is absent
+    unsigned requested_fields(std::string_view query) {
+
+        auto list = query_param(query, "fields");
+        return list ? parse_field_list(*list) : field_all;
+
+    }
+
+    // Typed reads of request members. A member of the wrong type or out of range is the
+    // client's error, reported naming the member; where prefixes the message.
+    void read_json(const json::value& value, int& out, std::string_view name, const std::string& where) {
+
+        const std::int64_t* number = value.if_int64();
+        if (!number || *number < std::numeric_limits<int>::min() || *number > std::numeric_limits<int>::max()) {
+            throw std::invalid_argument(where + "Field '" + std::string(name) + "' must be a 32-bit integer");
+        }
+        out = static_cast<int>(*number);
+
+    }
+
+    void read_json(const json::value& value, bool& out, std::string_view name, const std::string& where) {
+
+        if (!value.is_bool()) throw std::invalid_argument(where + "Field '" + std::string(name) + "' must be true or false");
+        out = value.as_bool();
+
+    }
+
+    void read_json(const json::value& value, std::string& out, std::string_view name, const std::string& where) {
+
+        const json::string* text = value.if_string();
+        if (!text) throw std::invalid_argument(where + "Field '" + std::string(name) + "' must be a string");
+        out.assign(text->data(), text->size());
+
+    }
+
+    // The task fields present in a request object; other members are ignored
+    TaskPatch read_task_fields(const json::object& object, const std::string& where = "") {
+
+        TaskPatch fields;
+        for_each_value_column([&](const auto& column) {
+            if (const json::value* value = object.if_contains(column.name)) read_json(*value, (fields.*column.patch_member).emplace(), column.name, where);
+        });
+        return fields;
+
+    }
+
+    // A task id member: an integer from 1 to INT_MAX, so it can never wrap onto another task
+    int read_task_id(const json::value& value, const std::string& where) {
+
+        const std::int64_t* number = value.if_int64();
+        if (!number || *number < 1 || *number > std::numeric_limits<int>::max()) {
+            throw std::invalid_argument(where + "Field 'id' must be an integer from 1 to " + std::to_string(std::numeric_limits<int>::max()));
+        }
+        return static_cast<int>(*number);
+
+    }
+
+    // Parses element index of a POST /batch "ops" array. /batch bodies are only checked for
+    // syntax before they get here, so every member is type-checked.
+    TaskOp parse_task_op(const json::value& value, std::size_t index) {
+
+        std::string where = "Operation " + std::to_string(index) + ": ";
+
+        const json::object* op_json = value.if_object();
+        if (!op_json) throw std::invalid_argument(where + "Must be an object");
+
+        const json::value* kind_json = op_json->if_contains("op");
+        if (!kind_json || !kind_json->is_string()) throw std::invalid_argument(where + "Field 'op' must be \"create\", \"update\" or \"delete\"");
+        std::string_view kind = kind_json->as_string();
+
+        TaskOp op{ TaskOp::Kind::create, 0, {} };
+        if (kind == "update") op.kind = TaskOp::Kind::update;
+        else if (kind == "delete") op.kind = TaskOp::Kind::remove;
+        else if (kind != "create") throw std::invalid_argument(where + "Unknown operation '" + std::string(kind) + "'");
+
+        if (const json::value* id = op_json->if_contains("id")) op.id = read_task_id(*id, where);
+        op.fields = read_task_fields(*op_json, where);
+
+        return op;
+
+    }
+
+    // Result entry of a POST /batch response; a successful operation reports what it did
+    json::object task_op_result_to_json(const TaskOp& op, const TaskOpResult& result) {
+
+        static constexpr const char* done[] = { "created", "updated", "deleted" };
+
+        json::object result_json;
+        switch (result.status) {
+        case TaskOpResult::Status::ok: result_json["status"] = done[static_cast<int>(op.kind)]; break;
+        case TaskOpResult::Status::not_found: result_json["status"] = "not_found"; break;
+        case TaskOpResult::Status::failed: result_json["status"] = "failed"; break;
+        case TaskOpResult::Status::rolled_back: result_json["status"] = "rolled_back"; break;
+        case TaskOpResult::Status::skipped: result_json["status"] = "skipped"; break;
+        }
+
+        if (result.id > 0) result_json["id"] = result.id;
+        if (!result.error.empty()) result_json["error"] = result.error;
+        return result_json;
+
+    }
+
+    // Reads the optional "Durability: strict|batched|async" header of a mutation
+    std::optional<Durability> durability_header(const ApiRequest& req) {
+
+        if (!req.durability) return std::nullopt;
+
+        std::string_view level = *req.durability;
+        if (level == "strict") return Durability::strict;
+        if (level == "batched") return Durability::batched;
+        if (level == "async") return Durability::async;
+        throw std::invalid_argument("Unknown durability '" + std::string(level) + "'");
+
+    }
+
+    // ",\"name\":" for each column, built at compile time; column names are plain
+    // identifiers and need no escaping. The first member of an object drops the comma.
+    constexpr std::array<FixedText<32>, task_column_count> json_keys = [] {
+
+        std::array<FixedText<32>, task_column_count> keys{};
+        std::size_t i = 0;
+        for_each_column([&](const auto& column) {
+            keys[i] += ",\"";
+            keys[i] += column.name;
+            keys[i++] += "\":";
+        });
+        return keys;
+
+    }();
+
+    void append_json(std::string& out, int value) {
+
+        char digits[16];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        out.append(digits, result.ptr);
+
+    }
+
+    void append_json(std::string& out, bool value) {
+
+        out += value ? "true" : "false";
+
+    }
+
+    // Quoted and escaped the same way json::serialize does
+    void append_json(std::string& out, std::string_view text) {
+
+        static constexpr char hex[] = "0123456789abcdef";
+
+        out += '"';
+        std::size_t run = 0;
+        for (std::size_t i = 0; i < text.size(); ++i) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+            out.append(text.data() + run, i - run);
+            run = i + 1;
+            switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xF];
+            }
+        }
+        out.append(text.data() + run, text.size() - run);
+        out += '"';
+
+    }
+
+    // Writes a task object straight into out, with only the members selected by fields
+    void append_task_json(std::string& out, const Task& task, unsigned fields = field_all) {
+
+        out += '{';
+        std::size_t i = 0;
+        bool first = true;
+        for_each_column([&](const auto& column) {
+            std::string_view key = json_keys[i++].view();
+            if (!(fields & column.flag)) return;
+            out += first ? key.substr(1) : key;
+            first = false;
+            append_json(out, task.*column.member);
+        });
+        out += '}';
+
+    }
+
+    // Comma-separated task objects, without the enclosing brackets
+    void append_tasks_json(std::string& out, const std::vector<Task>& tasks, unsigned fields) {
+
+        out.reserve(out.size() + tasks.size() * 64);
+        for (const auto& task : tasks) {
+            if (!out.empty() && out.back() != '[') out += ',';
+            append_task_json(out, task, fields);
+        }
+
+    }
+
+    // JSON array of tasks
+    std::string tasks_to_json(const std::vector<Task>& tasks, unsigned fields) {
+
+        std::string body = "[";
+        append_tasks_json(body, tasks, fields);
+        body += ']';
+        return body;
+
+    }
+
+    // JSON array stitched from pieces made by append_tasks_json, in order; empty pieces are skipped
+    std::string join_json_array(const std::vector<std::string>& parts) {
+
+        std::size_t size = 2;
+        for (const auto& part : parts) size += part.size() + 1;
+
+        std::string body;
+        body.reserve(size);
+        body += '[';
+        for (const auto& part : parts) {
+            if (part.empty()) continue;
+            if (body.size() > 1) body += ',';
+            body += part;
+        }
+        body += ']';
+        return body;
+
+    }
+
+}
+
+/**
+ * Views a Beast request as an API request.
+ * @param req Parsed request; must outlive the result
+ * @return ApiRequest Views into req
+ */
+ApiRequest api_request(const http::request<http::string_body>& req) {
+
+    ApiRequest request;
+    request.method = req.method();
+    request.method_string = { req.method_string().data(), req.method_string().size() };
+    request.target = { req.target().data(), req.target().size() };
+    request.version = req.version();
+    request.keep_alive = req.keep_alive();
+    request.body = req.body();
+
+    auto it = req.find("Durability");
+    if (it != req.end()) request.durability = std::string_view(it->value().data(), it->value().size());
+
+    return request;
+
+}
+
+/**
+ * Views a head from the fast parser and its body as an API request, without copying.
+ * @param head Parsed head
+ * @param body Body bytes, content_length of them
+ * @return ApiRequest Views into the parser's input
+ */
+ApiRequest api_request(const RequestHead& head, std::string_view body) {
+
+    ApiRequest request;
+    request.method = http::string_to_verb({ head.method.data(), head.method.size() });
+    request.method_string = head.method;
+    request.target = head.target;
+    request.version = 10 + head.minor_version;
+    request.keep_alive = head.keep_alive;
+    request.body = body;
+
+    for (std::size_t i = 0; i < head.header_count; ++i) {
+        const HeaderView& header = head.headers[i];
+        if (beast::iequals({ header.name.data(), header.name.size() }, "Durability")) request.durability = header.value;
+    }
+
+    return request;
+
+}
+
 /**
  * HttpServer class constructor.
  * Initializes the HTTP server with the specified port and task manager.
  * @param io_context ASIO I/O context for asynchronous operations
  * @param port Port number to listen on
  * @param task_manager Reference to TaskManager for task operations
+ * @param access_log Access log receiving one entry per handled request
  */
-HttpServer::HttpServer(asio::io_context& io_context, unsigned short port, TaskManager& task_manager) : acceptor_(io_context, { tcp::v4(), port }), task_manager_(task_manager) {
+HttpServer::HttpServer(asio::io_context& io_context, unsigned short port, TaskManager& task_manager, AccessLog& access_log)
+    : acceptor_(io_context, { tcp::v4(), port }), task_manager_(task_manager), access_log_(access_log), wheel_timer_(io_context),
+      api_pool_(std::make_unique<asio::thread_pool>(default_api_threads())) {
     start_accept();
+    tick_deadlines();
+}
+
+/**
+ * Returns the local port the server listens on.
+ * @return unsigned short Bound port
+ */
+unsigned short HttpServer::port() const {
+
+    return acceptor_.local_endpoint().port();
+
+}
+
+/**
+ * Enables or disables request capture.
+ * @param capture Capture writer receiving sampled requests, or nullptr to stop capturing
+ */
+void HttpServer::set_capture(RequestCaptureWriter* capture) {
+
+    capture_ = capture;
+
+}
+
+/**
+ * Sets the connection deadlines. Deadlines already armed keep their old length.
+ * @param timeouts Idle, header-read and body-read limits
+ */
+void HttpServer::set_connection_timeouts(const ConnectionTimeouts& timeouts) {
+
+    timeouts_ = timeouts;
+
+}
+
+/**
+ * Switches new connections between throughput-sized and lean buffers.
+ * Lean connections release their read buffer whenever it drains, so an idle
+ * connection holds no heap buffer, and cap each read at a size that still fits
+ * any request header or HTTP/2 frame.
+ * @param lean True to trade a few extra reads for memory per connection
+ */
+void HttpServer::set_lean_buffers(bool lean) {
+
+    lean_buffers_ = lean;
+
+}
+
+/**
+ * Switches HTTP/1.1 connections between Beast's parser and the in-place fast path.
+ * @param fast True to try parse_request_head first on every request
+ */
+void HttpServer::set_fast_parser(bool fast) {
+
+    fast_parser_ = fast;
+
+}
+
+/**
+ * Replaces the API thread pool; call before the server takes requests.
+ * @param threads Number of threads; 0 for the default
+ */
+void HttpServer::set_api_threads(unsigned threads) {
+
+    api_pool_->join();
+    api_pool_ = std::make_unique<asio::thread_pool>(threads > 0 ? threads : default_api_threads());
+
+}
+
+/**
+ * Starts accepting HTTPS connections on a second port.
+ * Handshakes run asynchronously in TlsSession, so they never block either acceptor.
+ * @param port Port number for TLS (0 picks an ephemeral port)
+ * @param tls_context Server TLS context; must outlive the server
+ */
+void HttpServer::listen_tls(unsigned short port, asio::ssl::context& tls_context) {
+
+    tls_context_ = &tls_context;
+    tls_acceptor_ = std::make_unique<tcp::acceptor>(acceptor_.get_executor(), tcp::endpoint(tcp::v4(), port));
+    start_accept_tls();
+
+}
+
+/**
+ * Returns the local port of the TLS acceptor.
+ * @return unsigned short Bound port, or 0 if TLS is not enabled
+ */
+unsigned short HttpServer::tls_port() const {
+
+    return tls_acceptor_ ? tls_acceptor_->local_endpoint().port() : 0;
+
+}
+
+/**
+ * Pins the hottest tasks in the task cache and keeps the pin set current.
+ * Every interval the top tasks of the heavy-hitter sketch replace the previous pins.
+ * @param count Number of tasks to pin (0 stops pinning)
+ * @param interval Time between refreshes
+ */
+void HttpServer::pin_hot_tasks(std::size_t count, std::chrono::seconds interval) {
+
+    pin_count_ = count;
+    pin_interval_ = interval;
+
+    if (!pin_timer_) pin_timer_ = std::make_unique<asio::steady_timer>(acceptor_.get_executor());
+    refresh_pins();
+
+}
+
+/**
+ * Timer handler behind pin_hot_tasks.
+ * Storage errors are reported and retried on the next tick.
+ */
+void HttpServer::refresh_pins() {
+
+    std::vector<int> ids;
+    for (const auto& hitter : hot_tasks_.top()) {
+        if (ids.size() == pin_count_) break;
+        ids.push_back(static_cast<int>(hitter.key));
+    }
+
+    try {
+        task_manager_.pin_tasks(ids);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Failed to pin hot tasks: " << e.what() << "\n";
+    }
+
+    if (pin_count_ == 0) return;
+
+    pin_timer_->expires_after(pin_interval_);
+    pin_timer_->async_wait([this](beast::error_code ec) {
+        if (!ec) refresh_pins();
+    });
+
 }
 
 /**
@@ -25,87 +559,369 @@ void HttpServer::start_accept() {
 
         [this](beast::error_code ec, tcp::socket socket) {
 
-            if (!ec) {
+            if (!ec) std::make_shared<HttpSession>(*this, std::move(socket))->start();
 
-                auto stream = beast::tcp_stream(std::move(socket));
-                auto buffer = beast::flat_buffer();
+            start_accept();
+        
+        }
+    );
+}
 
-                handle_request(std::move(stream), std::move(buffer));
+/**
+ * Starts asynchronous acceptance of incoming TLS connections.
+ */
+void HttpServer::start_accept_tls() {
 
-            }
+    tls_acceptor_->async_accept(
+
+        [this](beast::error_code ec, tcp::socket socket) {
+
+            if (!ec) std::make_shared<TlsSession>(*this, std::move(socket), *tls_context_)->start();
+
+            start_accept_tls();
 
-            start_accept();
-        
         }
     );
 }
 
 /**
- * Handles an incoming HTTP request.
- * Reads the request, processes it, and sends back a response.
- * @param stream TCP stream for communication with the client
- * @param buffer Buffer for storing incoming request data
+ * Advances the connection deadline wheel once per tick, closing expired connections.
  */
-void HttpServer::handle_request(beast::tcp_stream stream, beast::flat_buffer buffer) {
+void HttpServer::tick_deadlines() {
+
+    wheel_timer_.expires_after(deadlines_.tick());
 
-    http::request<http::string_body> req;
-    http::read(stream, buffer, req);
+    wheel_timer_.async_wait([this](beast::error_code ec) {
 
-    auto res = handle_api_request(req);
+        if (ec) return;
 
-    http::write(stream, res);
-    stream.socket().shutdown(tcp::socket::shutdown_send);
+        deadlines_.advance(std::chrono::steady_clock::now());
+        tick_deadlines();
+
+    });
+
+}
+
+/**
+ * Writes a sampled copy of the request to the capture file, if capturing is enabled.
+ * @param req Parsed HTTP request
+ */
+void HttpServer::capture_request(const http::request<http::string_body>& req) {
+
+    if (!capture_ || !capture_->should_sample()) return;
+
+    CapturedRequest captured;
+    captured.method = std::string(req.method_string());
+    captured.target = std::string(req.target());
+    for (const auto& field : req) captured.headers.emplace_back(std::string(field.name_string()), std::string(field.value()));
+    captured.body = req.body();
+
+    capture_->write(captured);
+
+}
+
+/**
+ * Capture for a request read by the fast parser; copies only when the request is sampled.
+ * @param head Parsed head
+ * @param body Request body
+ */
+void HttpServer::capture_request(const RequestHead& head, std::string_view body) {
+
+    if (!capture_ || !capture_->should_sample()) return;
+
+    CapturedRequest captured;
+    captured.method = std::string(head.method);
+    captured.target = std::string(head.target);
+    for (std::size_t i = 0; i < head.header_count; ++i) captured.headers.emplace_back(std::string(head.headers[i].name), std::string(head.headers[i].value));
+    captured.body = std::string(body);
+
+    capture_->write(captured);
 
 }
 
 /**
  * Processes API requests and generates appropriate HTTP responses.
  * Routes requests to the appropriate handler based on HTTP method and target.
- * @param req HTTP request object containing request details
+ * @param req Request; its views must stay valid for the call
  * @return http::response<http::string_body> HTTP response with JSON body
  */
-http::response<http::string_body> HttpServer::handle_api_request(const http::request<http::string_body>& req) {
+http::response<http::string_body> HttpServer::handle_api_request(const ApiRequest& req) {
 
     http::response<http::string_body> res;
-    res.version(req.version());
+    res.version(req.version);
     res.set(http::field::server, "C++ Rest Server");
     res.set(http::field::content_type, "application/json");
     res.set(http::field::access_control_allow_origin, "*");
 
+    Route route = route_other;
+
     try {
 
-        if (req.method() == http::verb::get && req.target() == "/tasks") {
+        std::string_view target = req.target;
+        std::string_view path = target.substr(0, target.find('?'));
+        std::string_view query = path.size() < target.size() ? target.substr(path.size() + 1) : std::string_view();
 
-            auto tasks = task_manager_.get_all_tasks();
-            json::array tasks_json;
+        auto ids_param = query_param(query, "ids");
+
+        if (req.method == http::verb::get && path == "/tasks" && ids_param) {
+
+            route = route_multi_get;
+            unsigned fields = requested_fields(query);
+
+            std::array<int, max_multi_get_ids> ids;
+            std::size_t count = parse_id_list(*ids_param, ids);
+            for (std::size_t i = 0; i < count; ++i) hot_tasks_.record(static_cast<std::uint64_t>(ids[i]));
+
+            res.result(http::status::ok);
+            res.body() = tasks_to_json(task_manager_.get_tasks(std::span<const int>(ids.data(), count), fields), fields);
+
+        }
+        else if (req.method == http::verb::get && path == "/tasks") {
+
+            route = route_list_tasks;
+            unsigned fields = requested_fields(query);
+            // One query on one connection, so the list is a single snapshot
+            res.result(http::status::ok);
+            res.body() = tasks_to_json(task_manager_.get_all_tasks(fields), fields);
+
+        }
+        else if (req.method == http::verb::get && path == "/tasks/export") {
+
+            route = route_export_tasks;
+            unsigned fields = requested_fields(query);
+            std::string_view format = query_param(query, "format").value_or("json");
+
+            if (format == "arrow") {
+                // Columns are filled straight from the cursor; the body holds the whole stream
+                std::string body;
+                ArrowTaskWriter writer(body, fields);
+                task_manager_.read_columns(fields, writer);
+                writer.finish();
+
+                res.set(http::field::content_type, ArrowTaskWriter::content_type);
+                res.body() = std::move(body);
+            }
+            else if (format == "json") {
+                // Ranges are read and serialized on the scan threads, then joined in id order
+                std::vector<std::string> parts(task_manager_.scan_ranges());
+                task_manager_.scan_tasks(fields, [&](std::size_t range, std::vector<Task>& tasks) { append_tasks_json(parts[range], tasks, fields); });
+                res.body() = join_json_array(parts);
+            }
+            else {
+                throw std::invalid_argument("Unknown export format '" + std::string(format) + "'");
+            }
 
-            for (const auto task : tasks) { 
-                tasks_json.push_back({
-                    {"id", task.id},
-                    {"title", task.title},
-                    {"description", task.description},
-                    {"completed", task.completed}
+            res.result(http::status::ok);
+
+        }
+        else if (req.method == http::verb::get && path == "/metrics") {
+
+            route = route_metrics;
+            json::array statements_json;
+
+            for (const auto& profile : task_manager_.get_statement_profiles()) {
+                json::array plan_json;
+                for (const auto& step : profile.plan) plan_json.push_back(json::value(step));
+
+                statements_json.push_back({
+                    {"sql", profile.sql},
+                    {"count", profile.count},
+                    {"total_ns", profile.total_ns},
+                    {"p50_ns", profile.p50_ns},
+                    {"p90_ns", profile.p90_ns},
+                    {"p99_ns", profile.p99_ns},
+                    {"max_ns", profile.max_ns},
+                    {"fullscan_rows", profile.fullscan_rows},
+                    {"vm_steps", profile.vm_steps},
+                    {"full_scan", profile.full_scan},
+                    {"plan", plan_json}
                 });
             }
 
+            json::object metrics_json{
+                {"access_log", {
+                    {"written", access_log_.written()},
+                    {"dropped", access_log_.dropped()}
+                }},
+                {"statements", statements_json},
+                {"connections", {
+                    {"deadlines", deadlines_.size()},
+                    {"idle_closed", idle_closed_.load()},
+                    {"slow_closed", slow_closed_.load()},
+                    {"fast_parsed", fast_parsed_.load()},
+                    {"full_parsed", full_parsed_.load()}
+                }},
+                {"bodies", {
+                    {"too_large", body_too_large_.load()},
+                    {"invalid", body_invalid_.load()}
+                }}
+            };
+
+            TaskCacheStats cache = task_manager_.get_cache_stats();
+            if (cache.budget_bytes > 0) {
+                std::uint64_t lookups = cache.hits + cache.misses;
+                metrics_json["cache"] = {
+                    {"hits", cache.hits},
+                    {"misses", cache.misses},
+                    {"hit_rate", lookups ? static_cast<double>(cache.hits) / lookups : 0.0},
+                    {"evictions", cache.evictions},
+                    {"rejections", cache.rejections},
+                    {"entries", cache.entries},
+                    {"pinned", cache.pinned},
+                    {"bytes", cache.bytes},
+                    {"budget_bytes", cache.budget_bytes}
+                };
+            }
+
+            double first_request_ms = first_request_ms_.load();
+            json::object startup_json{ {"first_request_ms", first_request_ms < 0 ? json::value(nullptr) : json::value(first_request_ms)} };
+            WarmupStats warmup = task_manager_.get_warmup_stats();
+            if (warmup.started) {
+                startup_json["warm"] = warmup.warm;
+                if (warmup.failed) startup_json["warm_error"] = warmup.error;
+                startup_json["warm_ms"] = warmup.elapsed_ms;
+                startup_json["warm_tasks"] = warmup.tasks;
+            }
+            metrics_json["startup"] = std::move(startup_json);
+
+            WriteBatchStats writes = task_manager_.get_write_stats();
+            if (writes.submitted > 0) {
+                metrics_json["writes"] = {
+                    {"submitted", writes.submitted},
+                    {"written", writes.written},
+                    {"inserted", writes.inserted},
+                    {"failed", writes.failed},
+                    {"commits", writes.commits},
+                    {"amplification", static_cast<double>(writes.written + writes.inserted) / writes.submitted}
+                };
+            }
+
+            if (tls_context_) {
+                TlsStats tls = get_tls_stats(*tls_context_);
+                metrics_json["tls"] = {
+                    {"handshakes", tls.handshakes},
+                    {"resumed", tls.resumed},
+                    {"misses", tls.misses},
+                    {"timeouts", tls.timeouts},
+                    {"cache_full", tls.cache_full},
+                    {"cached_sessions", tls.cached_sessions}
+                };
+            }
+
             res.result(http::status::ok);
-            res.body() = json::serialize(tasks_json);
+            res.body() = json::serialize(metrics_json);
 
         }
-        else if (req.method() == http::verb::post && req.target() == "/tasks") {
+        else if (req.method == http::verb::post && path == "/tasks/import") {
 
-            json::value request_json = json::parse(req.body());
+            route = route_import_tasks;
+            std::string_view format = query_param(query, "format").value_or("csv");
+            if (format != "csv") throw std::invalid_argument("Unknown import format '" + std::string(format) + "'");
 
-            if (!request_json.as_object().contains("title")) throw std::runtime_error("Field 'title' is required");
+            CsvImportStats stats = import_csv(req.body, task_manager_);
+
+            res.result(http::status::created);
+            res.body() = json::serialize(json::object{
+                {"imported", stats.rows},
+                {"chunks", stats.chunks},
+                {"threads", stats.threads},
+                {"elapsed_ms", stats.elapsed_ms},
+                {"rows_per_s", stats.elapsed_ms > 0 ? stats.rows / stats.elapsed_ms * 1000 : 0.0}
+            });
+
+        }
+        else if (req.method == http::verb::post && path == "/tasks") {
+
+            route = route_create_task;
+            json::value request_json = json::parse(req.body);
+            TaskPatch fields = read_task_fields(request_json.as_object());
+
+            if (!fields.title) throw std::runtime_error("Field 'title' is required");
+
+            std::optional<Durability> durability = durability_header(req);
 
             // create task
-            int id = task_manager_.create_task(
-                request_json.at("title").as_string().c_str(),
-                request_json.as_object().contains("description") ? request_json.at("description").as_string().c_str() : ""
-            );
+            int id = task_manager_.create_task(*fields.title, fields.description.value_or(""), durability);
 
-            res.result(http::status::created);
-            res.body() = json::serialize(json::object{ {"id", id} });
+            // An async create is only queued, so there is no id to return yet
+            if (durability == Durability::async) {
+                res.result(http::status::accepted);
+                res.body() = json::serialize(json::object{ {"accepted", true} });
+            }
+            else {
+                res.result(http::status::created);
+                res.body() = json::serialize(json::object{ {"id", id} });
+            }
+
+        }
+        else if (req.method == http::verb::patch && task_id_from_path(path) > 0) {
+
+            route = route_patch_task;
+            int id = task_id_from_path(path);
+            hot_tasks_.record(static_cast<std::uint64_t>(id));
+
+            json::value body = json::parse(req.body);
+            const json::object& request_json = body.as_object();
+
+            TaskPatch patch = read_task_fields(request_json);
+
+            std::optional<Durability> durability = durability_header(req);
+
+            if (task_manager_.patch_task(id, patch, durability)) {
+                res.result(durability == Durability::async ? http::status::accepted : http::status::ok);
+                res.body() = json::serialize(json::object{ {"id", id} });
+            }
+            else {
+                res.result(http::status::not_found);
+                res.body() = json::serialize(json::object{ {"error", "Task not found"} });
+            }
+
+        }
+        else if (req.method == http::verb::post && path == "/batch") {
+
+            route = route_batch;
+
+            json::value body = json::parse(req.body);
+            const json::value* ops_value = body.is_object() ? body.as_object().if_contains("ops") : nullptr;
+            if (!ops_value || !ops_value->is_array()) throw std::invalid_argument("Field 'ops' must be an array of operations");
+            const json::array& ops_json = ops_value->as_array();
+            if (ops_json.size() > max_batch_ops) throw std::invalid_argument("Too many operations (max " + std::to_string(max_batch_ops) + ")");
+
+            std::vector<TaskOp> ops;
+            ops.reserve(ops_json.size());
+            for (std::size_t i = 0; i < ops_json.size(); ++i) ops.push_back(parse_task_op(ops_json[i], i));
+
+            std::vector<TaskOpResult> results = task_manager_.apply_batch(ops);
+
+            bool committed = true;
+            json::array results_json;
+            for (std::size_t i = 0; i < ops.size(); ++i) {
+                committed = committed && results[i].status == TaskOpResult::Status::ok;
+                results_json.push_back(task_op_result_to_json(ops[i], results[i]));
+            }
+
+            // A batch that was rolled back is a conflict with the current state, not a server error
+            res.result(committed ? http::status::ok : http::status::conflict);
+            res.body() = json::serialize(json::object{ {"committed", committed}, {"results", results_json} });
+
+        }
+        else if (req.method == http::verb::get && path == "/admin/hot") {
+
+            route = route_admin_hot;
+
+            json::array tasks_json;
+            for (const auto& hitter : hot_tasks_.top()) tasks_json.push_back({ {"id", hitter.key}, {"count", hitter.count} });
+
+            json::array routes_json;
+            for (const auto& hitter : hot_routes_.top()) routes_json.push_back({ {"route", route_names[hitter.key]}, {"count", hitter.count} });
+
+            res.result(http::status::ok);
+            res.body() = json::serialize(json::object{
+                {"requests", hot_routes_.total()},
+                {"tasks", tasks_json},
+                {"routes", routes_json},
+                {"pinned", task_manager_.get_cache_stats().pinned}
+            });
 
         }
         else {
@@ -115,6 +931,13 @@ http::response<http::string_body> HttpServer::handle_api_request(const http::req
 
         }
 
+    }
+    catch (const std::invalid_argument& e) {
+
+        // Validation failures: bad ids, fields, formats, CSV rows and task values
+        res.result(http::status::bad_request);
+        res.body() = json::serialize(json::object{ {"error", e.what()} });
+
     }
     catch (const std::exception& e) {
 
@@ -123,7 +946,57 @@ http::response<http::string_body> HttpServer::handle_api_request(const http::req
 
     }
 
+    hot_routes_.record(route);
+
+    double unset = -1;
+    double first_request_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started_).count();
+    if (first_request_ms_.load(std::memory_order_relaxed) < 0 && first_request_ms_.compare_exchange_strong(unset, first_request_ms)) {
+        std::cout << "First request answered " << first_request_ms << " ms after startup\n";
+    }
+
     res.prepare_payload();
     return res;
 
 }
+
+
+/**
+ * Runs a request through handle_api_request on the API thread pool. Handlers block on
+ * SQLite, and a batched write waits for its group commit, so running them on the io
+ * thread would hold up every connection meanwhile and leave at most one write to share
+ * a commit. The response is handed back on the session's executor.
+ * @param req Request; what it views must stay valid until done has run
+ * @param executor Executor of the connection that done runs on
+ * @param done Receives the response
+ */
+void HttpServer::post_api_request(const ApiRequest& req, const asio::any_io_executor& executor, std::function<void(http::response<http::string_body>&)> done) {
+
+    asio::post(*api_pool_, [this, req, executor, done = std::move(done)]() mutable {
+        asio::post(executor, [res = handle_api_request(req), done = std::move(done)]() mutable { done(res); });
+    });
+
+}
+
+
+/**
+ * Builds the response for a request whose body was rejected while it was being read,
+ * before the API handler saw it.
+ * @param version HTTP version of the request
+ * @param status 413 for a body over its limit, 400 for one that failed validation
+ * @param message Error reported to the client
+ * @return http::response<http::string_body> JSON error response
+ */
+http::response<http::string_body> HttpServer::reject_body(unsigned version, http::status status, const std::string& message) {
+
+    if (status == http::status::payload_too_large) body_too_large_++;
+    else body_invalid_++;
+
+    http::response<http::string_body> res{ status, version };
+    res.set(http::field::server, "C++ Rest Server");
+    res.set(http::field::content_type, "application/json");
+    res.set(http::field::access_control_allow_origin, "*");
+    res.body() = json::serialize(json::object{ {"error", message} });
+    res.prepare_payload();
+    return res;
+
+}
\ No newline at end of file
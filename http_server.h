@@ -1,25 +1,134 @@
 #pragma once
 #include "task_manager.h"
+#include "access_log.h"
+#include "request_capture.h"
+#include "tls_context.h"
+#include "heavy_hitters.h"
+#include "timer_wheel.h"
+#include "fast_request_parser.h"
 #include <boost/asio.hpp>
+#include <boost/asio/thread_pool.hpp>
 #include <boost/beast.hpp>
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <string_view>
 
 namespace beast = boost::beast;
 namespace http = beast::http;
 namespace asio = boost::asio;
 using tcp = asio::ip::tcp;
 
+// Deadlines enforced on every client connection
+struct ConnectionTimeouts {
+
+	std::chrono::milliseconds idle{ 60000 };	// kept-alive connection waiting for its next request
+	std::chrono::milliseconds header{ 10000 };	// from accept or the first byte until the headers are complete
+	std::chrono::milliseconds body{ 30000 };	// reading the request body, and again writing the response
+
+};
+
+// What the API handler and the access log read from a request. The views point into a
+// Beast request or, on the HTTP/1.1 fast path, straight into the read buffer, which the
+// session keeps until the response is written.
+struct ApiRequest {
+
+	http::verb method = http::verb::unknown;
+	std::string_view method_string;
+	std::string_view target;
+	unsigned version = 11;
+	bool keep_alive = true;
+	std::optional<std::string_view> durability;	// Durability header, if sent
+	std::string_view body;
+
+};
+
+ApiRequest api_request(const http::request<http::string_body>& req);
+ApiRequest api_request(const RequestHead& head, std::string_view body);
+
+
 class HttpServer {
 public:
 
-	HttpServer(asio::io_context& io_context, unsigned short port, TaskManager& task_manager);
+	HttpServer(asio::io_context& io_context, unsigned short port, TaskManager& task_manager, AccessLog& access_log);
+
+	// Port the acceptor is bound to (useful when constructed with port 0)
+	unsigned short port() const;
+
+	// Record sampled requests to a capture file (nullptr disables)
+	void set_capture(RequestCaptureWriter* capture);
+
+	// Accept HTTPS on a second port
+	void listen_tls(unsigned short port, asio::ssl::context& tls_context);
+	unsigned short tls_port() const;
+
+	// Deadlines for new and existing connections
+	void set_connection_timeouts(const ConnectionTimeouts& timeouts);
+
+	// Free connection buffers while idle and cap how far reads can grow them
+	void set_lean_buffers(bool lean);
+
+	// Parse common HTTP/1.1 requests in place, falling back to Beast for the rest
+	void set_fast_parser(bool fast);
+
+	// Threads that run API handlers; 0 picks the default (see post_api_request)
+	void set_api_threads(unsigned threads);
+
+	// Periodically pin the hottest tasks seen by the heavy-hitter sketch in the task cache
+	void pin_hot_tasks(std::size_t count, std::chrono::seconds interval);
 
 private:
 
+	friend class HttpSession;
+	friend class Http2Session;
+	friend class TlsSession;
+
 	void start_accept();
-	void handle_request(beast::tcp_stream stream, beast::flat_buffer buffer);
-	http::response<http::string_body> handle_api_request(const http::request<http::string_body>& req);
+	void start_accept_tls();
+	void tick_deadlines();
+	void capture_request(const http::request<http::string_body>& req);
+	void capture_request(const RequestHead& head, std::string_view body);
+	http::response<http::string_body> handle_api_request(const ApiRequest& req);
+	void post_api_request(const ApiRequest& req, const asio::any_io_executor& executor, std::function<void(http::response<http::string_body>&)> done);
+	http::response<http::string_body> reject_body(unsigned version, http::status status, const std::string& message);
+	void refresh_pins();
 
 	tcp::acceptor acceptor_;
 	TaskManager& task_manager_;
+	AccessLog& access_log_;
+	RequestCaptureWriter* capture_ = nullptr;
+
+	std::unique_ptr<tcp::acceptor> tls_acceptor_;
+	asio::ssl::context* tls_context_ = nullptr;
+
+	HeavyHitters hot_tasks_{ 32 };
+	HeavyHitters hot_routes_{ 8, 64 };
+
+	std::unique_ptr<asio::steady_timer> pin_timer_;
+	std::chrono::seconds pin_interval_{ 0 };
+	std::size_t pin_count_ = 0;
+
+	// One wheel drives the deadlines of all connections instead of a timer each
+	TimerWheel deadlines_{ std::chrono::milliseconds(100) };
+	asio::steady_timer wheel_timer_;
+	ConnectionTimeouts timeouts_;
+	bool lean_buffers_ = false;
+	bool fast_parser_ = false;
+
+	// Counted on the io thread, read by /metrics on an API thread
+	std::atomic<std::uint64_t> fast_parsed_{ 0 };
+	std::atomic<std::uint64_t> full_parsed_{ 0 };
+	std::atomic<std::uint64_t> idle_closed_{ 0 };
+	std::atomic<std::uint64_t> slow_closed_{ 0 };
+	std::atomic<std::uint64_t> body_too_large_{ 0 };
+	std::atomic<std::uint64_t> body_invalid_{ 0 };
+
+	// Startup timing: when the server was created and, once known, how long until the
+	// first API response
+	std::chrono::steady_clock::time_point started_ = std::chrono::steady_clock::now();
+	std::atomic<double> first_request_ms_{ -1 };
+
+	// API handlers run here, off the io thread; declared last so it is joined first
+	std::unique_ptr<asio::thread_pool> api_pool_;
 
 };
\ No newline at end of file
@@ -0,0 +1,420 @@
+#include "http_session.h"
+#include "fast_request_parser.h"
+#include "http2_session.h"
+#include "http_server.h"
+#include <limits>
+
+namespace {
+
+    // Read buffer cap for lean connections; larger than any accepted request header
+    constexpr std::size_t lean_buffer_limit = 16 * 1024;
+
+}
+
+
+/**
+ * HttpSession class constructor.
+ * @param server Server whose request handler answers the requests
+ * @param socket Accepted client socket
+ */
+HttpSession::HttpSession(HttpServer& server, tcp::socket socket)
+    : server_(server), socket_(std::move(socket)), deadline_([this] { on_deadline(); }) {
+
+    beast::error_code ec;
+    client_ = socket_.remote_endpoint(ec);
+
+    if (server_.lean_buffers_) buffer_.max_size(lean_buffer_limit);
+
+}
+
+
+/**
+ * Arms the header deadline and starts telling HTTP/2 prior knowledge from HTTP/1.1.
+ */
+void HttpSession::start() {
+
+    server_.deadlines_.schedule(deadline_, server_.timeouts_.header);
+    read_preface();
+
+}
+
+
+/**
+ * Reads just enough of the connection to tell HTTP/2 prior knowledge from HTTP/1.1.
+ * Bytes read stay in the buffer for whichever protocol handler takes over.
+ */
+void HttpSession::read_preface() {
+
+    const std::string_view preface = Http2Session::preface;
+
+    std::string_view data(static_cast<const char*>(buffer_.data().data()), buffer_.size());
+    std::size_t n = std::min(data.size(), preface.size());
+
+    if (data.substr(0, n) != preface.substr(0, n)) return read_request();
+
+    if (n == preface.size()) {
+        server_.deadlines_.cancel(deadline_);
+        std::make_shared<Http2Session>(server_, std::move(socket_), std::move(buffer_))->start();
+        return;
+    }
+
+    socket_.async_read_some(buffer_.prepare(1024),
+        [self = shared_from_this()](beast::error_code ec, std::size_t bytes) {
+
+            if (ec) return self->close();
+
+            self->buffer_.commit(bytes);
+            self->read_preface();
+
+        }
+    );
+
+}
+
+
+/**
+ * Waits for the next request on a kept-alive connection under the idle deadline.
+ * Pipelined bytes already in the buffer start the request right away.
+ */
+void HttpSession::wait_for_request() {
+
+    if (buffer_.size() > 0) {
+        server_.deadlines_.schedule(deadline_, server_.timeouts_.header);
+        return read_request();
+    }
+
+    idle_ = true;
+    server_.deadlines_.schedule(deadline_, server_.timeouts_.idle);
+
+    // Nothing is buffered, so a lean connection can give the memory back until the next request
+    if (server_.lean_buffers_) buffer_.shrink_to_fit();
+
+    socket_.async_wait(tcp::socket::wait_read,
+        [self = shared_from_this()](beast::error_code ec) {
+
+            if (ec) return self->close();
+
+            // The first byte of a request starts the header deadline
+            self->idle_ = false;
+            self->server_.deadlines_.schedule(self->deadline_, self->server_.timeouts_.header);
+            self->read_request();
+
+        }
+    );
+
+}
+
+
+/**
+ * Reads the next request; the header deadline is already armed.
+ */
+void HttpSession::read_request() {
+
+    if (server_.fast_parser_) return read_request_fast();
+    read_request_full();
+
+}
+
+
+/**
+ * Parses the request straight out of the read buffer when it is a common one,
+ * reading more until its head and Content-Length body are complete. The body is
+ * validated as it arrives. Unusual requests go to Beast, which starts over on the
+ * same unconsumed bytes. A complete request is answered from views into the buffer,
+ * which is only consumed after the response is written.
+ */
+void HttpSession::read_request_fast() {
+
+    std::string_view data(static_cast<const char*>(buffer_.data().data()), buffer_.size());
+
+    RequestHead head;
+    HeadParse result = parse_request_head(data, head);
+
+    if (result == HeadParse::complete) {
+        BodyRules rules = body_rules(head.method, head.target);
+        std::string_view body = data.substr(head.size, head.content_length);
+        bool body_read = body.size() == head.content_length;
+
+        if (head.content_length > rules.limit) {
+            req_ = {};
+            fill_request(head, {}, req_);
+            return reject(http::status::payload_too_large, body_limit_error(rules.limit), false);
+        }
+
+        if (rules.schema != BodySchema::none) {
+            if (!validator_) validator_ = std::make_unique<BodyValidator>(rules.schema);
+            bool valid = validator_->write(body.substr(validated_));
+            validated_ = body.size();
+            if (valid && body_read) valid = validator_->finish();
+
+            if (!valid) {
+                req_ = {};
+                fill_request(head, {}, req_);
+                if (body_read) buffer_.consume(head.size + head.content_length);
+                return reject(http::status::bad_request, validator_->error(), body_read);
+            }
+        }
+
+        if (body_read) {
+            server_.deadlines_.cancel(deadline_);
+            server_.fast_parsed_++;
+            validator_.reset();
+            validated_ = 0;
+
+            server_.capture_request(head, body);
+            request_ = api_request(head, body);
+            consumed_ = head.size + head.content_length;
+
+            return answer();
+        }
+    }
+
+    std::size_t room = std::min<std::size_t>(1024, buffer_.max_size() - buffer_.size());
+    if (result == HeadParse::fallback || room == 0) return read_request_full();
+
+    // The body is read under the body deadline, like on the Beast path
+    if (result == HeadParse::complete) server_.deadlines_.schedule(deadline_, server_.timeouts_.body);
+
+    socket_.async_read_some(buffer_.prepare(room),
+        [self = shared_from_this()](beast::error_code ec, std::size_t bytes) {
+
+            if (ec) return self->close();
+
+            self->buffer_.commit(bytes);
+            self->read_request_fast();
+
+        }
+    );
+
+}
+
+
+/**
+ * Reads the request headers with Beast's parser.
+ */
+void HttpSession::read_request_full() {
+
+    server_.full_parsed_++;
+    validator_.reset();
+    validated_ = 0;
+    parser_ = std::make_unique<http::request_parser<http::string_body>>();
+    // Beast would hold a declared length to its 1 MB default while parsing the header;
+    // the route's own limit is applied in on_header
+    parser_->body_limit(std::numeric_limits<std::uint64_t>::max());
+
+    http::async_read_header(socket_, buffer_, *parser_,
+        [self = shared_from_this()](beast::error_code ec, std::size_t) { self->on_header(ec); });
+
+}
+
+
+/**
+ * Applies the route's body limit, refusing a declared length over it without reading
+ * the body, then switches to the body deadline and reads the rest of the request.
+ */
+void HttpSession::on_header(beast::error_code ec) {
+
+    if (ec) return close();
+
+    const auto& header = parser_->get();
+    BodyRules rules = body_rules({ header.method_string().data(), header.method_string().size() }, { header.target().data(), header.target().size() });
+
+    if (parser_->content_length().value_or(0) > rules.limit) {
+        return reject(http::status::payload_too_large, body_limit_error(rules.limit), false);
+    }
+
+    body_limit_ = rules.limit;
+    parser_->body_limit(body_limit_);
+    if (rules.schema != BodySchema::none) validator_ = std::make_unique<BodyValidator>(rules.schema);
+
+    server_.deadlines_.schedule(deadline_, server_.timeouts_.body);
+    read_body();
+
+}
+
+
+/**
+ * Reads the next piece of the body, or finishes the request once the parser is done.
+ */
+void HttpSession::read_body() {
+
+    if (parser_->is_done()) return on_read({});
+
+    http::async_read_some(socket_, buffer_, *parser_,
+        [self = shared_from_this()](beast::error_code ec, std::size_t) { self->on_body(ec); });
+
+}
+
+
+/**
+ * Validates the body bytes that just arrived; an invalid or oversize body is answered
+ * right away and the rest of it is never read.
+ */
+void HttpSession::on_body(beast::error_code ec) {
+
+    if (ec == http::error::body_limit) {
+        return reject(http::status::payload_too_large, body_limit_error(body_limit_), false);
+    }
+    if (ec) return close();
+
+    if (validator_) {
+        std::string_view body = parser_->get().body();
+        bool valid = validator_->write(body.substr(validated_));
+        validated_ = body.size();
+        if (!valid) return reject(http::status::bad_request, validator_->error(), parser_->is_done());
+    }
+
+    read_body();
+
+}
+
+
+/**
+ * Takes the request out of Beast's parser once it is complete.
+ */
+void HttpSession::on_read(beast::error_code ec) {
+
+    if (ec) return close();
+
+    if (validator_ && !validator_->finish()) return reject(http::status::bad_request, validator_->error(), true);
+    validator_.reset();
+    validated_ = 0;
+
+    server_.deadlines_.cancel(deadline_);
+    req_ = parser_->release();
+    parser_.reset();
+
+    respond();
+
+}
+
+
+/**
+ * Answers req_ through the API handler, or hands an h2c upgrade to HTTP/2.
+ */
+void HttpSession::respond() {
+
+    if (Http2Session::is_upgrade_request(req_)) {
+        std::make_shared<Http2Session>(server_, std::move(socket_), std::move(buffer_))->start_upgraded(req_);
+        return;
+    }
+
+    server_.capture_request(req_);
+    request_ = api_request(req_);
+
+    answer();
+
+}
+
+
+/**
+ * Runs request_ through the API handler on the API threads. The response is written
+ * under the body deadline, so a client that stops reading is dropped as well.
+ */
+void HttpSession::answer() {
+
+    start_ = std::chrono::steady_clock::now();
+    server_.post_api_request(request_, socket_.get_executor(), [self = shared_from_this()](http::response<http::string_body>& res) {
+
+        self->res_ = std::move(res);
+        self->res_.keep_alive(self->request_.keep_alive);
+
+        self->server_.deadlines_.schedule(self->deadline_, self->server_.timeouts_.body);
+
+        http::async_write(self->socket_, self->res_,
+            [self](beast::error_code ec, std::size_t bytes) { self->on_write(ec, bytes); });
+
+    });
+
+}
+
+
+/**
+ * Answers a request whose body was refused before it reached the handler. The
+ * connection is only kept alive if the whole body was read, since otherwise the
+ * rest of it would be taken for the next request.
+ * @param status 413 or 400
+ * @param message Error for the client
+ * @param body_read Whether the body has been read to its end
+ */
+void HttpSession::reject(http::status status, const std::string& message, bool body_read) {
+
+    server_.deadlines_.cancel(deadline_);
+
+    if (parser_) {
+        req_ = parser_->release();
+        parser_.reset();
+    }
+
+    request_ = api_request(req_);
+
+    start_ = std::chrono::steady_clock::now();
+    res_ = server_.reject_body(req_.version(), status, message);
+    res_.keep_alive(body_read && req_.keep_alive());
+
+    // Only now: message may be the validator's own error
+    validator_.reset();
+    validated_ = 0;
+
+    server_.deadlines_.schedule(deadline_, server_.timeouts_.body);
+
+    http::async_write(socket_, res_,
+        [self = shared_from_this()](beast::error_code ec, std::size_t bytes) { self->on_write(ec, bytes); });
+
+}
+
+
+/**
+ * Logs the request, then waits for the next one or ends the connection.
+ */
+void HttpSession::on_write(beast::error_code ec, std::size_t bytes) {
+
+    if (ec) return close();
+
+    server_.access_log_.record(request_.method_string, request_.target, res_.result_int(),
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_), bytes, client_);
+
+    bool keep_alive = res_.keep_alive();
+    request_ = {};
+    req_ = {};
+    res_ = {};
+    buffer_.consume(consumed_);
+    consumed_ = 0;
+
+    if (!keep_alive) {
+        server_.deadlines_.cancel(deadline_);
+        socket_.shutdown(tcp::socket::shutdown_send, ec);
+        return;
+    }
+
+    wait_for_request();
+
+}
+
+
+/**
+ * Drops a connection that sat idle or sent its request too slowly.
+ * Closing the socket aborts the pending operation, whose handler releases the session.
+ */
+void HttpSession::on_deadline() {
+
+    if (idle_) server_.idle_closed_++;
+    else server_.slow_closed_++;
+
+    close();
+
+}
+
+
+/**
+ * Disarms the deadline and closes the socket.
+ */
+void HttpSession::close() {
+
+    server_.deadlines_.cancel(deadline_);
+
+    beast::error_code ec;
+    socket_.shutdown(tcp::socket::shutdown_both, ec);
+    socket_.close(ec);
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "body_validator.h"
+#include "http_server.h"
+#include "timer_wheel.h"
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+#include <chrono>
+#include <memory>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+
+class HttpServer;
+
+// One cleartext HTTP/1.1 connection with keep-alive. Reads, writes and waits are
+// asynchronous, so a slow client only holds its own connection. A single wheel timer
+// enforces the header-read, body-read and idle deadlines; an idle connection holds
+// no parser and no pending read, only a readiness wait on the socket. Connections
+// that turn out to speak HTTP/2 are handed to an Http2Session. Request bodies are
+// held to a per-route size limit and validated as they arrive.
+class HttpSession : public std::enable_shared_from_this<HttpSession> {
+public:
+
+	HttpSession(HttpServer& server, tcp::socket socket);
+
+	// Methods
+	void start();
+
+private:
+
+	void read_preface();
+	void wait_for_request();
+	void read_request();
+	void read_request_fast();
+	void read_request_full();
+	void on_header(beast::error_code ec);
+	void read_body();
+	void on_body(beast::error_code ec);
+	void on_read(beast::error_code ec);
+	void respond();
+	void answer();
+	void reject(http::status status, const std::string& message, bool body_read);
+	void on_write(beast::error_code ec, std::size_t bytes);
+	void on_deadline();
+	void close();
+
+	HttpServer& server_;
+	tcp::socket socket_;
+	beast::flat_buffer buffer_;
+	std::unique_ptr<http::request_parser<http::string_body>> parser_;	// only while a request is read
+	std::unique_ptr<BodyValidator> validator_;							// only while a JSON body is read
+	std::size_t validated_ = 0;
+	std::size_t body_limit_ = 0;
+	http::request<http::string_body> req_;	// filled by Beast, or on the fast path only for a rejected body
+	ApiRequest request_;					// views into req_, or into buffer_ on the fast path
+	std::size_t consumed_ = 0;				// bytes of buffer_ request_ points into, consumed once answered
+	http::response<http::string_body> res_;
+	tcp::endpoint client_;
+	std::chrono::steady_clock::time_point start_;
+
+	TimerWheel::Timer deadline_;
+	bool idle_ = false;
+
+};
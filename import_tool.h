@@ -0,0 +1,7 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Loads tasks from a CSV file into a task database (see import_csv).
+// Usage: import <db-path> <csv-path> [--threads 0] [--chunk-kb 1024]
+int run_import(const std::vector<std::string>& args);
\ No newline at end of file
@@ -1,22 +1,113 @@
 ﻿#include "http_server.h"
+#include "bench_tool.h"
+#include "import_tool.h"
+#include "replay_tool.h"
+#include "seed_tool.h"
 #include <iostream>
+#include <memory>
 
-int main() {
+int main(int argc, char* argv[]) {
+
+	std::vector<std::string> args(argv + 1, argv + argc);
 
 	try {
 
+		// Tools
+		if (!args.empty() && args[0] == "replay") return run_replay(args);
+		if (!args.empty() && args[0] == "seed") return run_seed(args);
+		if (!args.empty() && args[0] == "import") return run_import(args);
+		if (!args.empty() && args[0] == "bench") return run_bench(args);
+
+		// Server options
+		std::string capture_path;
+		unsigned capture_sample = 1;
+		std::string tls_cert;
+		std::string tls_key;
+		bool tls_self_signed = false;
+		unsigned short tls_port = 8443;
+		std::size_t cache_mb = 64;
+		std::size_t pin_hot = 0;
+		unsigned coalesce_us = 0;
+		ConnectionTimeouts timeouts;
+		bool lean_buffers = false;
+		bool fast_parser = false;
+		unsigned api_threads = 0;
+		unsigned scan_threads = 0;
+		bool warm_cache = false;
+
+		for (std::size_t i = 0; i < args.size(); ++i) {
+			bool has_value = i + 1 < args.size();
+
+			if (args[i] == "--capture" && has_value) capture_path = args[++i];
+			else if (args[i] == "--capture-sample" && has_value) capture_sample = static_cast<unsigned>(std::stoul(args[++i]));
+			else if (args[i] == "--tls-cert" && has_value) tls_cert = args[++i];
+			else if (args[i] == "--tls-key" && has_value) tls_key = args[++i];
+			else if (args[i] == "--tls-self-signed") tls_self_signed = true;
+			else if (args[i] == "--tls-port" && has_value) tls_port = static_cast<unsigned short>(std::stoul(args[++i]));
+			else if (args[i] == "--cache-mb" && has_value) cache_mb = std::stoul(args[++i]);
+			else if (args[i] == "--pin-hot" && has_value) pin_hot = std::stoul(args[++i]);
+			else if (args[i] == "--coalesce-us" && has_value) coalesce_us = static_cast<unsigned>(std::stoul(args[++i]));
+			else if (args[i] == "--idle-timeout-ms" && has_value) timeouts.idle = std::chrono::milliseconds(std::stoul(args[++i]));
+			else if (args[i] == "--header-timeout-ms" && has_value) timeouts.header = std::chrono::milliseconds(std::stoul(args[++i]));
+			else if (args[i] == "--body-timeout-ms" && has_value) timeouts.body = std::chrono::milliseconds(std::stoul(args[++i]));
+			else if (args[i] == "--lean-buffers") lean_buffers = true;
+			else if (args[i] == "--fast-parser") fast_parser = true;
+			else if (args[i] == "--api-threads" && has_value) api_threads = static_cast<unsigned>(std::stoul(args[++i]));
+			else if (args[i] == "--scan-threads" && has_value) scan_threads = static_cast<unsigned>(std::stoul(args[++i]));
+			else if (args[i] == "--warm-cache") warm_cache = true;
+			else throw std::invalid_argument("Unknown argument: " + args[i]);
+		}
+
 		Database db("tasks.db");
 		db.initialize();
 
-		TaskManager task_manager(db);
+		TaskManager task_manager(db, cache_mb << 20);
+		if (coalesce_us > 0) task_manager.set_write_coalescing(std::chrono::microseconds(coalesce_us));
+		task_manager.set_scan_threads(scan_threads);
+
+		// Loads in the background; requests are answered from SQLite until it is done
+		if (warm_cache) task_manager.warm_cache();
+
+		AccessLog access_log("access.log");
 
 		boost::asio::io_context io_context;
-		HttpServer server(io_context, 8081, task_manager);
+		HttpServer server(io_context, 8081, task_manager, access_log);
+		server.set_connection_timeouts(timeouts);
+		server.set_lean_buffers(lean_buffers);
+		server.set_fast_parser(fast_parser);
+		server.set_api_threads(api_threads);
+
+		if (pin_hot > 0) {
+			server.pin_hot_tasks(pin_hot, std::chrono::seconds(1));
+			std::cout << "Pinning the " << pin_hot << " hottest tasks in cache\n";
+		}
+
+		std::unique_ptr<boost::asio::ssl::context> tls_context;
+		if (!tls_cert.empty() || tls_self_signed) {
+			tls_context = std::make_unique<boost::asio::ssl::context>(tls_self_signed ? make_tls_context() : make_tls_context(tls_cert, tls_key));
+			server.listen_tls(tls_port, *tls_context);
+			std::cout << "TLS listening on https://localhost:" << server.tls_port() << "\n";
+		}
+
+		std::unique_ptr<RequestCaptureWriter> capture;
+		if (!capture_path.empty()) {
+			capture = std::make_unique<RequestCaptureWriter>(capture_path, capture_sample);
+			server.set_capture(capture.get());
+			std::cout << "Capturing 1 in " << capture_sample << " requests to " << capture_path << "\n";
+		}
 
-		std::cout << "Server running on http://localhost:8081\n";
+		std::cout << "Server running on http://localhost:8081 (HTTP/1.1, h2c)\n";
 		std::cout << "Endpoints:\n";
 		std::cout << "  GET    /tasks - List all tasks\n";
+		std::cout << "  GET    /tasks?ids=1,2,3 - Get several tasks in request order\n";
+		std::cout << "  GET    /tasks?fields=id,completed - Return only the listed fields\n";
+		std::cout << "  GET    /tasks/export?format=arrow - All tasks as an Arrow IPC stream (or format=json)\n";
 		std::cout << "  POST   /tasks - Create new task\n";
+		std::cout << "  POST   /tasks/import?format=csv - Add the tasks of a CSV body in one transaction\n";
+		std::cout << "  PATCH  /tasks/{id} - Change only the given fields\n";
+		std::cout << "  POST   /batch - Create, update and delete tasks in one transaction\n";
+		std::cout << "  GET    /metrics - Access log, cache and SQL statement statistics\n";
+		std::cout << "  GET    /admin/hot - Hottest task ids and routes\n";
 
 		io_context.run();
 
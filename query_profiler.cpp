@@ -0,0 +1,160 @@
+#include "query_profiler.h"
+#include <algorithm>
+#include <bit>
+
+
+/**
+ * Records one execution of a statement.
+ * @param sql Statement text as prepared (parameters unexpanded)
+ * @param duration_ns Wall time of the execution in nanoseconds
+ * @param fullscan_rows Rows stepped through in full table scans
+ * @param vm_steps Virtual machine operations executed
+ */
+void QueryProfiler::record(std::string_view sql, std::uint64_t duration_ns, std::uint64_t fullscan_rows, std::uint64_t vm_steps) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = entry_for(sql);
+
+    entry.count++;
+    entry.total_ns += duration_ns;
+    entry.max_ns = std::max(entry.max_ns, duration_ns);
+    entry.fullscan_rows += fullscan_rows;
+    entry.vm_steps += vm_steps;
+    entry.histogram[bucket_of(duration_ns)]++;
+
+}
+
+
+/**
+ * Checks whether the query plan of a statement was already captured.
+ * @param sql Statement text
+ * @return bool True if a plan is known
+ */
+bool QueryProfiler::has_plan(std::string_view sql) const {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(sql);
+    return it != entries_.end() && it->second.has_plan;
+
+}
+
+
+/**
+ * Stores the EXPLAIN QUERY PLAN output of a statement.
+ * The statement is flagged as a full scan if any plan step scans a table.
+ * @param sql Statement text
+ * @param plan Plan detail rows
+ */
+void QueryProfiler::set_plan(std::string_view sql, std::vector<std::string> plan) {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = entry_for(sql);
+
+    entry.full_scan = std::any_of(plan.begin(), plan.end(),
+        [](const std::string& step) { return step.rfind("SCAN", 0) == 0; });
+    entry.plan = std::move(plan);
+    entry.has_plan = true;
+
+}
+
+
+/**
+ * Returns the aggregated profile of every statement seen so far.
+ * @return std::vector<StatementProfile> Profiles sorted by total time, slowest first
+ */
+std::vector<StatementProfile> QueryProfiler::snapshot() const {
+
+    std::vector<StatementProfile> profiles;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        profiles.reserve(entries_.size());
+
+        for (const auto& [sql, entry] : entries_) {
+            profiles.push_back({
+                sql,
+                entry.count,
+                entry.total_ns,
+                percentile(entry, 0.50),
+                percentile(entry, 0.90),
+                percentile(entry, 0.99),
+                entry.max_ns,
+                entry.fullscan_rows,
+                entry.vm_steps,
+                entry.plan,
+                entry.full_scan
+            });
+        }
+    }
+
+    std::sort(profiles.begin(), profiles.end(),
+        [](const StatementProfile& a, const StatementProfile& b) { return a.total_ns > b.total_ns; });
+
+    return profiles;
+
+}
+
+
+/**
+ * Maps a duration to its histogram bucket.
+ * Values below 2^sub_bucket_bits get an exact bucket, larger ones keep 3 significant bits.
+ */
+int QueryProfiler::bucket_of(std::uint64_t ns) {
+
+    if (ns < (1u << sub_bucket_bits)) return static_cast<int>(ns);
+
+    int exponent = std::bit_width(ns) - 1 - sub_bucket_bits;
+    int mantissa = static_cast<int>(ns >> exponent) & ((1 << sub_bucket_bits) - 1);
+    return ((exponent + 1) << sub_bucket_bits) + mantissa;
+
+}
+
+
+/**
+ * Returns the largest duration that falls into a bucket.
+ */
+std::uint64_t QueryProfiler::bucket_upper_bound(int bucket) {
+
+    if (bucket < (1 << sub_bucket_bits)) return static_cast<std::uint64_t>(bucket);
+
+    int exponent = (bucket >> sub_bucket_bits) - 1;
+    std::uint64_t mantissa = (1u << sub_bucket_bits) | (bucket & ((1 << sub_bucket_bits) - 1));
+    return ((mantissa + 1) << exponent) - 1;
+
+}
+
+
+/**
+ * Estimates a latency percentile from the histogram.
+ * @param entry Statement entry
+ * @param fraction Percentile as a fraction (0.99 for p99)
+ * @return std::uint64_t Upper bound of the bucket holding the percentile, capped at the observed maximum
+ */
+std::uint64_t QueryProfiler::percentile(const Entry& entry, double fraction) {
+
+    if (entry.count == 0) return 0;
+
+    std::uint64_t rank = static_cast<std::uint64_t>(fraction * entry.count);
+    if (rank >= entry.count) rank = entry.count - 1;
+
+    std::uint64_t seen = 0;
+    for (int bucket = 0; bucket < bucket_count; ++bucket) {
+        seen += entry.histogram[bucket];
+        if (seen > rank) return std::min(bucket_upper_bound(bucket), entry.max_ns);
+    }
+
+    return entry.max_ns;
+
+}
+
+
+/**
+ * Finds or creates the entry of a statement. Caller holds the mutex.
+ */
+QueryProfiler::Entry& QueryProfiler::entry_for(std::string_view sql) {
+
+    auto it = entries_.find(sql);
+    if (it == entries_.end()) it = entries_.emplace(std::string(sql), Entry{}).first;
+    return it->second;
+
+}
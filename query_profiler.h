@@ -0,0 +1,71 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Aggregated timings of one distinct SQL statement
+struct StatementProfile {
+
+	std::string sql;
+	std::uint64_t count;
+	std::uint64_t total_ns;
+	std::uint64_t p50_ns;
+	std::uint64_t p90_ns;
+	std::uint64_t p99_ns;
+	std::uint64_t max_ns;
+	std::uint64_t fullscan_rows;
+	std::uint64_t vm_steps;
+	std::vector<std::string> plan;
+	bool full_scan;
+
+};
+
+
+class QueryProfiler {
+public:
+
+	// Methods
+	void record(std::string_view sql, std::uint64_t duration_ns, std::uint64_t fullscan_rows, std::uint64_t vm_steps);
+	bool has_plan(std::string_view sql) const;
+	void set_plan(std::string_view sql, std::vector<std::string> plan);
+	std::vector<StatementProfile> snapshot() const;
+
+private:
+
+	// Log-linear latency histogram: 8 sub-buckets per power of two
+	static constexpr int sub_bucket_bits = 3;
+	static constexpr int bucket_count = 64 << sub_bucket_bits;
+
+	struct Entry {
+
+		std::uint64_t count = 0;
+		std::uint64_t total_ns = 0;
+		std::uint64_t max_ns = 0;
+		std::uint64_t fullscan_rows = 0;
+		std::uint64_t vm_steps = 0;
+		std::array<std::uint32_t, bucket_count> histogram{};
+		std::vector<std::string> plan;
+		bool has_plan = false;
+		bool full_scan = false;
+
+	};
+
+	struct StringHash {
+		using is_transparent = void;
+		std::size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+	};
+
+	static int bucket_of(std::uint64_t ns);
+	static std::uint64_t bucket_upper_bound(int bucket);
+	static std::uint64_t percentile(const Entry& entry, double fraction);
+
+	Entry& entry_for(std::string_view sql);
+
+	mutable std::mutex mutex_;
+	std::unordered_map<std::string, Entry, StringHash, std::equal_to<>> entries_;
+
+};
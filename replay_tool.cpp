@@ -0,0 +1,181 @@
+#include "replay_tool.h"
+#include "request_capture.h"
+#include <boost/asio.hpp>
+#include <boost/beast.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+
+namespace {
+
+    struct ReplayOptions {
+        std::string capture_path;
+        std::string host = "127.0.0.1";
+        std::string port = "8081";
+        double speed = 1.0;
+        unsigned workers = 64;
+    };
+
+    struct WorkerResult {
+        std::vector<std::uint64_t> latencies_us;
+        std::vector<std::uint64_t> lag_us;
+        std::uint64_t errors = 0;
+    };
+
+    ReplayOptions parse_options(const std::vector<std::string>& args) {
+
+        ReplayOptions options;
+
+        for (std::size_t i = 1; i < args.size(); ++i) {
+            const std::string& arg = args[i];
+            bool has_value = i + 1 < args.size();
+
+            if (arg == "--host" && has_value) options.host = args[++i];
+            else if (arg == "--port" && has_value) options.port = args[++i];
+            else if (arg == "--speed" && has_value) options.speed = std::stod(args[++i]);
+            else if (arg == "--workers" && has_value) options.workers = static_cast<unsigned>(std::stoul(args[++i]));
+            else if (options.capture_path.empty()) options.capture_path = arg;
+            else throw std::invalid_argument("Unknown replay argument: " + arg);
+        }
+
+        if (options.capture_path.empty()) throw std::invalid_argument("Usage: replay <capture-file> [--host h] [--port p] [--speed x] [--workers n]");
+        if (options.workers == 0) options.workers = 1;
+
+        return options;
+
+    }
+
+    std::uint64_t percentile(const std::vector<std::uint64_t>& sorted, double fraction) {
+
+        if (sorted.empty()) return 0;
+        std::size_t rank = static_cast<std::size_t>(fraction * (sorted.size() - 1));
+        return sorted[rank];
+
+    }
+
+    void send_request(asio::io_context& io_context, const tcp::resolver::results_type& endpoints, const CapturedRequest& captured) {
+
+        beast::tcp_stream stream(io_context);
+        stream.connect(endpoints);
+
+        http::request<http::string_body> req;
+        req.method_string(captured.method);
+        req.target(captured.target);
+        req.version(11);
+        for (const auto& [name, value] : captured.headers) req.set(name, value);
+        req.body() = captured.body;
+        req.prepare_payload();
+
+        http::write(stream, req);
+
+        beast::flat_buffer buffer;
+        http::response<http::string_body> res;
+        http::read(stream, buffer, res);
+
+        beast::error_code ec;
+        stream.socket().shutdown(tcp::socket::shutdown_both, ec);
+
+    }
+
+}
+
+
+/**
+ * Replays a capture file against a server.
+ * Each request is issued at its captured offset divided by the speed factor
+ * (speed 0 sends as fast as the workers allow), so the original load shape is kept.
+ * Latency is measured from send to full response; lag is how late a request started
+ * relative to its schedule, which shows when the worker pool is too small.
+ * @param args Command line arguments, args[0] being "replay"
+ * @return int Process exit code
+ */
+int run_replay(const std::vector<std::string>& args) {
+
+    ReplayOptions options = parse_options(args);
+
+    std::vector<CapturedRequest> requests;
+    {
+        RequestCaptureReader reader(options.capture_path);
+        CapturedRequest request;
+        while (reader.next(request)) requests.push_back(request);
+    }
+
+    std::cout << "Replaying " << requests.size() << " requests against " << options.host << ":" << options.port
+        << " at speed " << options.speed << " with " << options.workers << " workers\n";
+
+    asio::io_context io_context;
+    auto endpoints = tcp::resolver(io_context).resolve(options.host, options.port);
+
+    std::atomic<std::size_t> next{ 0 };
+    std::vector<WorkerResult> results(options.workers);
+    std::vector<std::thread> workers;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned w = 0; w < options.workers; ++w) {
+
+        workers.emplace_back([&, w] {
+
+            asio::io_context worker_context;
+            WorkerResult& result = results[w];
+
+            for (std::size_t i = next++; i < requests.size(); i = next++) {
+
+                const CapturedRequest& request = requests[i];
+                auto scheduled = start;
+                if (options.speed > 0) {
+                    scheduled += std::chrono::microseconds(static_cast<std::uint64_t>(request.offset_us / options.speed));
+                    std::this_thread::sleep_until(scheduled);
+                }
+
+                auto sent = std::chrono::steady_clock::now();
+
+                try {
+                    send_request(worker_context, endpoints, request);
+                }
+                catch (const std::exception&) {
+                    result.errors++;
+                    continue;
+                }
+
+                auto done = std::chrono::steady_clock::now();
+                result.latencies_us.push_back(std::chrono::duration_cast<std::chrono::microseconds>(done - sent).count());
+                result.lag_us.push_back(options.speed > 0 ? std::chrono::duration_cast<std::chrono::microseconds>(sent - scheduled).count() : 0);
+
+            }
+
+        });
+
+    }
+
+    for (auto& worker : workers) worker.join();
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<std::uint64_t> latencies;
+    std::vector<std::uint64_t> lags;
+    std::uint64_t errors = 0;
+    for (const auto& result : results) {
+        latencies.insert(latencies.end(), result.latencies_us.begin(), result.latencies_us.end());
+        lags.insert(lags.end(), result.lag_us.begin(), result.lag_us.end());
+        errors += result.errors;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    std::sort(lags.begin(), lags.end());
+
+    std::cout << "Completed:   " << latencies.size() << " ok, " << errors << " errors in " << elapsed << " s\n";
+    std::cout << "Throughput:  " << (elapsed > 0 ? latencies.size() / elapsed : 0) << " req/s\n";
+    std::cout << "Latency us:  p50 " << percentile(latencies, 0.50) << "  p90 " << percentile(latencies, 0.90)
+        << "  p99 " << percentile(latencies, 0.99) << "  max " << (latencies.empty() ? 0 : latencies.back()) << "\n";
+    std::cout << "Lag us:      p50 " << percentile(lags, 0.50) << "  p99 " << percentile(lags, 0.99) << "\n";
+
+    return errors == 0 ? 0 : 1;
+
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Replays a request capture against a running server and reports latency.
+// Usage: replay <capture-file> [--host 127.0.0.1] [--port 8081] [--speed 1.0] [--workers 64]
+int run_replay(const std::vector<std::string>& args);
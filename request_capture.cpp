@@ -0,0 +1,249 @@
+#include "request_capture.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+
+    // File layout: magic, then records of
+    // varint(offset delta us) str(method) str(target) varint(header count) {str(name) str(value)}* str(body)
+    // where str() is varint(length) followed by the bytes.
+    constexpr char capture_magic[8] = { 'A', 'R', 'S', 'C', 'A', 'P', '0', '1' };
+
+    // How often the writer thread flushes buffered records
+    constexpr auto flush_interval = std::chrono::milliseconds(100);
+
+    // Records arriving while this much is still unwritten are dropped
+    constexpr std::size_t max_pending_bytes = 16 * 1024 * 1024;
+
+    void put_varint(std::string& out, std::uint64_t value) {
+
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+
+    }
+
+    void put_string(std::string& out, std::string_view value) {
+
+        put_varint(out, value.size());
+        out.append(value.data(), value.size());
+
+    }
+
+    bool get_varint(std::istream& in, std::uint64_t& value) {
+
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            int byte = in.get();
+            if (byte == EOF) return false;
+            value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return true;
+        }
+        throw std::runtime_error("Corrupt capture file: varint too long");
+
+    }
+
+    void get_string(std::istream& in, std::string& value) {
+
+        std::uint64_t size;
+        if (!get_varint(in, size)) throw std::runtime_error("Corrupt capture file: truncated record");
+
+        value.resize(size);
+        if (size && !in.read(value.data(), static_cast<std::streamsize>(size))) throw std::runtime_error("Corrupt capture file: truncated record");
+
+    }
+
+}
+
+
+/**
+ * RequestCaptureWriter class constructor.
+ * Creates the capture file, writes its header and starts the writer thread.
+ * @param path Path of the capture file (overwritten)
+ * @param sample_every Capture one request out of this many
+ * @throws std::runtime_error If the file cannot be created
+ */
+RequestCaptureWriter::RequestCaptureWriter(const std::string& path, unsigned sample_every)
+    : out_(path, std::ios::binary | std::ios::trunc),
+      sample_every_(sample_every ? sample_every : 1),
+      start_(std::chrono::steady_clock::now()) {
+
+    if (!out_) throw std::runtime_error("Failed to create capture file: " + path);
+
+    out_.write(capture_magic, sizeof(capture_magic));
+    writer_ = std::thread([this] { writer_loop(); });
+
+}
+
+
+/**
+ * RequestCaptureWriter class destructor.
+ * Stops the writer thread after it has written the remaining records.
+ */
+RequestCaptureWriter::~RequestCaptureWriter() {
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    writer_.join();
+
+}
+
+
+/**
+ * Decides whether the current request should be captured.
+ * Lock-free; called for every request before any copying is done.
+ * @return bool True if the request falls on the sampling interval
+ */
+bool RequestCaptureWriter::should_sample() {
+
+    return seen_.fetch_add(1, std::memory_order_relaxed) % sample_every_ == 0;
+
+}
+
+
+/**
+ * Queues a request for the capture file.
+ * The record is encoded before the lock is taken; under it only the arrival offset is
+ * taken and the bytes are appended. When the writer has fallen behind by more than
+ * max_pending_bytes the request is dropped and counted instead.
+ * @param request Request to store; offset_us is ignored, the arrival time is now
+ */
+void RequestCaptureWriter::write(const CapturedRequest& request) {
+
+    std::string record;
+    record.reserve(64 + request.target.size() + request.body.size());
+
+    put_string(record, request.method);
+    put_string(record, request.target);
+    put_varint(record, request.headers.size());
+    for (const auto& [name, value] : request.headers) {
+        put_string(record, name);
+        put_string(record, value);
+    }
+    put_string(record, request.body);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (pending_.size() + record.size() > max_pending_bytes) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    std::uint64_t offset_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_).count();
+
+    put_varint(pending_, offset_us - last_offset_us_);
+    pending_ += record;
+    pending_count_++;
+    last_offset_us_ = offset_us;
+
+}
+
+
+/**
+ * Returns the number of requests written so far.
+ */
+std::uint64_t RequestCaptureWriter::captured() const {
+
+    return captured_.load(std::memory_order_relaxed);
+
+}
+
+
+/**
+ * Returns the number of sampled requests dropped because the writer fell behind.
+ */
+std::uint64_t RequestCaptureWriter::dropped() const {
+
+    return dropped_.load(std::memory_order_relaxed);
+
+}
+
+
+/**
+ * Writer thread: every flush_interval takes the buffered records and writes them out.
+ */
+void RequestCaptureWriter::writer_loop() {
+
+    std::string batch;
+
+    for (;;) {
+
+        bool stopping;
+        std::uint64_t count;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait_for(lock, flush_interval, [this] { return stopping_; });
+            stopping = stopping_;
+            batch.clear();
+            batch.swap(pending_);
+            count = pending_count_;
+            pending_count_ = 0;
+        }
+
+        if (!batch.empty()) {
+            out_.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+            out_.flush();
+            captured_.fetch_add(count, std::memory_order_relaxed);
+        }
+
+        if (stopping) break;
+
+    }
+
+}
+
+
+/**
+ * RequestCaptureReader class constructor.
+ * Opens a capture file and validates its header.
+ * @param path Path of the capture file
+ * @throws std::runtime_error If the file cannot be opened or is not a capture file
+ */
+RequestCaptureReader::RequestCaptureReader(const std::string& path) : in_(path, std::ios::binary) {
+
+    if (!in_) throw std::runtime_error("Failed to open capture file: " + path);
+
+    char magic[sizeof(capture_magic)];
+    if (!in_.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), capture_magic)) {
+        throw std::runtime_error("Not a capture file: " + path);
+    }
+
+}
+
+
+/**
+ * Reads the next captured request.
+ * @param request Receives the request; offset_us is absolute from capture start
+ * @return bool False at end of file
+ * @throws std::runtime_error If the file is truncated or corrupt
+ */
+bool RequestCaptureReader::next(CapturedRequest& request) {
+
+    std::uint64_t delta;
+    if (!get_varint(in_, delta)) return false;
+
+    offset_us_ += delta;
+    request.offset_us = offset_us_;
+
+    get_string(in_, request.method);
+    get_string(in_, request.target);
+
+    std::uint64_t header_count;
+    if (!get_varint(in_, header_count)) throw std::runtime_error("Corrupt capture file: truncated record");
+
+    request.headers.resize(header_count);
+    for (auto& [name, value] : request.headers) {
+        get_string(in_, name);
+        get_string(in_, value);
+    }
+
+    get_string(in_, request.body);
+    return true;
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Request as stored in a capture file
+struct CapturedRequest {
+
+	std::uint64_t offset_us;
+	std::string method;
+	std::string target;
+	std::vector<std::pair<std::string, std::string>> headers;
+	std::string body;
+
+};
+
+
+// Writes sampled requests to a compact binary capture file. The request path only encodes
+// the record into a buffer; a background thread writes and flushes it, like AccessLog.
+class RequestCaptureWriter {
+public:
+
+	// Constructor (records every sample_every-th request)
+	RequestCaptureWriter(const std::string& path, unsigned sample_every = 1);
+
+	// Destructor (writes what is still buffered)
+	~RequestCaptureWriter();
+
+	RequestCaptureWriter(const RequestCaptureWriter&) = delete;
+	RequestCaptureWriter& operator=(const RequestCaptureWriter&) = delete;
+
+	// Methods
+	bool should_sample();
+	void write(const CapturedRequest& request);
+	std::uint64_t captured() const;
+	std::uint64_t dropped() const;
+
+private:
+
+	void writer_loop();
+
+	std::ofstream out_;
+	unsigned sample_every_;
+	std::chrono::steady_clock::time_point start_;
+	std::atomic<std::uint64_t> seen_{ 0 };
+	std::atomic<std::uint64_t> captured_{ 0 };
+	std::atomic<std::uint64_t> dropped_{ 0 };
+
+	// Records waiting for the writer; offsets are deltas from the last record buffered
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::string pending_;
+	std::uint64_t pending_count_ = 0;
+	std::uint64_t last_offset_us_ = 0;
+	bool stopping_ = false;
+	std::thread writer_;
+
+};
+
+
+// Reads requests back from a capture file
+class RequestCaptureReader {
+public:
+
+	// Constructor
+	explicit RequestCaptureReader(const std::string& path);
+
+	// Methods
+	bool next(CapturedRequest& request);
+
+private:
+
+	std::ifstream in_;
+	std::uint64_t offset_us_ = 0;
+
+};
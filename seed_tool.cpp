@@ -0,0 +1,199 @@
+#include "seed_tool.h"
+#include "database.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+    struct LengthRange {
+        std::size_t min;
+        std::size_t max;
+    };
+
+    struct SeedOptions {
+        std::string db_path;
+        std::uint64_t rows = 1000000;
+        LengthRange title_len{ 5, 60 };
+        LengthRange desc_len{ 0, 200 };
+        double completed_ratio = 0.3;
+        double unicode_ratio = 0.1;
+        std::size_t batch = 100000;
+        std::uint64_t seed = 42;
+    };
+
+    // Titles are limited to 100 bytes by TaskManager
+    constexpr std::size_t max_title_bytes = 100;
+
+    // Size of the pre-generated text that fields are sliced from
+    constexpr std::size_t text_pool_bytes = 4 * 1024 * 1024;
+
+    // Multi-byte characters mixed into the text: Cyrillic, Greek, CJK and emoji
+    const char* const unicode_chars[] = {
+        "\xD0\xB7", "\xD0\xB0", "\xD0\xB4", "\xD0\xB0\xD1\x87", "\xCE\xB1", "\xCE\xB2", "\xCE\xBB",
+        "\xE4\xBB\xBB", "\xE5\x8A\xA1", "\xE5\xAE\x8C", "\xE6\x88\x90",
+        "\xF0\x9F\x93\x8C", "\xF0\x9F\x9A\x80", "\xE2\x9C\x85"
+    };
+
+    LengthRange parse_range(const std::string& value) {
+
+        auto colon = value.find(':');
+        if (colon == std::string::npos) {
+            std::size_t n = std::stoul(value);
+            return { n, n };
+        }
+
+        LengthRange range{ std::stoul(value.substr(0, colon)), std::stoul(value.substr(colon + 1)) };
+        if (range.min > range.max) throw std::invalid_argument("Invalid length range: " + value);
+        return range;
+
+    }
+
+    SeedOptions parse_options(const std::vector<std::string>& args) {
+
+        SeedOptions options;
+
+        for (std::size_t i = 1; i < args.size(); ++i) {
+            const std::string& arg = args[i];
+            bool has_value = i + 1 < args.size();
+
+            if (arg == "--rows" && has_value) options.rows = std::stoull(args[++i]);
+            else if (arg == "--title-len" && has_value) options.title_len = parse_range(args[++i]);
+            else if (arg == "--desc-len" && has_value) options.desc_len = parse_range(args[++i]);
+            else if (arg == "--completed" && has_value) options.completed_ratio = std::stod(args[++i]);
+            else if (arg == "--unicode" && has_value) options.unicode_ratio = std::stod(args[++i]);
+            else if (arg == "--batch" && has_value) options.batch = std::max<std::size_t>(1, std::stoul(args[++i]));
+            else if (arg == "--seed" && has_value) options.seed = std::stoull(args[++i]);
+            else if (options.db_path.empty()) options.db_path = arg;
+            else throw std::invalid_argument("Unknown seed argument: " + arg);
+        }
+
+        if (options.db_path.empty()) throw std::invalid_argument("Usage: seed <db-path> [--rows n] [--title-len a:b] [--desc-len a:b] [--completed r] [--unicode r] [--batch n] [--seed s]");
+        options.title_len.max = std::min(options.title_len.max, max_title_bytes);
+        options.title_len.min = std::max<std::size_t>(1, std::min(options.title_len.min, options.title_len.max));
+
+        return options;
+
+    }
+
+    // Builds a block of words with the requested share of multi-byte characters
+    std::string build_text_pool(std::mt19937_64& rng, double unicode_ratio) {
+
+        std::string pool;
+        pool.reserve(text_pool_bytes + 16);
+
+        std::uniform_int_distribution<int> word_len(2, 10);
+        std::uniform_int_distribution<int> letter('a', 'z');
+        std::uniform_int_distribution<std::size_t> unicode_pick(0, std::size(unicode_chars) - 1);
+        std::bernoulli_distribution use_unicode(std::clamp(unicode_ratio, 0.0, 1.0));
+
+        while (pool.size() < text_pool_bytes) {
+            for (int n = word_len(rng); n > 0; --n) {
+                if (use_unicode(rng)) pool += unicode_chars[unicode_pick(rng)];
+                else pool += static_cast<char>(letter(rng));
+            }
+            pool += ' ';
+        }
+
+        return pool;
+
+    }
+
+    bool is_continuation(char c) {
+
+        return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+
+    }
+
+    // Copies a random slice of the pool, trimmed to whole UTF-8 characters
+    void slice(std::string& out, const std::string& pool, std::size_t length, std::mt19937_64& rng) {
+
+        if (length == 0) {
+            out.clear();
+            return;
+        }
+
+        std::size_t begin = std::uniform_int_distribution<std::size_t>(0, pool.size() - length - 1)(rng);
+        std::size_t end = begin + length;
+
+        while (begin < end && is_continuation(pool[begin])) ++begin;
+        while (end > begin && is_continuation(pool[end])) --end;
+        while (begin < end && pool[begin] == ' ') ++begin;
+
+        out.assign(pool, begin, end - begin);
+        if (out.empty()) out = "task";
+
+    }
+
+}
+
+
+/**
+ * Seeds a database with synthetic tasks.
+ * Text is sliced from a pre-generated pool so generation stays far cheaper than
+ * the inserts, and rows are written through Database::add_tasks inside a single
+ * transaction with durability relaxed and statement profiling off.
+ * @param args Command line arguments, args[0] being "seed"
+ * @return int Process exit code
+ */
+int run_seed(const std::vector<std::string>& args) {
+
+    SeedOptions options = parse_options(args);
+    std::mt19937_64 rng(options.seed);
+
+    auto start = std::chrono::steady_clock::now();
+    std::string pool = build_text_pool(rng, options.unicode_ratio);
+
+    Database db(options.db_path);
+    db.set_profiling(false);
+    db.configure_bulk_load();
+    db.initialize();
+
+    std::uniform_int_distribution<std::size_t> title_len(options.title_len.min, options.title_len.max);
+    std::uniform_int_distribution<std::size_t> desc_len(options.desc_len.min, std::min(options.desc_len.max, pool.size() / 2));
+    std::bernoulli_distribution completed(std::clamp(options.completed_ratio, 0.0, 1.0));
+
+    std::vector<Task> batch(std::min<std::uint64_t>(options.batch, options.rows));
+    std::uint64_t written = 0;
+
+    db.begin_transaction();
+
+    try {
+
+        while (written < options.rows) {
+
+            batch.resize(static_cast<std::size_t>(std::min<std::uint64_t>(batch.size(), options.rows - written)));
+
+            for (auto& task : batch) {
+                slice(task.title, pool, title_len(rng), rng);
+                slice(task.description, pool, desc_len(rng), rng);
+                task.completed = completed(rng);
+            }
+
+            db.add_tasks(batch);
+            written += batch.size();
+
+            if (written % (options.batch * 10) == 0 || written == options.rows) {
+                double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                std::cout << "  " << written << " rows, " << static_cast<std::uint64_t>(written / elapsed) << " rows/s\n";
+            }
+
+        }
+
+        db.commit_transaction();
+
+    }
+    catch (...) {
+        db.rollback_transaction();
+        throw;
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Seeded " << written << " tasks into " << options.db_path << " in " << elapsed << " s ("
+        << static_cast<std::uint64_t>(written / elapsed) << " rows/s)\n";
+
+    return 0;
+
+}
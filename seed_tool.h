@@ -0,0 +1,8 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Generates a synthetic task database.
+// Usage: seed <db-path> [--rows 1000000] [--title-len 5:60] [--desc-len 0:200]
+//             [--completed 0.3] [--unicode 0.1] [--batch 100000] [--seed 42]
+int run_seed(const std::vector<std::string>& args);
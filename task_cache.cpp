@@ -0,0 +1,443 @@
+#include "task_cache.h"
+#include <algorithm>
+#include <bit>
+
+namespace {
+
+    // Approximate heap cost of a cached task beyond its strings: list node, hash node, bucket
+    constexpr std::size_t entry_overhead = 96;
+
+    // Rough size of a typical task, used only to size the frequency sketch
+    constexpr std::size_t expected_entry_size = 256;
+
+    std::size_t entry_size(const Task& task) {
+
+        std::size_t size = sizeof(Task) + entry_overhead;
+        for_each_column([&](const auto& column) {
+            if constexpr (std::decay_t<decltype(column)>::kind == ColumnKind::text) size += (task.*column.member).capacity();
+        });
+        return size;
+
+    }
+
+    // Murmur3 finalizer
+    std::uint32_t mix(std::uint32_t x) {
+
+        x ^= x >> 16;
+        x *= 0x85ebca6bu;
+        x ^= x >> 13;
+        x *= 0xc2b2ae35u;
+        x ^= x >> 16;
+        return x;
+
+    }
+
+}
+
+
+/**
+ * TaskCache constructor.
+ * The budget is split evenly across stripes. Within a stripe W-TinyLFU gives 1% to
+ * the admission window and the rest to the main cache, 80% of which is protected.
+ * @param budget_bytes Approximate memory the cache may hold, including per-entry overhead
+ * @param policy Eviction policy
+ * @param stripes Number of independently locked partitions
+ */
+TaskCache::TaskCache(std::size_t budget_bytes, Policy policy, unsigned stripes)
+    : policy_(policy), budget_bytes_(budget_bytes) {
+
+    stripes = std::max(1u, stripes);
+    std::size_t stripe_budget = budget_bytes / stripes;
+
+    if (policy_ == Policy::lru) {
+        window_budget_ = stripe_budget;
+        main_budget_ = 0;
+    }
+    else {
+        window_budget_ = stripe_budget / 100;
+        main_budget_ = stripe_budget - window_budget_;
+    }
+    protected_budget_ = main_budget_ / 5 * 4;
+
+    for (unsigned i = 0; i < stripes; ++i) stripes_.push_back(std::make_unique<Stripe>(stripe_budget / expected_entry_size));
+
+}
+
+
+/**
+ * Looks up a task and records the access for admission decisions.
+ * @param id Task ID
+ * @return std::optional<Task> Copy of the cached task, or nullopt on a miss
+ */
+std::optional<Task> TaskCache::get(int id) {
+
+    Stripe& stripe = stripe_for(id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+
+    if (policy_ == Policy::tiny_lfu) stripe.sketch.increment(id);
+
+    auto it = stripe.index.find(id);
+    if (it == stripe.index.end()) {
+        stripe.misses++;
+        return std::nullopt;
+    }
+
+    stripe.hits++;
+    auto entry = it->second;
+
+    // A second hit while on probation promotes to protected; protected overflow is demoted back
+    if (entry->segment == probation) {
+        move_to(stripe, entry, protected_main);
+        while (stripe.bytes[protected_main] > protected_budget_) move_to(stripe, std::prev(stripe.segments[protected_main].end()), probation);
+    }
+    else {
+        move_to(stripe, entry, entry->segment);
+    }
+
+    return entry->task;
+
+}
+
+
+/**
+ * Inserts or replaces a task loaded from storage.
+ * The insert is dropped if the task was invalidated since the epoch was taken, so a
+ * load racing with a write can never cache the pre-write row. Invalidations are tracked
+ * per slot of invalidation_slots, so a write to one task only voids loads of the few
+ * tasks sharing its slot, not a whole warm-up.
+ * @param task Complete task row
+ * @param epoch Value of epoch() taken before the task was read from storage
+ */
+void TaskCache::put(const Task& task, std::uint64_t epoch) {
+
+    std::size_t size = entry_size(task);
+    if (size > window_budget_ + main_budget_) return;
+
+    Stripe& stripe = stripe_for(task.id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+
+    if (stripe.cleared > epoch || stripe.invalidated[slot_for(task.id)] > epoch) return;
+
+    auto it = stripe.index.find(task.id);
+    if (it != stripe.index.end()) {
+        auto entry = it->second;
+        stripe.bytes[entry->segment] += size - entry->size;
+        entry->task = task;
+        entry->size = size;
+        move_to(stripe, entry, entry->segment);
+    }
+    else {
+        auto& list = stripe.segments[window];
+        list.push_front({ task, size, window, stripe.pinned.contains(task.id) });
+        stripe.bytes[window] += size;
+        stripe.index.emplace(task.id, list.begin());
+    }
+
+    enforce_budget(stripe);
+
+}
+
+
+/**
+ * Drops a task after it was changed or deleted in storage.
+ * @param id Task ID
+ */
+void TaskCache::erase(int id) {
+
+    Stripe& stripe = stripe_for(id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+
+    stripe.invalidated[slot_for(id)] = epoch_.fetch_add(1, std::memory_order_acq_rel) + 1;
+
+    auto it = stripe.index.find(id);
+    if (it != stripe.index.end()) remove(stripe, it->second);
+
+}
+
+
+/**
+ * Drops every cached task.
+ */
+void TaskCache::clear() {
+
+    std::uint64_t epoch = epoch_.fetch_add(1, std::memory_order_acq_rel) + 1;
+
+    for (auto& stripe : stripes_) {
+        std::lock_guard<std::mutex> lock(stripe->mutex);
+        stripe->cleared = epoch;
+        for (auto& list : stripe->segments) list.clear();
+        stripe->bytes.fill(0);
+        stripe->index.clear();
+    }
+
+}
+
+
+/**
+ * Checks whether a task is cached without counting an access.
+ * @param id Task ID
+ * @return bool True if the task is cached
+ */
+bool TaskCache::contains(int id) const {
+
+    Stripe& stripe = stripe_for(id);
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    return stripe.index.contains(id);
+
+}
+
+
+/**
+ * Replaces the set of pinned task ids.
+ * Entries already cached are pinned immediately; others are pinned when they are put.
+ * @param ids Task IDs to pin
+ */
+void TaskCache::set_pinned(std::span<const int> ids) {
+
+    for (auto& stripe : stripes_) {
+
+        std::lock_guard<std::mutex> lock(stripe->mutex);
+
+        for (int id : stripe->pinned) {
+            auto it = stripe->index.find(id);
+            if (it != stripe->index.end()) it->second->pinned = false;
+        }
+        stripe->pinned.clear();
+
+        for (int id : ids) {
+            if (&stripe_for(id) != stripe.get()) continue;
+            stripe->pinned.insert(id);
+            auto it = stripe->index.find(id);
+            if (it != stripe->index.end()) it->second->pinned = true;
+        }
+
+    }
+
+}
+
+
+/**
+ * Sums the counters of all stripes.
+ * @return TaskCacheStats Cache statistics
+ */
+TaskCacheStats TaskCache::stats() const {
+
+    TaskCacheStats stats;
+    stats.budget_bytes = budget_bytes_;
+
+    for (const auto& stripe : stripes_) {
+        std::lock_guard<std::mutex> lock(stripe->mutex);
+        stats.hits += stripe->hits;
+        stats.misses += stripe->misses;
+        stats.evictions += stripe->evictions;
+        stats.rejections += stripe->rejections;
+        stats.entries += stripe->index.size();
+        for (int id : stripe->pinned) stats.pinned += stripe->index.contains(id);
+        for (std::size_t bytes : stripe->bytes) stats.bytes += bytes;
+    }
+
+    return stats;
+
+}
+
+
+/**
+ * Returns the invalidation counter, to be passed to put().
+ * @return std::uint64_t Current epoch
+ */
+std::uint64_t TaskCache::epoch() const {
+
+    return epoch_.load(std::memory_order_acquire);
+
+}
+
+
+/**
+ * Picks the stripe owning a task id.
+ * @param id Task ID
+ * @return Stripe& Owning stripe
+ */
+TaskCache::Stripe& TaskCache::stripe_for(int id) const {
+
+    return *stripes_[mix(static_cast<std::uint32_t>(id)) % stripes_.size()];
+
+}
+
+
+/**
+ * Picks the invalidation slot of a task within its stripe.
+ * @param id Task ID
+ * @return std::size_t Index into Stripe::invalidated
+ */
+std::size_t TaskCache::slot_for(int id) const {
+
+    return mix(static_cast<std::uint32_t>(id)) / stripes_.size() % invalidation_slots;
+
+}
+
+
+/**
+ * Moves an entry to the most recently used end of a segment.
+ * The stripe lock must be held.
+ * @param stripe Owning stripe
+ * @param entry Entry to move
+ * @param segment Destination segment (may be the current one)
+ */
+void TaskCache::move_to(Stripe& stripe, std::list<Entry>::iterator entry, Segment segment) {
+
+    stripe.bytes[entry->segment] -= entry->size;
+    stripe.bytes[segment] += entry->size;
+    stripe.segments[segment].splice(stripe.segments[segment].begin(), stripe.segments[entry->segment], entry);
+    entry->segment = segment;
+
+}
+
+
+/**
+ * Removes an entry from its segment and the index.
+ * The stripe lock must be held.
+ * @param stripe Owning stripe
+ * @param entry Entry to remove
+ */
+void TaskCache::remove(Stripe& stripe, std::list<Entry>::iterator entry) {
+
+    stripe.bytes[entry->segment] -= entry->size;
+    stripe.index.erase(entry->task.id);
+    stripe.segments[entry->segment].erase(entry);
+
+}
+
+
+/**
+ * Finds the least recently used unpinned entry of a segment.
+ * The stripe lock must be held.
+ * @param stripe Owning stripe
+ * @param segment Segment to search
+ * @return std::optional<std::list<Entry>::iterator> Victim, or nullopt if every entry is pinned
+ */
+std::optional<std::list<TaskCache::Entry>::iterator> TaskCache::find_victim(Stripe& stripe, Segment segment) {
+
+    auto& list = stripe.segments[segment];
+    for (auto it = list.end(); it != list.begin();) {
+        --it;
+        if (!it->pinned) return it;
+    }
+    return std::nullopt;
+
+}
+
+
+/**
+ * Evicts until the stripe fits its budget.
+ * Under W-TinyLFU the window's LRU entry is a candidate for the main cache: it joins
+ * probation and then has to outrank the main cache's LRU victim, or it is dropped.
+ * Pinned entries are admitted straight to protected and skipped as victims; if only
+ * pinned entries are left the stripe is allowed to exceed its budget.
+ * The stripe lock must be held.
+ * @param stripe Stripe to trim
+ */
+void TaskCache::enforce_budget(Stripe& stripe) {
+
+    while (stripe.bytes[window] > window_budget_) {
+
+        if (policy_ == Policy::lru) {
+            auto victim = find_victim(stripe, window);
+            if (!victim) break;
+            remove(stripe, *victim);
+            stripe.evictions++;
+            continue;
+        }
+
+        auto candidate = std::prev(stripe.segments[window].end());
+        move_to(stripe, candidate, candidate->pinned ? protected_main : probation);
+
+        while (stripe.bytes[probation] + stripe.bytes[protected_main] > main_budget_) {
+
+            auto victim = find_victim(stripe, probation);
+            if (!victim) victim = find_victim(stripe, protected_main);
+
+            if (!victim || *victim == candidate) {
+                if (!candidate->pinned) {
+                    remove(stripe, candidate);
+                    stripe.evictions++;
+                }
+                break;
+            }
+
+            if (candidate->pinned || stripe.sketch.frequency(candidate->task.id) > stripe.sketch.frequency((*victim)->task.id)) {
+                remove(stripe, *victim);
+                stripe.evictions++;
+            }
+            else {
+                remove(stripe, candidate);
+                stripe.rejections++;
+                break;
+            }
+
+        }
+
+    }
+
+}
+
+
+/**
+ * FrequencySketch constructor.
+ * @param expected_entries Approximate number of entries the owning stripe holds
+ */
+TaskCache::FrequencySketch::FrequencySketch(std::size_t expected_entries) {
+
+    std::size_t width = std::bit_ceil(std::max<std::size_t>(expected_entries, 64));
+    counters_.assign(4 * width, 0);
+    mask_ = width - 1;
+    sample_size_ = 10 * width;
+
+}
+
+
+/**
+ * Counts one access to a task.
+ * @param id Task ID
+ */
+void TaskCache::FrequencySketch::increment(int id) {
+
+    for (int row = 0; row < 4; ++row) {
+        std::uint8_t& counter = counters_[index(id, row)];
+        if (counter < 15) counter++;
+    }
+
+    // Aging: halve every counter once enough samples were seen
+    if (++additions_ == sample_size_) {
+        for (auto& counter : counters_) counter >>= 1;
+        additions_ /= 2;
+    }
+
+}
+
+
+/**
+ * Estimates how often a task was accessed recently.
+ * @param id Task ID
+ * @return unsigned Estimated access count, 0 to 15
+ */
+unsigned TaskCache::FrequencySketch::frequency(int id) const {
+
+    unsigned result = 15;
+    for (int row = 0; row < 4; ++row) result = std::min<unsigned>(result, counters_[index(id, row)]);
+    return result;
+
+}
+
+
+/**
+ * Computes the counter slot of a task in one row.
+ * @param id Task ID
+ * @param row Sketch row, 0 to 3
+ * @return std::size_t Index into the counter table
+ */
+std::size_t TaskCache::FrequencySketch::index(int id, int row) const {
+
+    static constexpr std::uint32_t seeds[4] = { 0x9e3779b9u, 0x7f4a7c15u, 0x94d049bbu, 0xbf58476du };
+    return row * (mask_ + 1) + (mix(static_cast<std::uint32_t>(id) * seeds[row] + row) & mask_);
+
+}
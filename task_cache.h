@@ -0,0 +1,128 @@
+#pragma once
+#include "database.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Counters summed over all stripes of a TaskCache
+struct TaskCacheStats {
+
+	std::uint64_t hits = 0;
+	std::uint64_t misses = 0;
+	std::uint64_t evictions = 0;
+	std::uint64_t rejections = 0;
+	std::size_t entries = 0;
+	std::size_t pinned = 0;
+	std::size_t bytes = 0;
+	std::size_t budget_bytes = 0;
+
+};
+
+
+// Memory-budgeted cache of whole tasks, split into independently locked stripes.
+// With W-TinyLFU, new tasks enter a small LRU window and only move into the main
+// segmented LRU if a count-min sketch says they are used more often than the task
+// they would evict. Plain LRU is kept as a baseline.
+class TaskCache {
+public:
+
+	enum class Policy { tiny_lfu, lru };
+
+	// Constructor
+	TaskCache(std::size_t budget_bytes, Policy policy = Policy::tiny_lfu, unsigned stripes = 16);
+
+	// Methods
+	std::optional<Task> get(int id);
+	void put(const Task& task, std::uint64_t epoch);
+	void erase(int id);
+	void clear();
+	bool contains(int id) const;
+	TaskCacheStats stats() const;
+
+	// Pinned tasks are never chosen for eviction; replaces the previous pin set
+	void set_pinned(std::span<const int> ids);
+
+	// Take before loading from storage and pass to put(); a write to the same task in
+	// between voids the insert
+	std::uint64_t epoch() const;
+
+private:
+
+	// Count-min sketch with four rows of saturating 4-bit counters, halved periodically
+	// so that frequencies follow recent traffic
+	class FrequencySketch {
+	public:
+
+		explicit FrequencySketch(std::size_t expected_entries);
+		void increment(int id);
+		unsigned frequency(int id) const;
+
+	private:
+
+		std::size_t index(int id, int row) const;
+
+		std::vector<std::uint8_t> counters_;
+		std::size_t mask_;
+		std::size_t additions_ = 0;
+		std::size_t sample_size_;
+
+	};
+
+	enum Segment { window, probation, protected_main, segment_count };
+
+	// Invalidation epochs kept per stripe; ids sharing a slot void each other's loads
+	static constexpr std::size_t invalidation_slots = 256;
+
+	struct Entry {
+
+		Task task;
+		std::size_t size;
+		Segment segment;
+		bool pinned;
+
+	};
+
+	struct Stripe {
+
+		explicit Stripe(std::size_t expected_entries) : sketch(expected_entries) {}
+
+		std::mutex mutex;
+		std::array<std::list<Entry>, segment_count> segments;
+		std::array<std::size_t, segment_count> bytes{};
+		std::unordered_map<int, std::list<Entry>::iterator> index;
+		std::unordered_set<int> pinned;
+		FrequencySketch sketch;
+		std::array<std::uint64_t, invalidation_slots> invalidated{};	// epoch of the last erase in each slot
+		std::uint64_t cleared = 0;										// epoch of the last clear
+
+		std::uint64_t hits = 0;
+		std::uint64_t misses = 0;
+		std::uint64_t evictions = 0;
+		std::uint64_t rejections = 0;
+
+	};
+
+	Stripe& stripe_for(int id) const;
+	std::size_t slot_for(int id) const;
+	void move_to(Stripe& stripe, std::list<Entry>::iterator entry, Segment segment);
+	void remove(Stripe& stripe, std::list<Entry>::iterator entry);
+	std::optional<std::list<Entry>::iterator> find_victim(Stripe& stripe, Segment segment);
+	void enforce_budget(Stripe& stripe);
+
+	Policy policy_;
+	std::size_t budget_bytes_;
+	std::size_t window_budget_;
+	std::size_t main_budget_;
+	std::size_t protected_budget_;
+	std::atomic<std::uint64_t> epoch_{ 0 };
+	std::vector<std::unique_ptr<Stripe>> stripes_;
+
+};
@@ -1,37 +1,105 @@
 #include "task_manager.h"
+#include "utf8.h"
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+	// Commit window used for batched and async writes until set_write_coalescing picks one
+	constexpr std::chrono::microseconds default_commit_window = std::chrono::milliseconds(2);
+
+	// Text must be well-formed UTF-8; a required column must not be empty and a limited one
+	// holds at most max_chars characters (code points). where prefixes the message.
+	template <typename Column>
+	void check_value(const Column& column, const typename Column::value_type& value, const std::string& where) {
+
+		if constexpr (Column::kind == ColumnKind::text) {
+			std::string name(column.name);
+
+			if (!column.required && column.max_chars == 0) {
+				if (!utf8_valid(value)) throw std::invalid_argument(where + "Task " + name + " is not valid UTF-8");
+				return;
+			}
+
+			std::optional<std::size_t> length = utf8_length(value);
+			if (!length) throw std::invalid_argument(where + "Task " + name + " is not valid UTF-8");
+			if (column.required && *length == 0) throw std::invalid_argument(where + "Task " + name + " cannot be empty");
+			if (column.max_chars > 0 && *length > column.max_chars) throw std::invalid_argument(where + "Task " + name + " too long (max " + std::to_string(column.max_chars) + " chars)");
+		}
+
+	}
+
+	// Checks every written column of a complete task
+	void check_task(const Task& task) {
+
+		for_each_value_column([&](const auto& column) { check_value(column, task.*column.member, ""); });
+
+	}
+
+	// Checks the fields a patch sets; for a create, required fields must be set too
+	void check_fields(const TaskPatch& fields, bool create, const std::string& where = "") {
+
+		for_each_value_column([&](const auto& column) {
+			if (const auto& value = fields.*column.patch_member) check_value(column, *value, where);
+			else if (create && column.required) throw std::invalid_argument(where + "Field '" + std::string(column.name) + "' is required");
+		});
+
+	}
+
+}
 
 /**
  * TaskManager class constructor.
  * Initializes the TaskManager with a reference to a Database object.
  * @param db Reference to the Database object for data persistence
+ * @param cache_bytes Memory budget of the W-TinyLFU task cache; 0 disables caching
  */
-TaskManager::TaskManager(Database& db)
+TaskManager::TaskManager(Database& db, std::size_t cache_bytes)
 	: db_(db)
 {
+	if (cache_bytes > 0) cache_ = std::make_unique<TaskCache>(cache_bytes);
+	set_write_coalescing(std::chrono::microseconds(0));
 	std::cout << "TaskManager initialized\n";
 }
 
+/**
+ * TaskManager class destructor.
+ * Waits for a background cache warm-up to finish.
+ */
+TaskManager::~TaskManager() {
+
+	if (warmer_.joinable()) warmer_.join();
+
+}
+
 /**
  * Creates a new task with the given title and description.
  * Validates input parameters before creating the task.
  * @param title Task title (required, max 100 characters)
  * @param description Task description (optional)
- * @return int ID of the newly created task
- * @throws std::invalid_argument If title is empty or exceeds 100 characters
+ * @param durability Commit level; unset uses the default
+ * @return int ID of the newly created task, or 0 for an async create that was only queued
+ * @throws std::invalid_argument If title is empty or exceeds 100 characters, or either field is not valid UTF-8
  * @throws std::runtime_error If database operation fails
  */
-int TaskManager::create_task(const std::string& title, const std::string& description) {
-
-	if (title.empty() || title.length() > 100) {
-		if (title.empty()) throw std::invalid_argument("Task title cannot be empty");
-		if (title.length() > 100) throw std::invalid_argument("Task title too long (max 100 chars)");
-	}
+int TaskManager::create_task(const std::string& title, const std::string& description, std::optional<Durability> durability) {
 
 	Task task{ 0, title, description, false };
+	check_task(task);
+
+	switch (durability.value_or(default_durability_)) {
+	case Durability::strict: {
+		int id = 0;
+		batcher_->write_through({}, [&] { id = db_.add_task(task); });
+		return id;
+	}
+	case Durability::batched: return batcher_->submit_insert(task).get();
+	case Durability::async: batcher_->submit_insert(task); return 0;
+	}
 
-	return db_.add_task(task);
+	return 0;
 
 }
 
@@ -42,26 +110,42 @@ int TaskManager::create_task(const std::string& title, const std::string& descri
  * @param title New task title (required)
  * @param description New task description
  * @param completed Completion status of the task
- * @return bool True if update was successful, false otherwise
- * @throws std::invalid_argument If ID is invalid or title is empty
+ * @param durability Commit level; unset uses the default
+ * @return bool True if update was successful (or queued, for async), false otherwise
+ * @throws std::invalid_argument If ID is invalid, the title is empty or too long, or either field is not valid UTF-8
  * @throws std::runtime_error If database operation fails or task not found
  */
-bool TaskManager::update_task(int id, const std::string& title, const std::string& description, bool complited) {
+bool TaskManager::update_task(int id, const std::string& title, const std::string& description, bool complited, std::optional<Durability> durability) {
 
-	if (id <= 0 || title.empty()) {
-		if (id <= 0) throw std::invalid_argument("Invalid task ID");
-		if (title.empty()) throw std::invalid_argument("Task title cannot be empty");
-	}
+	if (id <= 0) throw std::invalid_argument("Invalid task ID");
+
+	Task updated_task{ id, title, description, complited };
+	check_task(updated_task);
 
-	Task existing_task = db_.get_task_by_id(id);
+	Task existing_task = load_task(id);
 	if (existing_task.id == 0) return false;
 
-	Task updated_task = existing_task;
-	updated_task.title = title;
-	updated_task.description = description;
-	updated_task.completed = complited;
+	return write_patch(id, patch_from_task(updated_task), durability);
 
-	return db_.update_task(updated_task);
+}
+
+/**
+ * Changes only the given fields of a task.
+ * Unlike update_task the current row is not read first: nothing here needs the old
+ * values, and a missing task shows up as zero changed rows.
+ * @param id ID of the task to change
+ * @param patch Fields to write; title, if set, is validated like in create_task
+ * @param durability Commit level; unset uses the default
+ * @return bool True if the task exists (or the patch was queued, for async), false otherwise
+ * @throws std::invalid_argument If ID or title is invalid, or the description is not valid UTF-8
+ * @throws std::runtime_error If database operation fails
+ */
+bool TaskManager::patch_task(int id, const TaskPatch& patch, std::optional<Durability> durability) {
+
+	if (id <= 0) throw std::invalid_argument("Invalid task ID");
+	check_fields(patch, false);
+
+	return write_patch(id, patch, durability);
 
 }
 
@@ -77,11 +161,49 @@ bool TaskManager::delete_task(int id) {
 
 	if (id <= 0) throw std::invalid_argument("Invalid task ID");
 
-	return db_.delete_task(id);
+	bool deleted = false;
+	batcher_->write_through({ &id, 1 }, [&] { deleted = db_.delete_task(id); });
+	if (cache_) cache_->erase(id);
+
+	return deleted;
 
 }
 
 
+/**
+ * Applies a mixed list of creates, updates and deletes in one transaction.
+ * Every operation is validated before anything is written; the batch then commits
+ * as a strict write, all or nothing (see Database::apply_batch).
+ * @param ops Operations in execution order
+ * @return std::vector<TaskOpResult> One result per operation
+ * @throws std::invalid_argument If an operation has an invalid ID, title or description (the message names it)
+ * @throws std::runtime_error If database operation fails
+ */
+std::vector<TaskOpResult> TaskManager::apply_batch(std::span<const TaskOp> ops) {
+
+	std::vector<int> ids;
+
+	for (std::size_t i = 0; i < ops.size(); ++i) {
+		const TaskOp& op = ops[i];
+		std::string where = "Operation " + std::to_string(i) + ": ";
+
+		if (op.kind != TaskOp::Kind::create && op.id <= 0) throw std::invalid_argument(where + "Invalid task ID");
+		check_fields(op.fields, op.kind == TaskOp::Kind::create, where);
+
+		if (op.kind != TaskOp::Kind::create) ids.push_back(op.id);
+	}
+
+	std::vector<TaskOpResult> results;
+	batcher_->write_through(ids, [&] { results = db_.apply_batch(ops); });
+
+	if (cache_) {
+		for (int id : ids) cache_->erase(id);
+	}
+
+	return results;
+
+}
+
 /**
  * Retrieves a specific task by its ID.
  * Validates the task ID and checks if the task exists.
@@ -94,20 +216,377 @@ Task TaskManager::get_task(int id) {
 
 	if (id <= 0) throw std::invalid_argument("Invalid task ID");
 
-	Task task = db_.get_task_by_id(id);
+	Task task = load_task(id);
 	if (task.id <= 0) throw std::runtime_error("Task not found");
 
 	return task;
 
 }
 
+/**
+ * Retrieves several tasks by id in a single storage round trip.
+ * Cached tasks are served from memory and only the misses are queried. Results
+ * follow the order of the requested ids (duplicates repeat the task); ids that
+ * do not exist are left out.
+ * @param ids IDs of the tasks to retrieve
+ * @param fields TaskField mask of columns to load
+ * @return std::vector<Task> Found tasks in request order
+ * @throws std::invalid_argument If any ID is invalid
+ * @throws std::runtime_error If database operation fails
+ */
+std::vector<Task> TaskManager::get_tasks(std::span<const int> ids, unsigned fields) {
+
+	if (std::any_of(ids.begin(), ids.end(), [](int id) { return id <= 0; })) throw std::invalid_argument("Invalid task ID");
+
+	std::vector<Task> found;
+
+	if (cache_ && warm_.load(std::memory_order_acquire)) {
+
+		std::vector<int> misses;
+		for (int id : ids) {
+			if (auto task = cache_->get(id)) found.push_back(std::move(*task));
+			else misses.push_back(id);
+		}
+
+		// Only complete rows are cached, so projected misses bypass the cache
+		std::uint64_t epoch = cache_->epoch();
+		std::vector<Task> loaded = db_.get_tasks_by_ids(misses, fields);
+		for (auto& task : loaded) {
+			if ((fields & field_all) == field_all) cache_->put(task, epoch);
+			found.push_back(std::move(task));
+		}
+
+	}
+	else {
+
+		found = db_.get_tasks_by_ids(ids, fields);
+
+	}
+
+	std::sort(found.begin(), found.end(), [](const Task& a, const Task& b) { return a.id < b.id; });
+
+	std::vector<Task> tasks;
+	tasks.reserve(ids.size());
+
+	for (int id : ids) {
+		auto it = std::lower_bound(found.begin(), found.end(), id, [](const Task& task, int id) { return task.id < id; });
+		if (it != found.end() && it->id == id) tasks.push_back(*it);
+	}
+
+	return tasks;
+
+}
+
 /**
  * Retrieves all tasks from the system.
+ * @param fields TaskField mask of columns to load; unrequested members stay default
  * @return std::vector<Task> Vector containing all task objects
  * @throws std::runtime_error If database operation fails
  */
-std::vector<Task> TaskManager::get_all_tasks() {
+std::vector<Task> TaskManager::get_all_tasks(unsigned fields) {
+
+	return db_.get_all_tasks(fields);
+
+}
+
+/**
+ * Adds tasks in bulk, all in one transaction.
+ * Batches are pulled from next until it returns false, so the producer can still be
+ * parsing while earlier batches are written. Tasks are not validated here; see
+ * validate_task. Other writes wait until the import commits or rolls back.
+ * @param next Fills the next batch; an exception from it aborts the import
+ * @return std::size_t Number of tasks added
+ * @throws std::runtime_error If an insert fails; nothing is written
+ */
+std::size_t TaskManager::import_tasks(const TaskSource& next) {
+
+	std::size_t imported = 0;
+
+	batcher_->write_through({}, [&] {
+		db_.begin_transaction();
+
+		try {
+			std::vector<Task> batch;
+			while (next(batch)) {
+				db_.add_tasks(batch);
+				imported += batch.size();
+			}
+			db_.commit_transaction();
+		}
+		catch (...) {
+			db_.rollback_transaction();
+			throw;
+		}
+	});
+
+	return imported;
+
+}
+
+/**
+ * Checks a new task against the rules create_task applies.
+ * Uses no state, so it is safe to call from any thread.
+ * @param task Task to check; the id is ignored
+ * @throws std::invalid_argument If the title is empty or too long, or a text field is not valid UTF-8
+ */
+void TaskManager::validate_task(const Task& task) {
+
+	check_task(task);
+
+}
+
+/**
+ * Reads all tasks in id ranges, in parallel when more than one scan thread is set.
+ * @param fields TaskField mask of columns to load
+ * @param visit Receives each non-empty range, numbered below scan_ranges(), on the thread that read it
+ * @throws std::runtime_error If database operation fails
+ */
+void TaskManager::scan_tasks(unsigned fields, const ScanVisitor& visit) {
+
+	db_.scan_tasks(fields, visit);
+
+}
+
+/**
+ * Number of ranges scan_tasks can report with the current thread count.
+ * @return std::size_t Upper bound (exclusive) of the range numbers
+ */
+std::size_t TaskManager::scan_ranges() const {
+
+	return db_.scan_ranges();
+
+}
+
+/**
+ * Streams all tasks to a column sink without building Task objects.
+ * @param fields TaskField mask of columns to read
+ * @param sink Receives each row's values, in id order
+ * @throws std::runtime_error If database operation fails
+ */
+void TaskManager::read_columns(unsigned fields, ColumnSink& sink) {
+
+	db_.read_columns(fields, sink);
+
+}
+
+/**
+ * Loads every task into the cache with a parallel scan (see set_scan_threads).
+ * Until the load finishes, reads go straight to SQLite and leave the cache alone; then
+ * one atomic flag switches them over to the cache. Writes keep invalidating cached tasks
+ * throughout. Every insert uses the epoch taken before the scan, so a write during the
+ * load only voids the tasks it touched (see TaskCache::put); they are cached on first
+ * read as usual. A load that fails still switches reads over, since what it cached is
+ * current, but is reported as failed by get_warmup_stats. Meant to be called once at
+ * startup; does nothing when caching is disabled or a warm-up already started.
+ * @param background Return at once and load on a separate thread; otherwise load before returning
+ * @throws std::runtime_error If a foreground load fails (the cache is switched on anyway);
+ *         a background failure is logged
+ */
+void TaskManager::warm_cache(bool background) {
+
+	if (!cache_ || warmup_started_.load(std::memory_order_acquire)) return;
+
+	warm_started_ = std::chrono::steady_clock::now();
+	warm_.store(false, std::memory_order_release);
+	warmup_started_.store(true, std::memory_order_release);
+
+	auto load = [this] {
+		std::uint64_t epoch = cache_->epoch();
+		db_.scan_tasks(field_all, [&](std::size_t, std::vector<Task>& tasks) {
+			for (const auto& task : tasks) cache_->put(task, epoch);
+			warm_tasks_ += tasks.size();
+		});
+	};
+
+	// error is null when the whole table was loaded
+	auto finish = [this](const char* error) {
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - warm_started_);
+		warm_elapsed_us_.store(elapsed.count(), std::memory_order_relaxed);
+		if (error) {
+			warm_error_ = error;
+			warm_failed_.store(true, std::memory_order_release);
+			std::cerr << "Cache warm-up failed after " << elapsed.count() / 1000 << " ms (" << warm_tasks_.load() << " tasks): " << error << "\n";
+		}
+		else {
+			std::cout << "Cache warm after " << elapsed.count() / 1000 << " ms (" << warm_tasks_.load() << " tasks)\n";
+		}
+		warm_.store(true, std::memory_order_release);
+	};
+
+	if (!background) {
+		try {
+			load();
+		}
+		catch (const std::exception& e) {
+			finish(e.what());
+			throw;
+		}
+		finish(nullptr);
+		return;
+	}
+
+	warmer_ = std::thread([load, finish] {
+		try {
+			load();
+		}
+		catch (const std::exception& e) {
+			return finish(e.what());
+		}
+		finish(nullptr);
+	});
+
+}
+
+/**
+ * Sets how many threads full-table scans use; the helpers and their read connections are
+ * started here and reused by every scan (see Database::set_scan_threads).
+ * @param threads Thread count; 0 picks one per hardware thread, 1 scans on the caller only
+ */
+void TaskManager::set_scan_threads(unsigned threads) {
+
+	db_.set_scan_threads(threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency()));
+
+}
+
+/**
+ * Pins tasks in the cache so eviction never drops them, replacing any previous pins.
+ * Pinned tasks that are not cached yet are loaded with one query.
+ * Does nothing when caching is disabled.
+ * @param ids IDs of the tasks to pin
+ * @throws std::runtime_error If database operation fails
+ */
+void TaskManager::pin_tasks(std::span<const int> ids) {
+
+	if (!cache_) return;
+
+	cache_->set_pinned(ids);
+
+	std::vector<int> missing;
+	for (int id : ids) {
+		if (!cache_->contains(id)) missing.push_back(id);
+	}
+	if (missing.empty()) return;
+
+	std::uint64_t epoch = cache_->epoch();
+	for (const auto& task : db_.get_tasks_by_ids(missing)) cache_->put(task, epoch);
+
+}
+
+/**
+ * Sets the commit window of the write batcher used by batched and async writes.
+ * A non-zero window also makes batched the default level, so concurrent updates share
+ * one transaction and repeats of a task are written once. Zero restores strict as the
+ * default. Pending writes are committed before the batcher is replaced.
+ * @param window Commit window; 0 keeps the built-in window and makes strict the default
+ */
+void TaskManager::set_write_coalescing(std::chrono::microseconds window) {
+
+	batcher_.reset();
+	batcher_ = std::make_unique<WriteBatcher>(db_, window.count() > 0 ? window : default_commit_window,
+		[this](int id) { if (cache_) cache_->erase(id); });
+
+	default_durability_ = window.count() > 0 ? Durability::batched : Durability::strict;
+
+}
+
+/**
+ * Retrieves per-statement storage profiles.
+ * @return std::vector<StatementProfile> Statement profiles, slowest total time first
+ */
+std::vector<StatementProfile> TaskManager::get_statement_profiles() const {
+
+	return db_.get_statement_profiles();
+
+}
+
+/**
+ * Reports how far the startup cache warm-up has got.
+ * @return WarmupStats started is false if warm_cache was never called (or caching is disabled)
+ */
+WarmupStats TaskManager::get_warmup_stats() const {
+
+	WarmupStats stats;
+	stats.started = warmup_started_.load(std::memory_order_acquire);
+	if (!stats.started) return stats;
+
+	stats.failed = warm_failed_.load(std::memory_order_acquire);
+	stats.warm = warm_.load(std::memory_order_acquire) && !stats.failed;
+	if (stats.failed) stats.error = warm_error_;
+	stats.tasks = warm_tasks_.load(std::memory_order_relaxed);
+
+	std::int64_t elapsed_us = warm_elapsed_us_.load(std::memory_order_relaxed);
+	if (elapsed_us < 0) elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - warm_started_).count();
+	stats.elapsed_ms = elapsed_us / 1000.0;
+
+	return stats;
+
+}
+
+/**
+ * Retrieves task cache counters.
+ * @return TaskCacheStats Cache statistics; budget_bytes is 0 when caching is disabled
+ */
+TaskCacheStats TaskManager::get_cache_stats() const {
+
+	return cache_ ? cache_->stats() : TaskCacheStats{};
+
+}
+
+/**
+ * Retrieves group-commit counters.
+ * @return WriteBatchStats Counters of the write batcher
+ */
+WriteBatchStats TaskManager::get_write_stats() const {
+
+	return batcher_ ? batcher_->stats() : WriteBatchStats{};
+
+}
+
+/**
+ * Reads one task through the cache.
+ * @param id ID of the task to read
+ * @return Task Task row
+ * @throws std::runtime_error If task not found or database operation fails
+ */
+Task TaskManager::load_task(int id) {
+
+	if (!cache_ || !warm_.load(std::memory_order_acquire)) return db_.get_task_by_id(id);
+
+	if (auto task = cache_->get(id)) return std::move(*task);
+
+	std::uint64_t epoch = cache_->epoch();
+	Task task = db_.get_task_by_id(id);
+	cache_->put(task, epoch);
+
+	return task;
+
+}
+
+/**
+ * Writes a patch at the requested durability.
+ * A strict write commits directly on the caller's thread, serialized against group
+ * commits (see WriteBatcher::write_through); the other levels queue it.
+ * @param id ID of the task to change
+ * @param patch Fields to write
+ * @param durability Commit level; unset uses the default
+ * @return bool True if the task exists (always true for async)
+ * @throws std::runtime_error If database operation fails
+ */
+bool TaskManager::write_patch(int id, const TaskPatch& patch, std::optional<Durability> durability) {
+
+	Durability level = durability.value_or(default_durability_);
+
+	if (level == Durability::strict) {
+		bool patched = false;
+		batcher_->write_through({ &id, 1 }, [&] { patched = db_.patch_task(id, patch); });
+		if (cache_) cache_->erase(id);
+		return patched;
+	}
+
+	// The batcher invalidates the cache once the write is committed
+	std::future<bool> committed = batcher_->submit(id, patch);
+	if (level == Durability::async) return true;
 
-	return db_.get_all_tasks();
+	return committed.get();
 
 }
@@ -1,20 +1,104 @@
 #pragma once
 #include "database.h"
+#include "task_cache.h"
+#include "write_batcher.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <thread>
+
+// How far a write has to get before the caller is answered
+enum class Durability {
+
+	strict,		// committed on its own transaction (fsync) before returning
+	batched,	// group commit: returns after the shared commit of its window
+	async		// write-behind: returns once queued; a crash can lose it
+
+};
+
+
+// Progress of the startup cache warm-up
+struct WarmupStats {
+
+	bool started = false;
+	bool warm = false;			// the whole table was loaded
+	bool failed = false;		// the load stopped early; the cache fills on demand instead
+	std::string error;			// why it failed
+	std::size_t tasks = 0;		// tasks loaded into the cache so far
+	double elapsed_ms = 0;		// from the start of the warm-up until now, or until it finished
+
+};
+
+
+// Hands the next batch of an import to the writer; false once there are no more
+using TaskSource = std::function<bool(std::vector<Task>& batch)>;
+
 
 class TaskManager {
 public:
 
-	explicit TaskManager(Database& db);
+	// Constructor (cache_bytes 0 disables the task cache)
+	explicit TaskManager(Database& db, std::size_t cache_bytes = 0);
 
-	// CRUD operations
-	int create_task(const std::string& title, const std::string& description = "");
-	bool update_task(int id, const std::string& title, const std::string& description, bool completed);
+	// Destructor (waits for a running warm-up)
+	~TaskManager();
+
+	// CRUD operations (writes without a durability use the default level)
+	int create_task(const std::string& title, const std::string& description = "", std::optional<Durability> durability = std::nullopt);
+	bool update_task(int id, const std::string& title, const std::string& description, bool completed, std::optional<Durability> durability = std::nullopt);
+	bool patch_task(int id, const TaskPatch& patch, std::optional<Durability> durability = std::nullopt);
 	bool delete_task(int id);
+	std::vector<TaskOpResult> apply_batch(std::span<const TaskOp> ops);
 	Task get_task(int id);
-	std::vector<Task> get_all_tasks();
+	std::vector<Task> get_tasks(std::span<const int> ids, unsigned fields = field_all);
+	std::vector<Task> get_all_tasks(unsigned fields = field_all);
+
+	// Bulk load: batches pulled from next are added in one transaction (see import_csv)
+	std::size_t import_tasks(const TaskSource& next);
+
+	// Create rules, for callers that check tasks on their own threads
+	static void validate_task(const Task& task);
+
+	// Full-table reads split into id ranges over scan threads (see Database::scan_tasks)
+	void scan_tasks(unsigned fields, const ScanVisitor& visit);
+	std::size_t scan_ranges() const;
+
+	// Full-table read in id order, value by value (see Database::read_columns)
+	void read_columns(unsigned fields, ColumnSink& sink);
+	void set_scan_threads(unsigned threads);
+
+	// Cache control
+	void pin_tasks(std::span<const int> ids);
+	void warm_cache(bool background = true);
+
+	// Commit window for batched and async writes; non-zero also makes batched the default
+	void set_write_coalescing(std::chrono::microseconds window);
+
+	// Diagnostics
+	std::vector<StatementProfile> get_statement_profiles() const;
+	TaskCacheStats get_cache_stats() const;
+	WarmupStats get_warmup_stats() const;
+	WriteBatchStats get_write_stats() const;
 
 private:
 
+	Task load_task(int id);
+	bool write_patch(int id, const TaskPatch& patch, std::optional<Durability> durability);
+
 	Database& db_;
+	std::unique_ptr<TaskCache> cache_;
+	std::unique_ptr<WriteBatcher> batcher_;
+	Durability default_durability_ = Durability::strict;
+
+	// Reads bypass the cache until a warm-up finishes; then warm_ flips once and stays set
+	std::thread warmer_;
+	std::atomic<bool> warmup_started_{ false };
+	std::atomic<bool> warm_{ true };
+	std::atomic<bool> warm_failed_{ false };	// set after warm_error_ is written
+	std::string warm_error_;
+	std::atomic<std::size_t> warm_tasks_{ 0 };
+	std::atomic<std::int64_t> warm_elapsed_us_{ -1 };
+	std::chrono::steady_clock::time_point warm_started_;
 
 };
\ No newline at end of file
@@ -0,0 +1,171 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+// Database task structure
+struct Task {
+
+	int id;
+	std::string title;
+	std::string description;
+	bool completed;
+
+};
+
+// Partial update; only the fields that are set are written
+struct TaskPatch {
+
+	std::optional<std::string> title;
+	std::optional<std::string> description;
+	std::optional<bool> completed;
+
+};
+
+// Task columns, combined as a bitmask to project queries onto a subset
+enum TaskField : unsigned {
+
+	field_id = 1u << 0,
+	field_title = 1u << 1,
+	field_description = 1u << 2,
+	field_completed = 1u << 3,
+	field_all = field_id | field_title | field_description | field_completed
+
+};
+
+// Storage and JSON type of a column
+enum class ColumnKind { integer, text, boolean };
+
+// Describes one Task member. SQL text, statement binding and reading, the JSON writer and
+// reader, and input validation are all generated from task_columns, so a new field is one
+// member in Task (and TaskPatch), one TaskField bit and one entry below.
+template <typename T>
+struct TaskColumn {
+
+	using value_type = T;
+	static constexpr ColumnKind kind = std::is_same_v<T, std::string> ? ColumnKind::text : std::is_same_v<T, bool> ? ColumnKind::boolean : ColumnKind::integer;
+
+	std::string_view name;			// column name and JSON key
+	std::string_view definition;	// type and constraints in CREATE TABLE
+	TaskField flag;
+	T Task::* member;
+	std::optional<T> TaskPatch::* patch_member;	// null for the key, which is never written
+	bool required;					// must be given, and non-empty, on create
+	std::size_t max_chars;			// text only, in characters; 0 for no limit
+
+};
+
+inline constexpr std::tuple task_columns{
+	TaskColumn<int>{ "id", "INTEGER PRIMARY KEY AUTOINCREMENT", field_id, &Task::id, nullptr, false, 0 },
+	TaskColumn<std::string>{ "title", "TEXT NOT NULL", field_title, &Task::title, &TaskPatch::title, true, 100 },
+	TaskColumn<std::string>{ "description", "TEXT", field_description, &Task::description, &TaskPatch::description, false, 0 },
+	TaskColumn<bool>{ "completed", "BOOLEAN DEFAULT 0", field_completed, &Task::completed, &TaskPatch::completed, false, 0 }
+};
+
+inline constexpr std::size_t task_column_count = std::tuple_size_v<decltype(task_columns)>;
+static_assert(field_all == (1u << task_column_count) - 1, "one TaskField bit per column, in order");
+
+// Calls f with each column descriptor in declaration order; the loop is unrolled
+template <typename F>
+constexpr void for_each_column(F&& f) {
+
+	std::apply([&](const auto&... column) { (f(column), ...); }, task_columns);
+
+}
+
+// Same, skipping the key: the columns a TaskPatch (or an INSERT) can set
+template <typename F>
+constexpr void for_each_value_column(F&& f) {
+
+	for_each_column([&](const auto& column) { if (column.patch_member) f(column); });
+
+}
+
+// Untyped view of a column, for code that looks fields up by name at run time
+struct ColumnRule {
+
+	std::string_view name;
+	ColumnKind kind;
+	TaskField flag;
+	bool writable;
+	bool required;
+	std::size_t max_chars;
+
+};
+
+inline constexpr std::array<ColumnRule, task_column_count> column_rules = [] {
+
+	std::array<ColumnRule, task_column_count> rules{};
+	std::size_t i = 0;
+	for_each_column([&](const auto& column) {
+		rules[i++] = { column.name, column.kind, column.flag, column.patch_member != nullptr, column.required, column.max_chars };
+	});
+	return rules;
+
+}();
+
+// Rule for a column name, or null if no column has that name
+constexpr const ColumnRule* find_column(std::string_view name) {
+
+	for (const ColumnRule& rule : column_rules) if (rule.name == name) return &rule;
+	return nullptr;
+
+}
+
+// TaskField mask of the fields set in a patch
+constexpr unsigned patch_fields(const TaskPatch& patch) {
+
+	unsigned fields = 0;
+	for_each_value_column([&](const auto& column) { if (patch.*column.patch_member) fields |= column.flag; });
+	return fields;
+
+}
+
+// Copies the fields set in from over into, later values winning
+inline void merge_patch(TaskPatch& into, const TaskPatch& from) {
+
+	for_each_value_column([&](const auto& column) { if (from.*column.patch_member) into.*column.patch_member = from.*column.patch_member; });
+
+}
+
+// Task made of the fields set in a patch; the rest keep their defaults
+inline Task task_from_patch(const TaskPatch& patch) {
+
+	Task task{ 0, {}, {}, false };
+	for_each_value_column([&](const auto& column) { if (patch.*column.patch_member) task.*column.member = *(patch.*column.patch_member); });
+	return task;
+
+}
+
+// Patch that sets every written column to the task's value
+inline TaskPatch patch_from_task(const Task& task) {
+
+	TaskPatch patch;
+	for_each_value_column([&](const auto& column) { patch.*column.patch_member = task.*column.member; });
+	return patch;
+
+}
+
+// Fixed-capacity, null-terminated string assembled in constant expressions (SQL text, JSON
+// keys); running out of capacity is a compile error
+template <std::size_t Capacity>
+struct FixedText {
+
+	std::array<char, Capacity> text{};
+	std::size_t size = 0;
+
+	constexpr FixedText& operator+=(std::string_view part) {
+		if (size + part.size() >= Capacity) throw std::length_error("FixedText capacity exceeded");
+		for (char c : part) text[size++] = c;
+		return *this;
+	}
+
+	constexpr const char* c_str() const { return text.data(); }
+	constexpr std::string_view view() const { return { text.data(), size }; }
+
+};
\ No newline at end of file
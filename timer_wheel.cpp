@@ -0,0 +1,233 @@
+#include "timer_wheel.h"
+#include <algorithm>
+
+
+/**
+ * TimerWheel::Timer constructor.
+ * @param on_expire Called when the timer fires; it is already disarmed by then and may re-arm itself
+ */
+TimerWheel::Timer::Timer(std::function<void()> on_expire)
+    : on_expire_(std::move(on_expire)) {
+}
+
+
+/**
+ * TimerWheel::Timer destructor.
+ * Cancels the timer if it is still armed.
+ */
+TimerWheel::Timer::~Timer() {
+
+    if (wheel_) wheel_->cancel(*this);
+
+}
+
+
+/**
+ * Checks whether the timer is scheduled.
+ * @return bool True if the timer will fire unless cancelled
+ */
+bool TimerWheel::Timer::armed() const {
+
+    return wheel_ != nullptr;
+
+}
+
+
+/**
+ * TimerWheel class constructor.
+ * @param tick Resolution; deadlines are rounded up to whole ticks
+ * @param start Time of tick zero
+ */
+TimerWheel::TimerWheel(std::chrono::milliseconds tick, std::chrono::steady_clock::time_point start)
+    : tick_(std::max(tick, std::chrono::milliseconds(1))), start_(start) {
+}
+
+
+/**
+ * TimerWheel class destructor.
+ * Remaining timers are disarmed without firing, so they can outlive the wheel.
+ */
+TimerWheel::~TimerWheel() {
+
+    for (auto& level : wheel_) {
+        for (auto& head : level) {
+            while (head.next != &head) {
+                Timer& timer = static_cast<Timer&>(*head.next);
+                unlink(timer);
+                timer.wheel_ = nullptr;
+            }
+        }
+    }
+
+}
+
+
+/**
+ * Arms a timer, or moves it if it is already armed.
+ * @param timer Timer to arm
+ * @param delay Time from now until it fires; rounded up to at least one tick
+ */
+void TimerWheel::schedule(Timer& timer, std::chrono::milliseconds delay) {
+
+    if (timer.wheel_) cancel(timer);
+
+    std::uint64_t ticks = static_cast<std::uint64_t>((delay + tick_ - std::chrono::milliseconds(1)) / tick_);
+    timer.expiry_ = now_ + std::max<std::uint64_t>(ticks, 1);
+    timer.wheel_ = this;
+    size_++;
+
+    insert(timer);
+
+}
+
+
+/**
+ * Disarms a timer. Does nothing if it is not armed.
+ * @param timer Timer to disarm
+ */
+void TimerWheel::cancel(Timer& timer) {
+
+    if (timer.wheel_ != this) return;
+
+    unlink(timer);
+    timer.wheel_ = nullptr;
+    size_--;
+
+}
+
+
+/**
+ * Moves the wheel forward to the given time, firing every timer that expired.
+ * @param now Current time
+ * @return std::size_t Number of timers fired
+ */
+std::size_t TimerWheel::advance(std::chrono::steady_clock::time_point now) {
+
+    if (now < start_) return 0;
+
+    std::uint64_t target = static_cast<std::uint64_t>((now - start_) / tick_);
+    std::size_t fired = 0;
+
+    while (now_ < target) {
+
+        // With nothing armed there is nothing to cascade or fire; jump straight there
+        if (size_ == 0) {
+            now_ = target;
+            break;
+        }
+
+        fired += step();
+
+    }
+
+    return fired;
+
+}
+
+
+/**
+ * Returns the number of armed timers.
+ * @return std::size_t Armed timers
+ */
+std::size_t TimerWheel::size() const {
+
+    return size_.load(std::memory_order_relaxed);
+
+}
+
+
+/**
+ * Returns the wheel resolution.
+ * @return std::chrono::milliseconds Tick length
+ */
+std::chrono::milliseconds TimerWheel::tick() const {
+
+    return tick_;
+
+}
+
+
+/**
+ * Links a timer into the slot for its expiry: level n holds timers due within
+ * 64^(n+1) ticks. Anything further out waits in the last level and is re-placed
+ * each time that slot comes round.
+ * @param timer Armed timer with expiry_ set
+ */
+void TimerWheel::insert(Timer& timer) {
+
+    std::uint64_t delta = timer.expiry_ > now_ ? timer.expiry_ - now_ : 0;
+
+    int level = 0;
+    while (level < levels - 1 && delta >= (std::uint64_t{ 1 } << (slot_bits * (level + 1)))) level++;
+
+    std::uint64_t slot = (std::min(timer.expiry_, now_ + (std::uint64_t{ 1 } << (slot_bits * levels)) - 1) >> (slot_bits * level)) & (slots - 1);
+
+    Link& head = wheel_[level][slot];
+    timer.prev = head.prev;
+    timer.next = &head;
+    head.prev->next = &timer;
+    head.prev = &timer;
+
+}
+
+
+/**
+ * Removes a link from its list.
+ * @param link Linked node
+ */
+void TimerWheel::unlink(Link& link) {
+
+    link.prev->next = link.next;
+    link.next->prev = link.prev;
+    link.prev = link.next = &link;
+
+}
+
+
+/**
+ * Advances one tick: cascades outer slots that came due, then fires the current slot.
+ * @return std::size_t Number of timers fired
+ */
+std::size_t TimerWheel::step() {
+
+    now_++;
+
+    // When a level wraps, the next level's current slot is redistributed
+    for (int level = 1; level < levels; ++level) {
+
+        if ((now_ & ((std::uint64_t{ 1 } << (slot_bits * level)) - 1)) != 0) break;
+
+        Link& head = wheel_[level][(now_ >> (slot_bits * level)) & (slots - 1)];
+        Link pending;
+        if (head.next != &head) {
+            pending.next = head.next;
+            pending.prev = head.prev;
+            pending.next->prev = &pending;
+            pending.prev->next = &pending;
+            head.prev = head.next = &head;
+        }
+
+        while (pending.next != &pending) {
+            Timer& timer = static_cast<Timer&>(*pending.next);
+            unlink(timer);
+            insert(timer);
+        }
+
+    }
+
+    std::size_t fired = 0;
+    Link& head = wheel_[0][now_ & (slots - 1)];
+
+    // Callbacks may cancel or re-arm any timer, so always take the current first one
+    while (head.next != &head) {
+        Timer& timer = static_cast<Timer&>(*head.next);
+        unlink(timer);
+        timer.wheel_ = nullptr;
+        size_--;
+        fired++;
+        timer.on_expire_();
+    }
+
+    return fired;
+
+}
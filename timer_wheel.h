@@ -0,0 +1,79 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+// Hierarchical timing wheel for connection deadlines. Four levels of 64 slots each;
+// a timer sits in the level matching how far away it is, and a slot of an outer level
+// is redistributed inward when the level below wraps around. Scheduling, cancelling
+// and firing are O(1) per timer; advancing costs one slot per tick. Timers are
+// intrusive, so arming one never allocates. Not thread-safe: use it from one thread.
+class TimerWheel {
+private:
+
+	struct Link {
+
+		Link* prev = this;
+		Link* next = this;
+
+	};
+
+public:
+
+	// A deadline owned by its user. Destroying a timer cancels it.
+	class Timer : private Link {
+	public:
+
+		explicit Timer(std::function<void()> on_expire);
+		~Timer();
+
+		Timer(const Timer&) = delete;
+		Timer& operator=(const Timer&) = delete;
+
+		bool armed() const;
+
+	private:
+
+		friend class TimerWheel;
+
+		std::function<void()> on_expire_;
+		TimerWheel* wheel_ = nullptr;
+		std::uint64_t expiry_ = 0;
+
+	};
+
+	// Constructor
+	explicit TimerWheel(std::chrono::milliseconds tick, std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now());
+
+	// Destructor (disarms every remaining timer)
+	~TimerWheel();
+
+	TimerWheel(const TimerWheel&) = delete;
+	TimerWheel& operator=(const TimerWheel&) = delete;
+
+	// Methods
+	void schedule(Timer& timer, std::chrono::milliseconds delay);
+	void cancel(Timer& timer);
+	std::size_t advance(std::chrono::steady_clock::time_point now);
+	std::size_t size() const;
+	std::chrono::milliseconds tick() const;
+
+private:
+
+	static constexpr int levels = 4;
+	static constexpr int slot_bits = 6;
+	static constexpr std::uint64_t slots = 1u << slot_bits;
+
+	void insert(Timer& timer);
+	static void unlink(Link& link);
+	std::size_t step();
+
+	std::chrono::milliseconds tick_;
+	std::chrono::steady_clock::time_point start_;
+	std::uint64_t now_ = 0;
+	std::atomic<std::size_t> size_{ 0 };	// read by /metrics from the API threads
+	std::array<std::array<Link, slots>, levels> wheel_;
+
+};
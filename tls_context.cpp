@@ -0,0 +1,122 @@
+#include "tls_context.h"
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <memory>
+#include <stdexcept>
+
+namespace ssl = boost::asio::ssl;
+
+namespace {
+
+    // Server-side session cache: enough entries for many clients, one hour lifetime
+    constexpr long session_cache_size = 20480;
+    constexpr long session_timeout_seconds = 3600;
+    const unsigned char session_id_context[] = "AsyncRestServer";
+
+    ssl::context make_base_context() {
+
+        ssl::context ctx(ssl::context::tls_server);
+
+        ctx.set_options(ssl::context::default_workarounds | ssl::context::no_sslv2 | ssl::context::no_sslv3 |
+            ssl::context::no_tlsv1 | ssl::context::no_tlsv1_1 | ssl::context::single_dh_use);
+
+        SSL_CTX* native = ctx.native_handle();
+
+        // Resumption: stateful cache for TLS 1.2 session ids, stateless tickets for both versions
+        SSL_CTX_set_session_cache_mode(native, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(native, session_cache_size);
+        SSL_CTX_set_timeout(native, session_timeout_seconds);
+        SSL_CTX_set_session_id_context(native, session_id_context, sizeof(session_id_context) - 1);
+        SSL_CTX_clear_options(native, SSL_OP_NO_TICKET);
+        SSL_CTX_set_num_tickets(native, 2);
+
+        return ctx;
+
+    }
+
+    struct PkeyDeleter { void operator()(EVP_PKEY* p) const { EVP_PKEY_free(p); } };
+    struct PkeyCtxDeleter { void operator()(EVP_PKEY_CTX* p) const { EVP_PKEY_CTX_free(p); } };
+    struct X509Deleter { void operator()(X509* p) const { X509_free(p); } };
+
+}
+
+
+/**
+ * Creates a TLS server context from PEM certificate and key files.
+ * @param cert_path Certificate chain file
+ * @param key_path Private key file
+ * @return ssl::context Configured server context
+ * @throws boost::system::system_error If a file cannot be loaded
+ */
+ssl::context make_tls_context(const std::string& cert_path, const std::string& key_path) {
+
+    ssl::context ctx = make_base_context();
+    ctx.use_certificate_chain_file(cert_path);
+    ctx.use_private_key_file(key_path, ssl::context::pem);
+    return ctx;
+
+}
+
+
+/**
+ * Creates a TLS server context with a self-signed P-256 certificate for "localhost".
+ * @return ssl::context Configured server context
+ * @throws std::runtime_error If key or certificate generation fails
+ */
+ssl::context make_tls_context() {
+
+    std::unique_ptr<EVP_PKEY_CTX, PkeyCtxDeleter> pctx(EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr));
+    EVP_PKEY* raw_key = nullptr;
+
+    if (!pctx || EVP_PKEY_keygen_init(pctx.get()) <= 0 ||
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(pctx.get(), NID_X9_62_prime256v1) <= 0 ||
+        EVP_PKEY_keygen(pctx.get(), &raw_key) <= 0) {
+        throw std::runtime_error("Failed to generate TLS key");
+    }
+    std::unique_ptr<EVP_PKEY, PkeyDeleter> key(raw_key);
+
+    std::unique_ptr<X509, X509Deleter> cert(X509_new());
+    X509_set_version(cert.get(), 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert.get()), 365L * 24 * 3600);
+    X509_set_pubkey(cert.get(), key.get());
+
+    X509_NAME* name = X509_get_subject_name(cert.get());
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+    X509_set_issuer_name(cert.get(), name);
+
+    if (!X509_sign(cert.get(), key.get(), EVP_sha256())) throw std::runtime_error("Failed to sign TLS certificate");
+
+    ssl::context ctx = make_base_context();
+    if (SSL_CTX_use_certificate(ctx.native_handle(), cert.get()) != 1 ||
+        SSL_CTX_use_PrivateKey(ctx.native_handle(), key.get()) != 1) {
+        throw std::runtime_error("Failed to install TLS certificate");
+    }
+
+    return ctx;
+
+}
+
+
+/**
+ * Reads the session cache counters of a server context.
+ * @param ctx Server context
+ * @return TlsStats Handshake and resumption counters
+ */
+TlsStats get_tls_stats(ssl::context& ctx) {
+
+    SSL_CTX* native = ctx.native_handle();
+
+    return {
+        SSL_CTX_sess_accept_good(native),
+        SSL_CTX_sess_hits(native),
+        SSL_CTX_sess_misses(native),
+        SSL_CTX_sess_timeouts(native),
+        SSL_CTX_sess_cache_full(native),
+        SSL_CTX_sess_number(native)
+    };
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <boost/asio/ssl.hpp>
+#include <cstdint>
+#include <string>
+
+// Server session cache counters from OpenSSL
+struct TlsStats {
+
+	std::int64_t handshakes;
+	std::int64_t resumed;
+	std::int64_t misses;
+	std::int64_t timeouts;
+	std::int64_t cache_full;
+	std::int64_t cached_sessions;
+
+};
+
+// Server context with session cache and tickets enabled, certificate from PEM files
+boost::asio::ssl::context make_tls_context(const std::string& cert_path, const std::string& key_path);
+
+// Server context with a freshly generated self-signed certificate (development and benchmarks)
+boost::asio::ssl::context make_tls_context();
+
+TlsStats get_tls_stats(boost::asio::ssl::context& ctx);
@@ -0,0 +1,274 @@
+#include "tls_session.h"
+#include "http_server.h"
+#include <limits>
+
+namespace {
+
+    // Buffer space for the first read of a kept-alive connection's next request
+    constexpr std::size_t first_read_size = 4096;
+
+}
+
+/**
+ * TlsSession class constructor.
+ * @param server Server whose request handler answers the request
+ * @param socket Accepted client socket
+ * @param ctx Server TLS context
+ */
+TlsSession::TlsSession(HttpServer& server, tcp::socket socket, asio::ssl::context& ctx)
+    : server_(server), stream_(std::move(socket), ctx),
+      deadline_([this] { on_deadline(); }) {
+
+    beast::error_code ec;
+    client_ = stream_.next_layer().remote_endpoint(ec);
+
+}
+
+
+/**
+ * Starts the asynchronous TLS handshake.
+ * The header deadline bounds the handshake and the request together, so stalled
+ * clients cannot pin sessions.
+ */
+void TlsSession::start() {
+
+    server_.deadlines_.schedule(deadline_, server_.timeouts_.header);
+
+    stream_.async_handshake(asio::ssl::stream_base::server,
+        [self = shared_from_this()](beast::error_code ec) { self->on_handshake(ec); });
+
+}
+
+
+/**
+ * Reads the first request once the handshake is done.
+ */
+void TlsSession::on_handshake(beast::error_code ec) {
+
+    if (ec) return close();
+
+    read_request();
+
+}
+
+
+/**
+ * Waits for the next request on a kept-alive connection under the idle deadline.
+ * Pipelined bytes already in the buffer start the request right away.
+ */
+void TlsSession::wait_for_request() {
+
+    if (buffer_.size() > 0) {
+        server_.deadlines_.schedule(deadline_, server_.timeouts_.header);
+        return read_request();
+    }
+
+    idle_ = true;
+    server_.deadlines_.schedule(deadline_, server_.timeouts_.idle);
+
+    // Records OpenSSL already holds are returned at once; otherwise this waits for the peer
+    stream_.async_read_some(buffer_.prepare(first_read_size),
+        [self = shared_from_this()](beast::error_code ec, std::size_t bytes) {
+
+            if (ec) return self->close();
+
+            // The first bytes of a request start the header deadline
+            self->buffer_.commit(bytes);
+            self->idle_ = false;
+            self->server_.deadlines_.schedule(self->deadline_, self->server_.timeouts_.header);
+            self->read_request();
+
+        }
+    );
+
+}
+
+
+/**
+ * Reads the request headers; the header deadline is already armed.
+ */
+void TlsSession::read_request() {
+
+    parser_ = std::make_unique<http::request_parser<http::string_body>>();
+    // Beast would hold a declared length to its 1 MB default while parsing the header;
+    // the route's own limit is applied in on_header
+    parser_->body_limit(std::numeric_limits<std::uint64_t>::max());
+
+    http::async_read_header(stream_, buffer_, *parser_,
+        [self = shared_from_this()](beast::error_code ec, std::size_t) { self->on_header(ec); });
+
+}
+
+
+/**
+ * Applies the route's body limit, refusing a declared length over it without reading
+ * the body, then reads the body.
+ */
+void TlsSession::on_header(beast::error_code ec) {
+
+    if (ec) return close();
+
+    const auto& header = parser_->get();
+    BodyRules rules = body_rules({ header.method_string().data(), header.method_string().size() }, { header.target().data(), header.target().size() });
+
+    body_limit_ = rules.limit;
+    if (parser_->content_length().value_or(0) > body_limit_) return reject(http::status::payload_too_large, body_limit_error(body_limit_));
+
+    parser_->body_limit(body_limit_);
+    if (rules.schema != BodySchema::none) validator_ = std::make_unique<BodyValidator>(rules.schema);
+
+    read_body();
+
+}
+
+
+/**
+ * Reads the next piece of the body, or finishes the request once the parser is done.
+ */
+void TlsSession::read_body() {
+
+    if (parser_->is_done()) return on_read({});
+
+    http::async_read_some(stream_, buffer_, *parser_,
+        [self = shared_from_this()](beast::error_code ec, std::size_t) { self->on_body(ec); });
+
+}
+
+
+/**
+ * Validates the body bytes that just arrived, answering an invalid or oversize body
+ * right away.
+ */
+void TlsSession::on_body(beast::error_code ec) {
+
+    if (ec == http::error::body_limit) return reject(http::status::payload_too_large, body_limit_error(body_limit_));
+    if (ec) return close();
+
+    if (validator_) {
+        std::string_view body = parser_->get().body();
+        bool valid = validator_->write(body.substr(validated_));
+        validated_ = body.size();
+        if (!valid) return reject(http::status::bad_request, validator_->error());
+    }
+
+    read_body();
+
+}
+
+
+/**
+ * Answers the request through the API handler, which runs on the API threads.
+ */
+void TlsSession::on_read(beast::error_code ec) {
+
+    if (ec) return close();
+
+    if (validator_ && !validator_->finish()) return reject(http::status::bad_request, validator_->error());
+
+    server_.deadlines_.cancel(deadline_);
+    req_ = parser_->release();
+    parser_.reset();
+    validator_.reset();
+
+    start_ = std::chrono::steady_clock::now();
+    server_.capture_request(req_);
+    server_.post_api_request(api_request(req_), stream_.get_executor(), [self = shared_from_this()](http::response<http::string_body>& res) {
+
+        self->res_ = std::move(res);
+        self->res_.keep_alive(self->req_.keep_alive());
+
+        self->server_.deadlines_.schedule(self->deadline_, self->server_.timeouts_.body);
+
+        http::async_write(self->stream_, self->res_,
+            [self](beast::error_code ec, std::size_t bytes) { self->on_write(ec, bytes); });
+
+    });
+
+}
+
+
+/**
+ * Answers a request whose body was refused before it reached the handler.
+ * @param status 413 or 400
+ * @param message Error for the client
+ */
+void TlsSession::reject(http::status status, const std::string& message) {
+
+    server_.deadlines_.cancel(deadline_);
+    req_ = parser_->release();
+    parser_.reset();
+
+    start_ = std::chrono::steady_clock::now();
+    res_ = server_.reject_body(req_.version(), status, message);
+    res_.keep_alive(false);
+    validator_.reset();
+
+    server_.deadlines_.schedule(deadline_, server_.timeouts_.body);
+
+    http::async_write(stream_, res_,
+        [self = shared_from_this()](beast::error_code ec, std::size_t bytes) { self->on_write(ec, bytes); });
+
+}
+
+
+/**
+ * Logs the request, then waits for the next one or shuts the TLS session down.
+ */
+void TlsSession::on_write(beast::error_code ec, std::size_t bytes) {
+
+    if (ec) return close();
+
+    auto method = req_.method_string();
+    auto target = req_.target();
+    server_.access_log_.record({ method.data(), method.size() }, { target.data(), target.size() }, res_.result_int(),
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_), bytes, client_);
+
+    bool keep_alive = res_.keep_alive();
+    req_ = {};
+    res_ = {};
+    validated_ = 0;
+
+    if (!keep_alive) return close();
+
+    wait_for_request();
+
+}
+
+
+/**
+ * Drops a connection that sat idle or was too slow; closing the socket aborts the
+ * pending operation, whose handler releases the session.
+ */
+void TlsSession::on_deadline() {
+
+    if (idle_) server_.idle_closed_++;
+    else server_.slow_closed_++;
+
+    close_socket();
+
+}
+
+
+/**
+ * Sends close_notify and closes the socket, giving the peer the header deadline to answer.
+ */
+void TlsSession::close() {
+
+    server_.deadlines_.schedule(deadline_, server_.timeouts_.header);
+
+    stream_.async_shutdown([self = shared_from_this()](beast::error_code) { self->close_socket(); });
+
+}
+
+
+/**
+ * Disarms the deadline and closes the socket; pending operations complete with an error.
+ */
+void TlsSession::close_socket() {
+
+    server_.deadlines_.cancel(deadline_);
+
+    beast::error_code ec;
+    stream_.next_layer().close(ec);
+
+}
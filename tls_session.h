@@ -0,0 +1,60 @@
+#pragma once
+#include "body_validator.h"
+#include "timer_wheel.h"
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast.hpp>
+#include <boost/beast/ssl.hpp>
+#include <chrono>
+#include <memory>
+
+namespace beast = boost::beast;
+namespace http = beast::http;
+namespace asio = boost::asio;
+using tcp = asio::ip::tcp;
+
+class HttpServer;
+
+// One HTTPS connection. Handshake, read, write and shutdown are all asynchronous
+// so slow or resuming clients never hold up the acceptor. The body is limited and
+// validated as it arrives, like on cleartext connections. Kept-alive connections wait
+// for their next request under the idle deadline, as on cleartext connections.
+class TlsSession : public std::enable_shared_from_this<TlsSession> {
+public:
+
+	TlsSession(HttpServer& server, tcp::socket socket, asio::ssl::context& ctx);
+
+	// Methods
+	void start();
+
+private:
+
+	void on_handshake(beast::error_code ec);
+	void wait_for_request();
+	void read_request();
+	void on_header(beast::error_code ec);
+	void read_body();
+	void on_body(beast::error_code ec);
+	void on_read(beast::error_code ec);
+	void reject(http::status status, const std::string& message);
+	void on_write(beast::error_code ec, std::size_t bytes);
+	void on_deadline();
+	void close();
+	void close_socket();
+
+	HttpServer& server_;
+	beast::ssl_stream<tcp::socket> stream_;
+	beast::flat_buffer buffer_;
+	std::unique_ptr<http::request_parser<http::string_body>> parser_;
+	std::unique_ptr<BodyValidator> validator_;
+	std::size_t validated_ = 0;
+	std::size_t body_limit_ = 0;
+	http::request<http::string_body> req_;
+	http::response<http::string_body> res_;
+	tcp::endpoint client_;
+	std::chrono::steady_clock::time_point start_;
+
+	TimerWheel::Timer deadline_;
+	bool idle_ = false;
+
+};
@@ -0,0 +1,268 @@
+#include "utf8.h"
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UTF8_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define UTF8_NEON 1
+#include <arm_neon.h>
+#endif
+
+// The full vector validator needs SSSE3 (pshufb, palignr), which is not part of the
+// x64 baseline, so it is compiled for SSSE3 on its own and picked at run time
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UTF8_SSSE3 1
+#define UTF8_SSSE3_TARGET __attribute__((target("ssse3")))
+#include <tmmintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define UTF8_SSSE3 1
+#define UTF8_SSSE3_TARGET
+#include <intrin.h>
+#include <tmmintrin.h>
+#endif
+
+namespace {
+
+    // End of the multi-byte sequence whose lead byte is at p, or nullptr if it is malformed.
+    // The bounds on the second byte rule out overlong forms, surrogates and > U+10FFFF.
+    const unsigned char* skip_sequence(const unsigned char* p, const unsigned char* end) {
+
+        unsigned char lead = p[0];
+        std::ptrdiff_t size = 0;
+        unsigned char low = 0x80;
+        unsigned char high = 0xBF;
+
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            size = 2;
+        }
+        else if (lead >= 0xE0 && lead <= 0xEF) {
+            size = 3;
+            if (lead == 0xE0) low = 0xA0;
+            if (lead == 0xED) high = 0x9F;
+        }
+        else if (lead >= 0xF0 && lead <= 0xF4) {
+            size = 4;
+            if (lead == 0xF0) low = 0x90;
+            if (lead == 0xF4) high = 0x8F;
+        }
+        else {
+            return nullptr;
+        }
+
+        if (end - p < size || p[1] < low || p[1] > high) return nullptr;
+        for (std::ptrdiff_t i = 2; i < size; ++i) {
+            if ((p[i] & 0xC0) != 0x80) return nullptr;
+        }
+
+        return p + size;
+
+    }
+
+
+#ifdef UTF8_SSSE3
+    bool has_ssse3() {
+
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 9)) != 0;
+#else
+        return __builtin_cpu_supports("ssse3");
+#endif
+
+    }
+
+    // Error classes of a two-byte window (lead or previous byte, next byte), after
+    // Keiser and Lemire, "Validating UTF-8 in less than one instruction per byte"
+    constexpr char too_short = 1 << 0;	// lead byte followed by a lead or ASCII byte
+    constexpr char too_long = 1 << 1;	// ASCII followed by a continuation byte
+    constexpr char overlong_3 = 1 << 2;	// E0 80..9F
+    constexpr char too_large = 1 << 3;	// F4 90..BF, F5..FF
+    constexpr char surrogate = 1 << 4;	// ED A0..BF
+    constexpr char overlong_2 = 1 << 5;	// C0..C1
+    constexpr char too_large_1000 = 1 << 6;
+    constexpr char overlong_4 = 1 << 6;	// F0 80..8F
+    constexpr char two_conts = static_cast<char>(1 << 7);	// continuation after continuation; fine in 3- and 4-byte sequences
+    constexpr char carry = too_short | too_long | two_conts;
+
+    // Vector validator state: errors seen, the previous block (sequences cross blocks)
+    // and whether that block ended inside a sequence
+    struct Ssse3Check {
+
+        __m128i error = _mm_setzero_si128();
+        __m128i previous = _mm_setzero_si128();
+        __m128i previous_incomplete = _mm_setzero_si128();
+        std::size_t count = 0;
+
+    };
+
+    // Checks and counts one 16-byte block holding at least one non-ASCII byte
+    UTF8_SSSE3_TARGET inline void check_block(Ssse3Check& state, __m128i input) {
+
+        const __m128i byte_1_high_table = _mm_setr_epi8(
+            too_long, too_long, too_long, too_long, too_long, too_long, too_long, too_long,
+            two_conts, two_conts, two_conts, two_conts,
+            too_short | overlong_2,
+            too_short,
+            too_short | overlong_3 | surrogate,
+            too_short | too_large | too_large_1000 | overlong_4);
+        const __m128i byte_1_low_table = _mm_setr_epi8(
+            carry | overlong_3 | overlong_2 | overlong_4,
+            carry | overlong_2,
+            carry,
+            carry,
+            carry | too_large,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000 | surrogate,
+            carry | too_large | too_large_1000,
+            carry | too_large | too_large_1000);
+        const __m128i byte_2_high_table = _mm_setr_epi8(
+            too_short, too_short, too_short, too_short, too_short, too_short, too_short, too_short,
+            too_long | overlong_2 | two_conts | overlong_3 | too_large_1000 | overlong_4,
+            too_long | overlong_2 | two_conts | overlong_3 | too_large,
+            too_long | overlong_2 | two_conts | surrogate | too_large,
+            too_long | overlong_2 | two_conts | surrogate | too_large,
+            too_short, too_short, too_short, too_short);
+
+        const __m128i low_nibble = _mm_set1_epi8(0x0F);
+        const __m128i high_bit = _mm_set1_epi8(static_cast<char>(0x80));
+
+        // Every byte but a continuation byte (signed -128..-65) starts a code point
+        unsigned starts = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpgt_epi8(input, _mm_set1_epi8(-65))));
+        state.count += static_cast<std::size_t>(std::popcount(starts));
+
+        __m128i prev1 = _mm_alignr_epi8(input, state.previous, 15);
+        __m128i special = _mm_and_si128(
+            _mm_and_si128(
+                _mm_shuffle_epi8(byte_1_high_table, _mm_and_si128(_mm_srli_epi16(prev1, 4), low_nibble)),
+                _mm_shuffle_epi8(byte_1_low_table, _mm_and_si128(prev1, low_nibble))),
+            _mm_shuffle_epi8(byte_2_high_table, _mm_and_si128(_mm_srli_epi16(input, 4), low_nibble)));
+
+        // Third and fourth bytes of long sequences must be continuations (the two_conts case)
+        __m128i third = _mm_subs_epu8(_mm_alignr_epi8(input, state.previous, 14), _mm_set1_epi8(static_cast<char>(0xE0 - 0x80)));
+        __m128i fourth = _mm_subs_epu8(_mm_alignr_epi8(input, state.previous, 13), _mm_set1_epi8(static_cast<char>(0xF0 - 0x80)));
+        __m128i must_continue = _mm_and_si128(_mm_or_si128(third, fourth), high_bit);
+        state.error = _mm_or_si128(state.error, _mm_xor_si128(must_continue, special));
+
+        // A lead byte this close to the end of the block needs bytes from the next one
+        const __m128i incomplete_above = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            static_cast<char>(0xF0 - 1), static_cast<char>(0xE0 - 1), static_cast<char>(0xC0 - 1));
+        state.previous_incomplete = _mm_subs_epu8(input, incomplete_above);
+        state.previous = input;
+
+    }
+
+    // Validates and counts code points 16 bytes at a time; the tail is zero padded
+    UTF8_SSSE3_TARGET std::optional<std::size_t> utf8_length_ssse3(const unsigned char* p, std::size_t size) {
+
+        Ssse3Check state;
+        unsigned char tail[16] = {};
+
+        while (size > 0) {
+
+            __m128i input;
+            if (size >= 16) {
+                input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                p += 16;
+                size -= 16;
+            }
+            else {
+                std::memcpy(tail, p, size);
+                input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tail));
+                state.count -= 16 - size;
+                size = 0;
+            }
+
+            // All ASCII: only a sequence left open by the previous block can be wrong
+            if (_mm_movemask_epi8(input) == 0) {
+                state.count += 16;
+                state.error = _mm_or_si128(state.error, state.previous_incomplete);
+                state.previous_incomplete = _mm_setzero_si128();
+                state.previous = input;
+                continue;
+            }
+
+            check_block(state, input);
+
+        }
+
+        __m128i error = _mm_or_si128(state.error, state.previous_incomplete);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) != 0xFFFF) return std::nullopt;
+
+        return state.count;
+
+    }
+#endif
+
+}
+
+/**
+ * Validates UTF-8 and counts its code points in one pass.
+ * With SSSE3 every 16-byte block is checked with table lookups whatever it holds.
+ * Otherwise ASCII is skipped a vector at a time, and a vector holding any other byte,
+ * or the tail shorter than a vector, is decoded one sequence at a time.
+ * @param text Bytes to check
+ * @return std::optional<std::size_t> Code points, or nullopt if text is not well-formed UTF-8
+ */
+std::optional<std::size_t> utf8_length(std::string_view text) {
+
+#ifdef UTF8_SSSE3
+    static const bool ssse3 = has_ssse3();
+    if (ssse3) return utf8_length_ssse3(reinterpret_cast<const unsigned char*>(text.data()), text.size());
+#endif
+
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(text.data());
+    const unsigned char* end = p + text.size();
+    std::size_t count = 0;
+
+    while (p < end) {
+
+        const unsigned char* stop = end;
+
+#if defined(UTF8_SSE2)
+        for (; end - p >= 16; p += 16, count += 16) {
+            unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+            if (mask == 0) continue;
+
+            // Count the ASCII prefix, then decode the rest of this vector below
+            int ascii = std::countr_zero(mask);
+            stop = p + 16;
+            p += ascii;
+            count += ascii;
+            break;
+        }
+#elif defined(UTF8_NEON)
+        for (; end - p >= 16; p += 16, count += 16) {
+            if (vmaxvq_u8(vld1q_u8(p)) < 0x80) continue;
+            stop = p + 16;
+            break;
+        }
+#endif
+
+        // A sequence may run past stop; the next vector starts after it
+        while (p < stop) {
+            if (*p < 0x80) {
+                p++;
+            }
+            else {
+                p = skip_sequence(p, end);
+                if (!p) return std::nullopt;
+            }
+            count++;
+        }
+
+    }
+
+    return count;
+
+}
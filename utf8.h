@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+// Number of code points in text if it is well-formed UTF-8 (RFC 3629: no overlong
+// forms, surrogates or code points above U+10FFFF), otherwise nullopt. On CPUs with
+// SSSE3 all of it is checked 16 bytes at a time; elsewhere runs of ASCII are skipped
+// 16 bytes at a time with SSE2 or NEON and the rest is decoded byte by byte.
+std::optional<std::size_t> utf8_length(std::string_view text);
+
+// Whether text is well-formed UTF-8
+inline bool utf8_valid(std::string_view text) {
+
+	return utf8_length(text).has_value();
+
+}
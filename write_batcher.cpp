@@ -0,0 +1,273 @@
+#include "write_batcher.h"
+#include <algorithm>
+
+
+/**
+ * WriteBatcher class constructor.
+ * Starts the committer thread.
+ * @param db Database the updates are written to
+ * @param window How long the committer waits for more writes after the first one arrives
+ * @param on_commit Called after each commit with the id of every task it updated
+ * @param max_batch Writes per transaction; a full batch is committed without waiting
+ */
+WriteBatcher::WriteBatcher(Database& db, std::chrono::microseconds window, std::function<void(int)> on_commit, std::size_t max_batch)
+    : db_(db), window_(window), on_commit_(std::move(on_commit)), max_batch_(std::max<std::size_t>(max_batch, 1)) {
+
+    committer_ = std::thread(&WriteBatcher::commit_loop, this);
+
+}
+
+
+/**
+ * WriteBatcher class destructor.
+ * Stops the committer thread after it has committed every pending update.
+ */
+WriteBatcher::~WriteBatcher() {
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    committer_.join();
+
+}
+
+
+/**
+ * Queues an update.
+ * If an update of the same task is already pending the two are merged, with the
+ * fields of this one taking precedence, and both callers are answered by the single
+ * write of the merged row.
+ * @param id ID of the task to change
+ * @param patch Fields to write
+ * @param flush Commit now rather than at the end of the window
+ * @return std::future<bool> Completes after commit with true if the task exists; holds the
+ *         exception if the write failed
+ */
+std::future<bool> WriteBatcher::submit(int id, const TaskPatch& patch, bool flush) {
+
+    std::promise<bool> promise;
+    std::future<bool> result = promise.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        Pending& pending = pending_[id];
+        merge_patch(pending.patch, patch);
+        pending.waiters.push_back(std::move(promise));
+        stats_.submitted++;
+        flush_ = flush_ || flush;
+    }
+
+    wake_.notify_one();
+    return result;
+
+}
+
+
+/**
+ * Queues a new task.
+ * @param task Task to insert (id is ignored)
+ * @param flush Commit now rather than at the end of the window
+ * @return std::future<int> Completes after commit with the new task's id; holds the exception
+ *         if the insert failed
+ */
+std::future<int> WriteBatcher::submit_insert(const Task& task, bool flush) {
+
+    std::promise<int> promise;
+    std::future<int> result = promise.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        inserts_.push_back({ task, std::move(promise) });
+        stats_.submitted++;
+        flush_ = flush_ || flush;
+    }
+
+    wake_.notify_one();
+    return result;
+
+}
+
+
+/**
+ * Runs a direct write on the caller's thread, outside any group transaction.
+ * The write waits for a commit in progress and keeps the next one from starting, so it
+ * never lands inside a batch on the shared connection. If any of the tasks it changes
+ * still has a queued update, the queue is committed first (on this thread), so an
+ * older write can never overwrite it.
+ * @param ids Tasks the write changes; empty for inserts, which cannot conflict
+ * @param write Database write to run
+ * @throws Whatever write throws
+ */
+void WriteBatcher::write_through(std::span<const int> ids, const std::function<void()>& write) {
+
+    std::lock_guard<std::mutex> commit_lock(commit_mutex_);
+
+    std::unordered_map<int, Pending> batch;
+    std::vector<PendingInsert> inserts;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (std::any_of(ids.begin(), ids.end(), [this](int id) { return pending_.contains(id); })) {
+            batch.swap(pending_);
+            inserts.swap(inserts_);
+            flush_ = false;
+        }
+    }
+
+    if (!batch.empty()) commit(inserts, batch);
+
+    write();
+
+}
+
+
+/**
+ * Returns a snapshot of the batcher counters.
+ * @return WriteBatchStats Counters
+ */
+WriteBatchStats WriteBatcher::stats() const {
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+
+}
+
+
+/**
+ * Committer thread.
+ * Sleeps until a write arrives, keeps collecting for one window (or until the batch
+ * is full or a flush is requested), then commits everything collected so far.
+ */
+void WriteBatcher::commit_loop() {
+
+    std::unordered_map<int, Pending> batch;
+    std::vector<PendingInsert> inserts;
+
+    for (;;) {
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stopping_ || !pending_.empty() || !inserts_.empty(); });
+            if (pending_.empty() && inserts_.empty()) return;
+
+            wake_.wait_for(lock, window_, [this] { return stopping_ || flush_ || pending_.size() + inserts_.size() >= max_batch_; });
+        }
+
+        // Lock order is commit_mutex_ then mutex_, as in write_through
+        std::lock_guard<std::mutex> commit_lock(commit_mutex_);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            batch.swap(pending_);
+            inserts.swap(inserts_);
+            flush_ = false;
+        }
+
+        // A write_through may have committed the queue while this thread waited
+        if (batch.empty() && inserts.empty()) continue;
+
+        commit(inserts, batch);
+        batch.clear();
+        inserts.clear();
+
+    }
+
+}
+
+
+/**
+ * Writes one batch in a single transaction and answers its waiters.
+ * Inserts are written before updates. A write that fails on its own fails only its
+ * own waiters; if the transaction itself fails every waiter receives the error.
+ * @param inserts New tasks with the caller waiting on each
+ * @param batch Merged patch per task id with the callers waiting on it
+ */
+void WriteBatcher::commit(std::vector<PendingInsert>& inserts, std::unordered_map<int, Pending>& batch) {
+
+    std::vector<std::pair<int, std::exception_ptr>> insert_results;
+    std::vector<std::pair<bool, std::exception_ptr>> update_results;
+    std::uint64_t written = 0;
+    std::uint64_t inserted = 0;
+    std::uint64_t failed = 0;
+
+    try {
+
+        db_.begin_transaction();
+
+        for (auto& insert : inserts) {
+            try {
+                insert_results.emplace_back(db_.add_task(insert.task), nullptr);
+                inserted++;
+            }
+            catch (const std::exception&) {
+                insert_results.emplace_back(0, std::current_exception());
+                failed++;
+            }
+        }
+
+        for (auto& [id, pending] : batch) {
+            try {
+                update_results.emplace_back(db_.patch_task(id, pending.patch), nullptr);
+                written++;
+            }
+            catch (const std::exception&) {
+                update_results.emplace_back(false, std::current_exception());
+                failed++;
+            }
+        }
+
+        db_.commit_transaction();
+
+    }
+    catch (const std::exception&) {
+
+        db_.rollback_transaction();
+
+        if (on_commit_) {
+            for (const auto& [id, pending] : batch) on_commit_(id);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.failed += inserts.size() + batch.size();
+        }
+
+        for (auto& insert : inserts) insert.waiter.set_exception(std::current_exception());
+        for (auto& [id, pending] : batch) {
+            for (auto& waiter : pending.waiters) waiter.set_exception(std::current_exception());
+        }
+        return;
+
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.written += written;
+        stats_.inserted += inserted;
+        stats_.failed += failed;
+        stats_.commits++;
+    }
+
+    if (on_commit_) {
+        for (const auto& [id, pending] : batch) on_commit_(id);
+    }
+
+    for (std::size_t i = 0; i < inserts.size(); ++i) {
+        if (insert_results[i].second) inserts[i].waiter.set_exception(insert_results[i].second);
+        else inserts[i].waiter.set_value(insert_results[i].first);
+    }
+
+    std::size_t i = 0;
+    for (auto& [id, pending] : batch) {
+        for (auto& waiter : pending.waiters) {
+            if (update_results[i].second) waiter.set_exception(update_results[i].second);
+            else waiter.set_value(update_results[i].first);
+        }
+        ++i;
+    }
+
+}
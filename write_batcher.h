@@ -0,0 +1,83 @@
+#pragma once
+#include "database.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Counters of a WriteBatcher; amplification is rows written per submitted write
+struct WriteBatchStats {
+
+	std::uint64_t submitted = 0;
+	std::uint64_t written = 0;
+	std::uint64_t inserted = 0;
+	std::uint64_t failed = 0;
+	std::uint64_t commits = 0;
+
+};
+
+
+// Group-commits task writes on a background thread. Writes that arrive within one
+// commit window share a single transaction, and repeated updates of the same task
+// merge into one write (later fields win). Every submitter's future completes only
+// after the transaction holding its write has committed. A flush request commits
+// immediately instead of waiting out the window.
+class WriteBatcher {
+public:
+
+	// Constructor (on_commit is called on the committer thread for every task id updated by a commit)
+	WriteBatcher(Database& db, std::chrono::microseconds window, std::function<void(int)> on_commit = {}, std::size_t max_batch = 1024);
+
+	// Destructor (commits whatever is pending)
+	~WriteBatcher();
+
+	WriteBatcher(const WriteBatcher&) = delete;
+	WriteBatcher& operator=(const WriteBatcher&) = delete;
+
+	// Methods
+	std::future<bool> submit(int id, const TaskPatch& patch, bool flush = false);
+	std::future<int> submit_insert(const Task& task, bool flush = false);
+	void write_through(std::span<const int> ids, const std::function<void()>& write);
+	WriteBatchStats stats() const;
+
+private:
+
+	struct Pending {
+
+		TaskPatch patch;
+		std::vector<std::promise<bool>> waiters;
+
+	};
+
+	struct PendingInsert {
+
+		Task task;
+		std::promise<int> waiter;
+
+	};
+
+	void commit_loop();
+	void commit(std::vector<PendingInsert>& inserts, std::unordered_map<int, Pending>& batch);
+
+	Database& db_;
+	std::chrono::microseconds window_;
+	std::function<void(int)> on_commit_;
+	std::size_t max_batch_;
+
+	std::mutex commit_mutex_;		// held from taking a batch until it is committed; taken before mutex_
+	mutable std::mutex mutex_;
+	std::condition_variable wake_;
+	std::unordered_map<int, Pending> pending_;
+	std::vector<PendingInsert> inserts_;
+	WriteBatchStats stats_;
+	bool flush_ = false;
+	bool stopping_ = false;
+	std::thread committer_;
+
+};